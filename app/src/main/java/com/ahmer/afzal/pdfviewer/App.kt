@@ -2,6 +2,8 @@ package com.ahmer.afzal.pdfviewer
 
 import androidx.multidex.MultiDex
 import androidx.multidex.MultiDexApplication
+import com.ahmer.pdfium.KeepAlivePolicy
+import com.ahmer.pdfium.PdfiumCore
 import dagger.hilt.android.HiltAndroidApp
 
 @HiltAndroidApp
@@ -10,5 +12,7 @@ class App : MultiDexApplication() {
     override fun onCreate() {
         super.onCreate()
         MultiDex.install(this@App)
+        PdfiumCore.setKeepAlivePolicy(policy = KeepAlivePolicy.DEFAULT)
+        Thread({ PdfiumCore.warmUp(context = this@App) }, "PdfiumWarmUp").start()
     }
 }
\ No newline at end of file
@@ -1,8 +1,12 @@
 package com.ahmer.pdfviewer
 
 import android.graphics.RectF
+import com.ahmer.pdfium.PdfiumCore
 import com.ahmer.pdfviewer.model.PagePart
+import com.ahmer.pdfviewer.util.PdfConstants.Cache.CACHE_MIN_SIZE_BYTES
 import com.ahmer.pdfviewer.util.PdfConstants.Cache.CACHE_SIZE
+import com.ahmer.pdfviewer.util.PdfConstants.Cache.CACHE_SIZE_BYTES
+import com.ahmer.pdfviewer.util.PdfConstants.Cache.NATIVE_MEMORY_ALLOWANCE_BYTES
 import com.ahmer.pdfviewer.util.PdfConstants.Cache.THUMBNAILS_CACHE_SIZE
 import java.util.PriorityQueue
 
@@ -12,11 +16,19 @@ class CacheManager {
     private val thumbnails: MutableList<PagePart> = mutableListOf()
     private val cacheLock: Any = Any()
     private val thumbnailsLock: Any = Any()
+    private var cachedBytes: Long = 0L
+
+    /**
+     * Bytes held by the cached page parts, thumbnails excluded
+     */
+    val cacheSizeBytes: Long
+        get() = synchronized(lock = cacheLock) { cachedBytes }
 
     fun cachePart(part: PagePart) {
         synchronized(lock = cacheLock) {
-            clearCacheSpace()
+            clearCacheSpace(incomingBytes = part.byteCount)
             activeCache.offer(part)
+            cachedBytes += part.byteCount
         }
     }
 
@@ -27,17 +39,110 @@ class CacheManager {
         }
     }
 
-    private fun clearCacheSpace() {
+    /**
+     * Bytes the cache may hold. Native memory held by PDFium beyond [NATIVE_MEMORY_ALLOWANCE_BYTES]
+     * (large in-memory sources, many open pages) is taken out of the bitmap budget.
+     */
+    val budgetBytes: Long
+        get() {
+            val nativeBytes: Long = PdfiumCore.getNativeMemoryUsage().totalBytes
+            val excess: Long = (nativeBytes - NATIVE_MEMORY_ALLOWANCE_BYTES).coerceAtLeast(minimumValue = 0L)
+            return (CACHE_SIZE_BYTES - excess).coerceAtLeast(minimumValue = CACHE_MIN_SIZE_BYTES)
+        }
+
+    private fun clearCacheSpace(incomingBytes: Int) {
+        val budget: Long = budgetBytes
         synchronized(lock = cacheLock) {
-            while (activeCache.size + passiveCache.size >= CACHE_SIZE && passiveCache.isNotEmpty()) {
-                passiveCache.poll()?.renderedBitmap?.recycle()
+            while (cachedBytes + incomingBytes > budget && passiveCache.isNotEmpty()) {
+                evict(queue = passiveCache)
             }
-            while (activeCache.size + passiveCache.size >= CACHE_SIZE && activeCache.isNotEmpty()) {
-                activeCache.poll()?.renderedBitmap?.recycle()
+            while (cachedBytes + incomingBytes > budget && activeCache.isNotEmpty()) {
+                evict(queue = activeCache)
             }
         }
     }
 
+    private fun evict(queue: PriorityQueue<PagePart>) {
+        queue.poll()?.let { part: PagePart ->
+            cachedBytes -= part.byteCount
+            part.renderedBitmap?.recycle()
+            part.annotationBitmap?.recycle()
+        }
+    }
+
+    /**
+     * Whether the part is cached with an annotation layer older than [version], or without one
+     */
+    fun needsAnnotationLayer(page: Int, bounds: RectF, version: Int): Boolean {
+        val fakePart = PagePart(
+            page = page,
+            renderedBitmap = null,
+            pageBounds = bounds,
+            isThumbnail = false,
+            cacheOrder = 0
+        )
+        return synchronized(lock = cacheLock) {
+            val found: PagePart = activeCache.firstOrNull { it == fakePart }
+                ?: passiveCache.firstOrNull { it == fakePart } ?: return false
+            found.annotationVersion < version
+        }
+    }
+
+    /**
+     * Marks the annotation layers of the parts of [page] overlapping [bounds] as outdated, so only the
+     * parts touched by an edit are rendered again
+     *
+     * @param bounds Edited areas, relative to the page like [PagePart.pageBounds]
+     */
+    fun invalidateAnnotationLayers(page: Int, bounds: List<RectF>) {
+        synchronized(lock = cacheLock) {
+            sequenceOf(activeCache, passiveCache).flatten()
+                .filter { part -> part.page == page && bounds.any { RectF.intersects(it, part.pageBounds) } }
+                .forEach { part -> part.annotationVersion = -1 }
+        }
+    }
+
+    /**
+     * Replaces the annotation layer of the cached part matching [layer], a part holding only the layer.
+     * The layer is dropped if the part is gone or already has a newer one.
+     */
+    fun attachAnnotationLayer(layer: PagePart) {
+        synchronized(lock = cacheLock) {
+            val found: PagePart? = activeCache.firstOrNull { it == layer } ?: passiveCache.firstOrNull { it == layer }
+            if (found == null || found.annotationVersion > layer.annotationVersion) {
+                layer.annotationBitmap?.recycle()
+                return
+            }
+            cachedBytes -= found.byteCount
+            found.annotationBitmap?.recycle()
+            found.annotationBitmap = layer.annotationBitmap
+            found.annotationVersion = layer.annotationVersion
+            cachedBytes += found.byteCount
+        }
+    }
+
+    /**
+     * Drops the parts and thumbnails of [pages], after their layout changed
+     */
+    fun removePages(pages: Set<Int>) {
+        synchronized(lock = cacheLock) {
+            sequenceOf(activeCache, passiveCache).forEach { queue ->
+                queue.removeAll { part ->
+                    (part.page in pages).also { isRemoved ->
+                        if (isRemoved) {
+                            cachedBytes -= part.byteCount
+                            part.renderedBitmap?.recycle()
+                            part.annotationBitmap?.recycle()
+                        }
+                    }
+                }
+            }
+        }
+        synchronized(lock = thumbnailsLock) {
+            thumbnails.removeAll { part -> (part.page in pages).also { if (it) part.renderedBitmap?.recycle() } }
+        }
+    }
+
     fun cacheThumbnail(part: PagePart) {
         synchronized(lock = thumbnailsLock) {
             while (thumbnails.size >= THUMBNAILS_CACHE_SIZE) {
@@ -90,10 +195,17 @@ class CacheManager {
 
     fun clearAll() {
         synchronized(lock = cacheLock) {
-            passiveCache.forEach { it.renderedBitmap?.recycle() }
+            passiveCache.forEach {
+                it.renderedBitmap?.recycle()
+                it.annotationBitmap?.recycle()
+            }
             passiveCache.clear()
-            activeCache.forEach { it.renderedBitmap?.recycle() }
+            activeCache.forEach {
+                it.renderedBitmap?.recycle()
+                it.annotationBitmap?.recycle()
+            }
             activeCache.clear()
+            cachedBytes = 0L
         }
         synchronized(lock = thumbnailsLock) {
             thumbnails.forEach { it.renderedBitmap?.recycle() }
@@ -13,6 +13,7 @@ import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.cancel
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
+import java.io.File
 
 internal class DecodingTask(
     private val docSource: DocumentSource,
@@ -72,7 +73,11 @@ internal class DecodingTask(
                 isVertical = pdfView.isSwipeVertical,
                 spacingPixels = pdfView.spacingPx,
                 userPages = userPages ?: intArrayOf(),
-                size = Size(width = pdfView.width, height = pdfView.height)
+                size = Size(width = pdfView.width, height = pdfView.height),
+                isAutoCrop = pdfView.isAutoCrop,
+                indexDir = if (pdfView.isLayoutIndex) {
+                    File(pdfView.context.cacheDir, PdfConstants.Cache.LAYOUT_INDEX_DIR)
+                } else null
             )
         }
     }
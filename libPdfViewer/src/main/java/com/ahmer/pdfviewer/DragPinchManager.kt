@@ -45,10 +45,11 @@ internal class DragPinchManager(
     }
 
     override fun onSingleTapConfirmed(e: MotionEvent): Boolean {
-        val linkTapped: Boolean = checkLinkTapped(x = e.x, y = e.y)
+        val formTapped: Boolean = checkFormTapped(x = e.x, y = e.y)
+        val linkTapped: Boolean = !formTapped && checkLinkTapped(x = e.x, y = e.y)
         val onTapHandled: Boolean = pdfView.callbacks.callOnTap(event = e)
 
-        if (!onTapHandled && !linkTapped) {
+        if (!onTapHandled && !linkTapped && !formTapped) {
             pdfView.scrollHandle?.takeIf { !pdfView.documentFitsView() }?.let { handle ->
                 if (handle.shown()) handle.hide() else handle.show()
             }
@@ -57,6 +58,32 @@ internal class DragPinchManager(
         return true
     }
 
+    private fun checkFormTapped(x: Float, y: Float): Boolean {
+        if (!pdfView.isFormFilling || !pdfView.isAnnotationRendering) return false
+        val pdfFile: PdfFile = pdfView.pdfFile ?: return false
+        val mappedX: Float = -pdfView.currentXOffset + x
+        val mappedY: Float = -pdfView.currentYOffset + y
+        val offset: Float = if (pdfView.isSwipeVertical) mappedY else mappedX
+        val zoom: Float = pdfView.zoom
+        val page: Int = pdfFile.getPageAtOffset(offset = offset, zoom = zoom)
+        val pageSize: SizeF = pdfFile.getScaledPageSize(pageIndex = page, zoom = zoom)
+
+        val (pageX, pageY) = if (pdfView.isSwipeVertical) {
+            pdfFile.getSecondaryPageOffset(pageIndex = page, zoom = zoom) to pdfFile.getPageOffset(pageIndex = page, zoom = zoom)
+        } else {
+            pdfFile.getPageOffset(pageIndex = page, zoom = zoom) to pdfFile.getSecondaryPageOffset(pageIndex = page, zoom = zoom)
+        }
+        val isHandled: Boolean = pdfFile.onFormTap(
+            pageIndex = page,
+            size = pageSize,
+            posX = mappedX - pageX,
+            posY = mappedY - pageY
+        )
+        // A tap outside the fields still removes the focus, which repaints the focused one
+        pdfView.onFormInput(page = page)
+        return isHandled
+    }
+
     private fun checkLinkTapped(x: Float, y: Float): Boolean {
         val pdfFile: PdfFile = pdfView.pdfFile ?: return false
         val mappedX: Float = -pdfView.currentXOffset + x
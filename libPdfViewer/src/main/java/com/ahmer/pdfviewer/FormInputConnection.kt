@@ -0,0 +1,27 @@
+package com.ahmer.pdfviewer
+
+import android.view.KeyEvent
+import android.view.inputmethod.BaseInputConnection
+
+/**
+ * Connects the soft keyboard to the focused form field: committed text is typed into the field and
+ * deletions are sent as delete keys. The field holds the text, so there is no editable buffer here.
+ */
+internal class FormInputConnection(private val pdfView: PDFView) : BaseInputConnection(pdfView, false) {
+
+    override fun commitText(text: CharSequence?, newCursorPosition: Int): Boolean {
+        if (!text.isNullOrEmpty()) pdfView.onFormText(text = text)
+        return true
+    }
+
+    override fun deleteSurroundingText(beforeLength: Int, afterLength: Int): Boolean {
+        repeat(times = beforeLength) { sendKey(keyCode = KeyEvent.KEYCODE_DEL) }
+        repeat(times = afterLength) { sendKey(keyCode = KeyEvent.KEYCODE_FORWARD_DEL) }
+        return true
+    }
+
+    private fun sendKey(keyCode: Int) {
+        sendKeyEvent(KeyEvent(KeyEvent.ACTION_DOWN, keyCode))
+        sendKeyEvent(KeyEvent(KeyEvent.ACTION_UP, keyCode))
+    }
+}
@@ -12,8 +12,13 @@ import android.graphics.RectF
 import android.net.Uri
 import android.util.AttributeSet
 import android.util.Log
+import android.view.KeyEvent
+import android.view.inputmethod.EditorInfo
+import android.view.inputmethod.InputConnection
+import android.view.inputmethod.InputMethodManager
 import android.widget.RelativeLayout
 import com.ahmer.pdfium.PdfDocument
+import com.ahmer.pdfium.PdfFingerprint
 import com.ahmer.pdfium.PdfTextPage
 import com.ahmer.pdfium.PdfiumCore
 import com.ahmer.pdfium.util.Size
@@ -66,23 +71,33 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
     private var _decodingTask: DecodingTask? = null
     private var _defaultPage: Int = 0
     private var _dragPinchManager: DragPinchManager? = null
+    private var _formPage: Int = -1
+    private var _isAdaptiveBitmapFormat: Boolean = false
     private var _isAnnotation: Boolean = false
+    private var _isAutoCrop: Boolean = false
     private var _isAutoSpacing: Boolean = false
     private var _isBestQuality: Boolean = false
+    private var _renderBudgetMs: Long = PdfConstants.RENDER_BUDGET_MS
     private var _isDoubleTapEnabled: Boolean = true
     private var _isEnableAntialiasing: Boolean = true
     private var _isEnableSwipe: Boolean = true
     private var _isFitEachPage: Boolean = false
+    private var _isFormFilling: Boolean = false
+    private var _isFormTextFocused: Boolean = false
     private var _isHasSize: Boolean = false
+    private var _isJpegRegionDecoding: Boolean = true
+    private var _isLayoutIndex: Boolean = false
     private var _isNightMode: Boolean = false
     private var _isPageFling: Boolean = true
     private var _isPageSnap: Boolean = true
     private var _isRecycled: Boolean = true
     private var _isRenderDuringScale: Boolean = false
+    private var _isScanDrawing: Boolean = true
     private var _isScrollHandleInit: Boolean = false
     private var _isSwipeVertical: Boolean = true
     private var _pageFitPolicy: FitPolicy = FitPolicy.WIDTH
     private var _pagesLoader: PagesLoader? = null
+    private var _maskPaint: Paint? = null
     private var _paint: Paint? = null
     private var _scrollDir: ScrollDir = ScrollDir.NONE
     private var _scrollHandle: ScrollHandle? = null
@@ -141,7 +156,22 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
             return
         }
 
-        canvas.drawBitmap(bitmap, srcRect, dstRect, _paint)
+        if (bitmap.config == Bitmap.Config.ALPHA_8) {
+            // Gray parts hold ink coverage: paint the page background, then the ink through the mask
+            _maskPaint?.let { paint: Paint ->
+                paint.color = if (_isNightMode) Color.BLACK else Color.WHITE
+                canvas.drawRect(dstRect, paint)
+                paint.color = if (_isNightMode) Color.WHITE else Color.BLACK
+                canvas.drawBitmap(bitmap, srcRect, dstRect, paint)
+            }
+        } else {
+            canvas.drawBitmap(bitmap, srcRect, dstRect, _paint)
+        }
+        if (_isAnnotation) {
+            part.annotationBitmap?.takeUnless { it.isRecycled }?.let { layer: Bitmap ->
+                canvas.drawBitmap(layer, Rect(0, 0, layer.width, layer.height), dstRect, _paint)
+            }
+        }
 
         if (PdfConstants.DEBUG_MODE) {
             _debugPaint?.color = if (part.page % 2 == 0) Color.RED else Color.BLUE
@@ -313,6 +343,30 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         jumpTo(page = _defaultPage, withAnimation = false)
     }
 
+    /**
+     * Lays out again the pages whose content bounds were measured for auto crop, keeping the page at the
+     * center of the view in place
+     */
+    internal fun onContentBoundsMeasured() {
+        val file: PdfFile = pdfFile ?: return
+        val center: Float = if (_isSwipeVertical) -_currentYOffset + height * 0.5f else -_currentXOffset + width * 0.5f
+        val page: Int = file.getPageAtOffset(offset = center, zoom = _zoom)
+        val pageLength: Float = file.getPageLength(pageIndex = page, zoom = _zoom)
+        val relative: Float = if (pageLength > 0f) {
+            (center - file.getPageOffset(pageIndex = page, zoom = _zoom)) / pageLength
+        } else 0f
+
+        val changed: List<Int> = file.applyMeasuredCrops(viewSize = Size(width = width, height = height))
+        if (changed.isEmpty()) return
+        cacheManager?.removePages(pages = changed.toSet())
+
+        val newCenter: Float = file.getPageOffset(pageIndex = page, zoom = _zoom) +
+                relative * file.getPageLength(pageIndex = page, zoom = _zoom)
+        if (_isSwipeVertical) _currentYOffset = -newCenter + height * 0.5f else _currentXOffset = -newCenter + width * 0.5f
+        moveTo(offsetX = _currentXOffset, offsetY = _currentYOffset)
+        loadPageByOffset()
+    }
+
     fun loadError(error: Throwable?) {
         _state = State.ERROR
         callbacks.onError?.onError(t = error) ?: Log.e(PdfConstants.TAG, "Load PDF error: ", error)
@@ -346,6 +400,80 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         invalidate()
     }
 
+    /**
+     * Renders the annotations and form fields of a page again after they were edited through [PdfiumCore],
+     * keeping the cached page content
+     *
+     * @param page Page whose annotations changed
+     */
+    fun invalidateAnnotations(page: Int) {
+        pdfFile?.invalidateAnnotations(pageIndex = page) ?: return
+        loadPages()
+    }
+
+    /**
+     * Renders again the parts whose form fields were repainted by the last tap or key, and shows the
+     * keyboard while a text field has the focus
+     *
+     * @param page Page that received the input
+     */
+    internal fun onFormInput(page: Int) {
+        val file: PdfFile = pdfFile ?: return
+        _formPage = page
+        file.takeFormDirtyBounds().forEach { (dirtyPage: Int, bounds: List<RectF>) ->
+            cacheManager?.invalidateAnnotationLayers(page = dirtyPage, bounds = bounds)
+        }
+        loadPages()
+
+        val isTextFocused: Boolean = file.isFormTextFocused()
+        if (isTextFocused) {
+            isFocusableInTouchMode = true
+            requestFocus()
+            context.getSystemService(InputMethodManager::class.java)?.let { imm: InputMethodManager ->
+                if (!_isFormTextFocused) imm.restartInput(this)
+                imm.showSoftInput(this, 0)
+            }
+        } else if (_isFormTextFocused) {
+            hideKeyboard()
+        }
+        _isFormTextFocused = isTextFocused
+    }
+
+    internal fun onFormKey(event: KeyEvent): Boolean {
+        if (!_isFormTextFocused) return false
+        val isHandled: Boolean = pdfFile?.onFormKey(pageIndex = _formPage, event = event) ?: return false
+        if (isHandled) onFormInput(page = _formPage)
+        return isHandled
+    }
+
+    internal fun onFormText(text: CharSequence): Boolean {
+        if (!_isFormTextFocused) return false
+        val isHandled: Boolean = pdfFile?.onFormText(pageIndex = _formPage, text = text) ?: return false
+        if (isHandled) onFormInput(page = _formPage)
+        return isHandled
+    }
+
+    private fun hideKeyboard() {
+        context.getSystemService(InputMethodManager::class.java)?.hideSoftInputFromWindow(windowToken, 0)
+    }
+
+    override fun onCheckIsTextEditor(): Boolean = _isFormTextFocused
+
+    override fun onCreateInputConnection(outAttrs: EditorInfo): InputConnection? {
+        if (!_isFormTextFocused) return null
+        outAttrs.inputType = EditorInfo.TYPE_CLASS_TEXT
+        outAttrs.imeOptions = EditorInfo.IME_FLAG_NO_EXTRACT_UI or EditorInfo.IME_FLAG_NO_FULLSCREEN
+        return FormInputConnection(pdfView = this)
+    }
+
+    override fun onKeyDown(keyCode: Int, event: KeyEvent): Boolean {
+        return onFormKey(event = event) || super.onKeyDown(keyCode, event)
+    }
+
+    override fun onKeyUp(keyCode: Int, event: KeyEvent): Boolean {
+        return onFormKey(event = event) || super.onKeyUp(keyCode, event)
+    }
+
     fun moveRelativeTo(dx: Float, dy: Float) {
         moveTo(offsetX = _currentXOffset + dx, offsetY = _currentYOffset + dy)
     }
@@ -424,7 +552,11 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
             callbacks.callOnRender(totalPages = file.pagesCount)
         }
 
-        if (part.isThumbnail) cacheManager?.cacheThumbnail(part = part) else cacheManager?.cachePart(part = part)
+        when {
+            part.isAnnotationLayer -> cacheManager?.attachAnnotationLayer(layer = part)
+            part.isThumbnail -> cacheManager?.cacheThumbnail(part = part)
+            else -> cacheManager?.cachePart(part = part)
+        }
         invalidate()
     }
 
@@ -467,6 +599,9 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
 
         _decodingTask?.cancel()
         cacheManager?.clearAll()
+        if (_isFormTextFocused) hideKeyboard()
+        _formPage = -1
+        _isFormTextFocused = false
 
         _scrollHandle?.takeIf { _isScrollHandleInit }?.destroyLayout()
 
@@ -562,14 +697,33 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
     }
 
     //Setter
+    fun setAdaptiveBitmapFormat(enabled: Boolean) {
+        _isAdaptiveBitmapFormat = enabled
+    }
+
+    /**
+     * Annotations and form fields are drawn on a layer of their own over the page content: hiding them is
+     * immediate and showing them again only renders that layer
+     */
     fun setAnnotation(enabled: Boolean) {
+        if (_isAnnotation == enabled) return
         _isAnnotation = enabled
+        if (enabled) loadPages() else invalidate()
     }
 
     fun setAntialiasing(enabled: Boolean) {
         _isEnableAntialiasing = enabled
     }
 
+    /**
+     * Lay out and render only the content area of each page, trimming blank margins. Takes effect on the
+     * next load. Pages are shown whole until their content bounds are measured in the background, starting
+     * at the current page, unless the layout index already has them.
+     */
+    fun setAutoCrop(enabled: Boolean) {
+        _isAutoCrop = enabled
+    }
+
     fun setAutoSpacing(enabled: Boolean) {
         _isAutoSpacing = enabled
     }
@@ -578,6 +732,36 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         _isBestQuality = enabled
     }
 
+    /**
+     * Draw scanned pages, a single unmasked image covering the page, from their decoded image instead
+     * of rasterizing the page. Disable it to render every page through PDFium.
+     */
+    fun setScanDrawing(enabled: Boolean) {
+        _isScanDrawing = enabled
+    }
+
+    /**
+     * Decode the tiles of JPEG scanned pages straight from the JPEG data, at the scale of each tile,
+     * instead of decoding the whole scan once and scaling it. Only used with [setScanDrawing].
+     */
+    fun setJpegRegionDecoding(enabled: Boolean) {
+        _isJpegRegionDecoding = enabled
+    }
+
+    /**
+     * Keep the page sizes, content bounds, char counts, page complexities, metadata and outline of opened
+     * documents in an index under the app cache directory, keyed by the document fingerprint, so that
+     * reopening a document skips measuring every page. Takes effect on the next load.
+     */
+    fun setLayoutIndex(enabled: Boolean) {
+        _isLayoutIndex = enabled
+    }
+
+    fun setRenderBudget(budgetMs: Long) {
+        require(value = budgetMs >= 0) { "Render budget cannot be negative" }
+        _renderBudgetMs = budgetMs
+    }
+
     fun setDefaultPage(page: Int) {
         _defaultPage = page
     }
@@ -590,6 +774,16 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         _isFitEachPage = enabled
     }
 
+    /**
+     * Let taps and keys fill the form fields, when annotations are rendered. Only the parts of the
+     * edited fields are rendered again after each input.
+     */
+    fun setFormFilling(enabled: Boolean) {
+        if (_isFormFilling == enabled) return
+        _isFormFilling = enabled
+        if (!enabled && pdfFile?.killFormFocus() == true) onFormInput(page = _formPage)
+    }
+
     fun setMaxZoom(zoom: Float) {
         _zoomMax = zoom
     }
@@ -641,6 +835,8 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
     //Getter
     val bookmarks: List<PdfDocument.Bookmark> get() = pdfFile?.bookmarks ?: emptyList()
     val documentMeta: PdfDocument.Meta? get() = pdfFile?.metaData
+    val documentSummary: PdfDocument.Summary? get() = pdfFile?.summary
+    val documentFingerprint: PdfFingerprint? get() = pdfFile?.fingerprint
     val currentPage: Int get() = _currentPage
     val currentXOffset: Float get() = _currentXOffset
     val currentYOffset: Float get() = _currentYOffset
@@ -654,15 +850,22 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
     val zoom: Float get() = _zoom
     val isAnnotationRendering: Boolean get() = _isAnnotation
     val isAntialiasing: Boolean get() = _isEnableAntialiasing
+    val isAutoCrop: Boolean get() = _isAutoCrop
     val isAutoSpacingEnabled: Boolean get() = _isAutoSpacing
     val isBestQuality: Boolean get() = _isBestQuality
+    val isAdaptiveBitmapFormat: Boolean get() = _isAdaptiveBitmapFormat
+    val renderBudgetMs: Long get() = _renderBudgetMs
     val isDoubleTapEnabled: Boolean get() = _isDoubleTapEnabled
     val isFitEachPage: Boolean get() = _isFitEachPage
+    val isFormFilling: Boolean get() = _isFormFilling
+    val isJpegRegionDecoding: Boolean get() = _isJpegRegionDecoding
+    val isLayoutIndex: Boolean get() = _isLayoutIndex
     val isNightMode: Boolean get() = _isNightMode
     val isPageFlingEnabled: Boolean get() = _isPageFling
     val isPageSnap: Boolean get() = _isPageSnap
     val isRecycled: Boolean get() = _isRecycled
     val isRenderDuringScale: Boolean get() = _isRenderDuringScale
+    val isScanDrawing: Boolean get() = _isScanDrawing
     val isSwipeEnabled: Boolean get() = _isEnableSwipe
     val isSwipeVertical: Boolean get() = _isSwipeVertical
     val isZooming: Boolean get() = _zoom != _zoomMin
@@ -838,20 +1041,27 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
 
     inner class Configurator(private val documentSource: DocumentSource) {
         private var defaultPage: Int = 0
+        private var isAdaptiveBitmapFormat: Boolean = false
         private var isAnnotation: Boolean = false
         private var isAntialiasing: Boolean = true
+        private var isAutoCrop: Boolean = false
         private var isAutoSpacing: Boolean = false
         private var isDoubleTapEnabled: Boolean = true
         private var isFitEachPage: Boolean = false
+        private var isFormFilling: Boolean = false
+        private var isJpegRegionDecoding: Boolean = true
+        private var isLayoutIndex: Boolean = false
         private var isNightMode: Boolean = false
         private var isPageFling: Boolean = false
         private var isPageSnap: Boolean = false
+        private var isScanDrawing: Boolean = true
         private var isSwipeEnabled: Boolean = true
         private var isSwipeHorizontal: Boolean = false
         private var linkHandler: LinkHandler = DefaultLinkHandler(pdfView = this@PDFView)
         private var pageFitPolicy: FitPolicy = FitPolicy.WIDTH
         private var pageNumbers: IntArray? = null
         private var password: String? = null
+        private var renderBudgetMs: Long = PdfConstants.RENDER_BUDGET_MS
         private var scrollHandle: ScrollHandle? = null
         private var spacing: Int = 0
 
@@ -867,6 +1077,8 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         private var onRenderListener: OnRenderListener? = null
         private var onTapListener: OnTapListener? = null
 
+        fun adaptiveBitmapFormat(enable: Boolean) = apply { isAdaptiveBitmapFormat = enable }
+        fun autoCrop(enable: Boolean) = apply { isAutoCrop = enable }
         fun autoSpacing(enable: Boolean) = apply { isAutoSpacing = enable }
         fun defaultPage(page: Int) = apply { defaultPage = page }
         fun disableLongPress() = apply { _dragPinchManager?.disableLongPress() }
@@ -875,6 +1087,9 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         fun enableDoubleTap(enable: Boolean) = apply { isDoubleTapEnabled = enable }
         fun enableSwipe(enable: Boolean) = apply { isSwipeEnabled = enable }
         fun fitEachPage(enable: Boolean) = apply { isFitEachPage = enable }
+        fun formFilling(enable: Boolean) = apply { isFormFilling = enable }
+        fun jpegRegionDecoding(enable: Boolean) = apply { isJpegRegionDecoding = enable }
+        fun layoutIndex(enable: Boolean) = apply { isLayoutIndex = enable }
         fun linkHandler(handler: LinkHandler) = apply { linkHandler = handler }
         fun nightMode(enable: Boolean) = apply { isNightMode = enable }
         fun onDraw(listener: OnDrawListener?) = apply { onDrawListener = listener }
@@ -892,6 +1107,8 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         fun pages(vararg pageNumbers: Int) = apply { this.pageNumbers = pageNumbers }
         fun pageSnap(enable: Boolean) = apply { isPageSnap = enable }
         fun password(password: String?) = apply { this.password = password }
+        fun renderBudget(budgetMs: Long) = apply { renderBudgetMs = budgetMs }
+        fun scanDrawing(enable: Boolean) = apply { isScanDrawing = enable }
         fun scrollHandle(handle: ScrollHandle?) = apply { scrollHandle = handle }
         fun spacing(spacing: Int) = apply { this.spacing = spacing }
         fun swipeHorizontal(horizontal: Boolean) = apply { isSwipeHorizontal = horizontal }
@@ -915,16 +1132,23 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
                 setOnRender(listener = onRenderListener)
                 setOnTap(listener = onTapListener)
             }
+            setAdaptiveBitmapFormat(enabled = isAdaptiveBitmapFormat)
             setAnnotation(enabled = isAnnotation)
             setAntialiasing(enabled = isAntialiasing)
+            setAutoCrop(enabled = isAutoCrop)
             setAutoSpacing(enabled = isAutoSpacing)
             setDefaultPage(page = defaultPage)
             setDoubleTap(enabled = isDoubleTapEnabled)
             setFitEachPage(enabled = isFitEachPage)
+            setFormFilling(enabled = isFormFilling)
+            setJpegRegionDecoding(enabled = isJpegRegionDecoding)
+            setLayoutIndex(enabled = isLayoutIndex)
             setNightMode(enabled = isNightMode)
             setPageFitPolicy(policy = pageFitPolicy)
             setPageFling(enabled = isPageFling)
             setPageSnap(enabled = isPageSnap)
+            setRenderBudget(budgetMs = renderBudgetMs)
+            setScanDrawing(enabled = isScanDrawing)
             setScrollHandle(handle = scrollHandle)
             setSpacing(spacingDp = spacing)
             setSwipeEnabled(enabled = isSwipeEnabled)
@@ -956,6 +1180,9 @@ class PDFView(context: Context?, set: AttributeSet?) : RelativeLayout(context, s
         }
         _pagesLoader = PagesLoader(pdfView = this@PDFView)
         _paint = Paint()
+        _maskPaint = Paint().apply {
+            isFilterBitmap = true
+        }
         _debugPaint = Paint().apply {
             style = Paint.Style.STROKE
         }
@@ -27,8 +27,9 @@ internal class PagesLoader(private val pdfView: PDFView) {
         val size: SizeF = pdfFile.getPageSize(pageIndex = pageIndex)
         val ratioX: Float = 1f / size.width
         val ratioY: Float = 1f / size.height
-        val partHeight: Float = PdfConstants.PART_SIZE * ratioY / pdfView.zoom
-        val partWidth: Float = PdfConstants.PART_SIZE * ratioX / pdfView.zoom
+        grid.partSize = pdfFile.getPartSize(pageIndex = pageIndex)
+        val partHeight: Float = grid.partSize * ratioY / pdfView.zoom
+        val partWidth: Float = grid.partSize * ratioX / pdfView.zoom
         grid.rows = ceil(a = 1f / partHeight)
         grid.column = ceil(a = 1f / partWidth)
     }
@@ -36,8 +37,8 @@ internal class PagesLoader(private val pdfView: PDFView) {
     private fun calculatePartSize(grid: GridSize) {
         pageRelativePartWidth = 1f / grid.column.toFloat()
         pageRelativePartHeight = 1f / grid.rows.toFloat()
-        partRenderWidth = PdfConstants.PART_SIZE / pageRelativePartWidth
-        partRenderHeight = PdfConstants.PART_SIZE / pageRelativePartHeight
+        partRenderWidth = grid.partSize / pageRelativePartWidth
+        partRenderHeight = grid.partSize / pageRelativePartHeight
     }
 
     /**
@@ -288,6 +289,24 @@ internal class PagesLoader(private val pdfView: PDFView) {
                     isBestQuality = pdfView.isBestQuality,
                     isAnnotation = pdfView.isAnnotationRendering
                 )
+            } else if (pdfView.isAnnotationRendering && cacheManager.needsAnnotationLayer(
+                    page = page,
+                    bounds = bounds,
+                    version = pdfView.pdfFile?.getAnnotationVersion(pageIndex = page) ?: 0
+                )
+            ) {
+                // The cached content is kept, only its annotation layer is rendered again
+                renderingHandler.addRenderingTask(
+                    page = page,
+                    width = renderWidth,
+                    height = renderHeight,
+                    bounds = bounds,
+                    isThumbnail = false,
+                    cacheOrder = cacheOrder,
+                    isBestQuality = pdfView.isBestQuality,
+                    isAnnotation = true,
+                    isAnnotationLayer = true
+                )
             }
             cacheOrder++
             return true
@@ -332,7 +351,7 @@ internal class PagesLoader(private val pdfView: PDFView) {
         return ceil(x = a).toInt()
     }
 
-    private data class GridSize(var column: Int = 0, var rows: Int = 0)
+    private data class GridSize(var column: Int = 0, var rows: Int = 0, var partSize: Float = PdfConstants.PART_SIZE)
 
     private data class Holder(var column: Int = 0, var row: Int = 0)
 
@@ -1,19 +1,45 @@
 package com.ahmer.pdfviewer
 
 import android.graphics.Bitmap
+import android.graphics.Canvas
+import android.graphics.Color
+import android.graphics.ColorMatrix
+import android.graphics.ColorMatrixColorFilter
+import android.graphics.Paint
+import android.graphics.PointF
 import android.graphics.Rect
 import android.graphics.RectF
+import android.os.SystemClock
+import android.util.Log
+import android.util.SparseArray
 import android.util.SparseBooleanArray
+import android.util.SparseIntArray
+import android.view.KeyEvent
+import androidx.core.graphics.createBitmap
+import com.ahmer.pdfium.PageComplexity
 import com.ahmer.pdfium.PdfDocument
+import com.ahmer.pdfium.PdfFingerprint
+import com.ahmer.pdfium.PdfReflowBlock
 import com.ahmer.pdfium.PdfTextPage
 import com.ahmer.pdfium.PdfWriteCallback
 import com.ahmer.pdfium.PdfiumCore
+import com.ahmer.pdfium.ScannedPage
 import com.ahmer.pdfium.util.Size
 import com.ahmer.pdfium.util.SizeF
 import com.ahmer.pdfviewer.exception.PageRenderingException
 import com.ahmer.pdfviewer.util.FitPolicy
+import com.ahmer.pdfviewer.util.JpegRegionDecoders
+import com.ahmer.pdfviewer.util.LayoutIndex
 import com.ahmer.pdfviewer.util.PageSizeCalculator
+import com.ahmer.pdfviewer.util.PdfConstants
+import com.ahmer.pdfviewer.util.PdfTracer
+import com.ahmer.pdfviewer.util.RenderCostModel
+import com.ahmer.pdfviewer.util.ScanImageCache
+import java.io.File
 import java.io.OutputStream
+import java.util.Collections
+import kotlin.math.ceil
+import kotlin.math.roundToInt
 
 class PdfFile(
     private val pdfDocument: PdfDocument,
@@ -23,14 +49,44 @@ class PdfFile(
     private val isFitEachPage: Boolean,
     private val isVertical: Boolean,
     private val spacingPixels: Int,
-    private var userPages: IntArray = intArrayOf()
+    private var userPages: IntArray = intArrayOf(),
+    private val isAutoCrop: Boolean = false,
+    indexDir: File? = null
 ) {
+    private val costModel: RenderCostModel = RenderCostModel()
+    private val annotationLayerBounds: SparseArray<List<RectF>> = SparseArray()
+    private val annotationVersions: SparseIntArray = SparseIntArray()
+    private val expensivePages: MutableSet<Int> = Collections.synchronizedSet(mutableSetOf())
     private val openedPages: SparseBooleanArray = SparseBooleanArray()
+    private val pageColorClasses: SparseIntArray = SparseIntArray()
+    private val measuredCrops: SparseArray<RectF> = SparseArray()
+    private val pageComplexities: SparseArray<PageComplexity> = SparseArray()
+    private val reflowBlocks: SparseArray<List<PdfReflowBlock>> = SparseArray()
+    private val scanCheckedPages: SparseBooleanArray = SparseBooleanArray()
+    private val jpegDecoders: JpegRegionDecoders = JpegRegionDecoders(maxDecoders = PdfConstants.Cache.MAX_JPEG_DECODERS)
+    private val scanImages: ScanImageCache = ScanImageCache(budgetBytes = PdfConstants.Cache.SCAN_CACHE_SIZE_BYTES)
+    private val scannedPages: SparseArray<ScannedPage> = SparseArray()
+    private val unappliedCropPages: MutableList<Int> = mutableListOf()
+    private val fullPageSizes: MutableList<Size> = mutableListOf()
     private val originalPageSizes: MutableList<Size> = mutableListOf()
+    private val pageCrops: MutableList<RectF> = mutableListOf()
     private val pageOffsets: MutableList<Float> = mutableListOf()
     private val pageSpacing: MutableList<Float> = mutableListOf()
     private val scaledPageSizes: MutableList<SizeF> = mutableListOf()
+    private val isTagged: Boolean by lazy { pdfiumCore.isTagged() }
+    private val densityDpi: Int = pdfiumCore.context.resources.displayMetrics.densityDpi
+    private val layoutIndexFile: File? = indexDir?.let { dir ->
+        pdfDocument.fingerprint?.let { LayoutIndex.fileFor(dir = dir, key = it.key) }
+    }
+
+    // Read before the properties it replaces, sizes measured at another density are not reused
+    private var layoutIndex: LayoutIndex? = layoutIndexFile?.let { LayoutIndex.read(file = it) }
+        ?.takeIf { it.pageCount == pdfDocument.totalPages && it.dpi == densityDpi }
+
+    private val indexWriteLock = Any()
 
+    @Volatile
+    private var isCropPending: Boolean = false
     private var documentLength: Float = 0f
     private var maxHeightPageSize: SizeF = SizeF(width = 0f, height = 0f)
     private var maxWidthPageSize: SizeF = SizeF(width = 0f, height = 0f)
@@ -74,7 +130,33 @@ class PdfFile(
     }
 
     fun getPageLinks(pageIndex: Int, size: SizeF, posX: Float, posY: Float): List<PdfDocument.Link> {
-        return pdfiumCore.getPageLinks(pageIndex = pageIndex, size = size, posX = posX, posY = posY)
+        val crop: RectF = getPageCrop(pageIndex = pageIndex)
+        val fullSize = SizeF(width = size.width / crop.width(), height = size.height / crop.height())
+        return pdfiumCore.getPageLinks(
+            pageIndex = pageIndex,
+            size = fullSize,
+            posX = posX + crop.left * fullSize.width,
+            posY = posY + crop.top * fullSize.height
+        )
+    }
+
+    /**
+     * Displayed region of the page relative to its full size, the whole page unless auto crop is enabled.
+     */
+    fun getPageCrop(pageIndex: Int): RectF = pageCrops.getOrNull(index = pageIndex) ?: FULL_PAGE
+
+    /**
+     * Maps bounds relative to the cropped page to bounds relative to the full page.
+     */
+    fun toUncroppedBounds(pageIndex: Int, bounds: RectF): RectF {
+        val crop: RectF = getPageCrop(pageIndex = pageIndex)
+        if (crop == FULL_PAGE) return bounds
+        return RectF(
+            crop.left + bounds.left * crop.width(),
+            crop.top + bounds.top * crop.height(),
+            crop.left + bounds.right * crop.width(),
+            crop.top + bounds.bottom * crop.height()
+        )
     }
 
     fun getPageOffset(pageIndex: Int, zoom: Float): Float {
@@ -104,29 +186,459 @@ class PdfFile(
     }
 
     fun mapRectToDevice(pageIndex: Int, startX: Int, startY: Int, sizeX: Int, sizeY: Int, rect: RectF): RectF {
+        val crop: RectF = getPageCrop(pageIndex = pageIndex)
+        val fullSizeX: Float = sizeX / crop.width()
+        val fullSizeY: Float = sizeY / crop.height()
         return pdfiumCore.mapRectToDevice(
             pageIndex = pageIndex,
-            startX = startX,
-            startY = startY,
-            sizeX = sizeX,
-            sizeY = sizeY,
+            startX = (startX - crop.left * fullSizeX).roundToInt(),
+            startY = (startY - crop.top * fullSizeY).roundToInt(),
+            sizeX = fullSizeX.roundToInt(),
+            sizeY = fullSizeY.roundToInt(),
             rotate = 0,
             coords = rect
         )
     }
 
-    fun renderPageBitmap(pageIndex: Int, bitmap: Bitmap, bounds: Rect, isAnnotation: Boolean) {
-        pdfiumCore.renderPageBitmap(
+    /**
+     * Renders the page into [bitmap] and feeds the time of complete renders to the cost model. Only the
+     * native render holds [PdfiumCore.lock], the bookkeeping runs after it is released.
+     *
+     * @param cacheOrder Order of the render task, for [PdfTracer]
+     */
+    fun renderPageBitmap(
+        pageIndex: Int, bitmap: Bitmap, bounds: Rect, isAnnotation: Boolean, isForms: Boolean = true,
+        budgetMs: Long = 0L, cacheOrder: Int = 0
+    ) {
+        var renderNanos = 0L
+        val status: Int = PdfTracer.locked(page = pageIndex, cacheOrder = cacheOrder) {
+            PdfTracer.section(stage = "render", page = pageIndex, cacheOrder = cacheOrder) {
+                val startNanos: Long = SystemClock.elapsedRealtimeNanos()
+                pdfiumCore.renderPageBitmap(
+                    pageIndex = pageIndex,
+                    bitmap = bitmap,
+                    startX = bounds.left,
+                    startY = bounds.top,
+                    drawSizeX = bounds.width(),
+                    drawSizeY = bounds.height(),
+                    annotation = isAnnotation,
+                    forms = isForms,
+                    budgetMs = budgetMs
+                ).also { renderNanos = SystemClock.elapsedRealtimeNanos() - startNanos }
+            }
+        }
+        if (status == PdfiumCore.RENDER_STATUS_DRAFT && expensivePages.add(pageIndex)) {
+            Log.w(PdfConstants.TAG, "Page $pageIndex exceeded the render budget of $budgetMs ms")
+        }
+        // Only complete renders are timed in full, drafts stop at the budget
+        if (status == PdfiumCore.RENDER_STATUS_COMPLETE) {
+            getPageComplexity(pageIndex = pageIndex)?.let { complexity ->
+                costModel.addSample(
+                    complexity = complexity,
+                    tilePixels = bitmap.width.toLong() * bitmap.height,
+                    renderMs = renderNanos / 1_000_000f
+                )
+            }
+        }
+    }
+
+    /**
+     * Renders the annotations and form fields of the page into [bitmap], see [PdfiumCore.renderAnnotationLayer]
+     *
+     * @return Whether the layer was rendered
+     */
+    fun renderAnnotationLayer(pageIndex: Int, bitmap: Bitmap, bounds: Rect): Boolean {
+        return pdfiumCore.renderAnnotationLayer(
             pageIndex = pageIndex,
             bitmap = bitmap,
             startX = bounds.left,
             startY = bounds.top,
             drawSizeX = bounds.width(),
-            drawSizeY = bounds.height(),
-            annotation = isAnnotation
+            drawSizeY = bounds.height()
+        ) == PdfiumCore.RENDER_STATUS_COMPLETE
+    }
+
+    /**
+     * Forwards a tap to the form fields of the page, see [PdfiumCore.onFormTouch]
+     *
+     * @param size Displayed size of the page
+     * @param posX X position within the displayed page
+     * @param posY Y position within the displayed page
+     * @return Whether a form field handled the tap
+     */
+    fun onFormTap(pageIndex: Int, size: SizeF, posX: Float, posY: Float): Boolean {
+        if (documentPage(userPage = pageIndex) < 0) return false
+        // Returns false when the page is already open, which visible pages are
+        openPage(pageIndex = pageIndex)
+        val crop: RectF = getPageCrop(pageIndex = pageIndex)
+        val fullSizeX: Float = size.width / crop.width()
+        val fullSizeY: Float = size.height / crop.height()
+        val point: PointF = pdfiumCore.mapDeviceCoordsToPage(
+            pageIndex = pageIndex,
+            startX = 0,
+            startY = 0,
+            sizeX = fullSizeX.roundToInt(),
+            sizeY = fullSizeY.roundToInt(),
+            rotate = 0,
+            deviceX = (posX + crop.left * fullSizeX).roundToInt(),
+            deviceY = (posY + crop.top * fullSizeY).roundToInt()
+        )
+        val isDownHandled: Boolean = pdfiumCore.onFormTouch(
+            pageIndex = pageIndex,
+            action = PdfiumCore.FORM_TOUCH_DOWN,
+            pageX = point.x.toDouble(),
+            pageY = point.y.toDouble()
+        )
+        val isUpHandled: Boolean = pdfiumCore.onFormTouch(
+            pageIndex = pageIndex,
+            action = PdfiumCore.FORM_TOUCH_UP,
+            pageX = point.x.toDouble(),
+            pageY = point.y.toDouble()
+        )
+        return isDownHandled || isUpHandled
+    }
+
+    fun onFormKey(pageIndex: Int, event: KeyEvent): Boolean {
+        val isDown: Boolean = event.action == KeyEvent.ACTION_DOWN
+        if (pdfiumCore.onFormKey(pageIndex = pageIndex, keyCode = event.keyCode, metaState = event.metaState, isDown = isDown)) {
+            return true
+        }
+        val charCode: Int = event.unicodeChar
+        return isDown && charCode != 0 && pdfiumCore.onFormChar(
+            pageIndex = pageIndex,
+            charCode = charCode,
+            metaState = event.metaState
+        )
+    }
+
+    fun onFormText(pageIndex: Int, text: CharSequence): Boolean {
+        var isHandled = false
+        for (char in text) {
+            isHandled = pdfiumCore.onFormChar(pageIndex = pageIndex, charCode = char.code) || isHandled
+        }
+        return isHandled
+    }
+
+    fun killFormFocus(): Boolean = pdfiumCore.killFormFocus()
+
+    /**
+     * Whether the focused form field takes typed text
+     */
+    fun isFormTextFocused(): Boolean {
+        return when (pdfiumCore.getFocusedFormFieldType()) {
+            PdfiumCore.FORM_FIELD_TEXT, PdfiumCore.FORM_FIELD_COMBOBOX -> true
+            else -> false
+        }
+    }
+
+    /**
+     * Areas repainted by the form fields since the last call, by page, relative to the displayed page
+     * like [com.ahmer.pdfviewer.model.PagePart.pageBounds]
+     */
+    fun takeFormDirtyBounds(): Map<Int, List<RectF>> {
+        return pdfiumCore.takeFormDirtyRects().mapValues { (pageIndex, rects) ->
+            val crop: RectF = getPageCrop(pageIndex = pageIndex)
+            rects.map { rect -> toPageBounds(pageIndex = pageIndex, rect = rect, crop = crop) }
+        }
+    }
+
+    /**
+     * Areas of the page drawn on its annotation layer, relative to the displayed page like
+     * [com.ahmer.pdfviewer.model.PagePart.pageBounds]. Parts outside of them need no layer. Read once per
+     * page, until [invalidateAnnotations], the page must be open.
+     */
+    fun getAnnotationLayerBounds(pageIndex: Int): List<RectF> {
+        val bounds: List<RectF> = synchronized(lock = lock) { annotationLayerBounds.get(pageIndex) }
+            ?: pdfiumCore.getAnnotationLayerRects(pageIndex = pageIndex).map { rect ->
+                toPageBounds(pageIndex = pageIndex, rect = rect, crop = FULL_PAGE)
+            }.also { bounds -> synchronized(lock = lock) { annotationLayerBounds.put(pageIndex, bounds) } }
+        // Kept relative to the full page, auto crop bounds may be applied meanwhile
+        val crop: RectF = getPageCrop(pageIndex = pageIndex)
+        if (crop == FULL_PAGE) return bounds
+        return bounds.map { rect ->
+            RectF(
+                (rect.left - crop.left) / crop.width(),
+                (rect.top - crop.top) / crop.height(),
+                (rect.right - crop.left) / crop.width(),
+                (rect.bottom - crop.top) / crop.height()
+            )
+        }
+    }
+
+    /**
+     * Maps a rect in page coordinates to bounds relative to the page displayed with [crop]
+     */
+    private fun toPageBounds(pageIndex: Int, rect: RectF, crop: RectF): RectF {
+        return pdfiumCore.mapRectToDevice(
+            pageIndex = pageIndex,
+            startX = 0,
+            startY = 0,
+            sizeX = DIRTY_RECT_SCALE,
+            sizeY = DIRTY_RECT_SCALE,
+            rotate = 0,
+            coords = rect
+        ).apply {
+            sort()
+            set(
+                (left / DIRTY_RECT_SCALE - crop.left) / crop.width(),
+                (top / DIRTY_RECT_SCALE - crop.top) / crop.height(),
+                (right / DIRTY_RECT_SCALE - crop.left) / crop.width(),
+                (bottom / DIRTY_RECT_SCALE - crop.top) / crop.height()
+            )
+        }
+    }
+
+    /**
+     * Version of the annotations of the page, increased by [invalidateAnnotations]
+     */
+    fun getAnnotationVersion(pageIndex: Int): Int {
+        synchronized(lock = lock) {
+            return annotationVersions.get(pageIndex, 0)
+        }
+    }
+
+    /**
+     * Marks the annotation layers of the page as outdated, after its form fields or annotations changed
+     */
+    fun invalidateAnnotations(pageIndex: Int) {
+        synchronized(lock = lock) {
+            annotationVersions.put(pageIndex, annotationVersions.get(pageIndex, 0) + 1)
+            annotationLayerBounds.delete(pageIndex)
+        }
+    }
+
+    /**
+     * The image of the page if it is a scan, detected once per page. The page must be open.
+     */
+    fun getScannedPage(pageIndex: Int): ScannedPage? {
+        synchronized(lock = lock) {
+            if (scanCheckedPages.get(pageIndex)) return scannedPages.get(pageIndex)
+        }
+        val scan: ScannedPage? = try {
+            pdfiumCore.getScannedPage(pageIndex = pageIndex)
+        } catch (e: Exception) {
+            Log.e(PdfConstants.TAG, "Cannot check page $pageIndex for a scan", e)
+            null
+        }
+        synchronized(lock = lock) {
+            scanCheckedPages.put(pageIndex, true)
+            if (scan != null) scannedPages.put(pageIndex, scan)
+        }
+        return scan
+    }
+
+    /**
+     * Reading order blocks of a tagged page for a reflow view, read from the structure tree once per
+     * page. Lay the text out natively at the screen width and draw figures with [renderReflowFigure].
+     *
+     * @return The blocks, empty when the document is not tagged or the page has no structure tree
+     */
+    fun getReflowBlocks(pageIndex: Int): List<PdfReflowBlock> {
+        synchronized(lock = lock) {
+            reflowBlocks.get(pageIndex)?.let { return it }
+        }
+        val blocks: List<PdfReflowBlock> = if (!isTagged) emptyList() else try {
+            openPage(pageIndex = pageIndex)
+            pdfiumCore.getReflowBlocks(pageIndex = pageIndex).orEmpty()
+        } catch (e: Exception) {
+            Log.e(PdfConstants.TAG, "Cannot read the structure of page $pageIndex", e)
+            emptyList()
+        }
+        synchronized(lock = lock) {
+            reflowBlocks.put(pageIndex, blocks)
+        }
+        return blocks
+    }
+
+    /**
+     * Renders a figure of [getReflowBlocks] at [width] pixels, only its region of the page is rasterized.
+     * Call it off the main thread.
+     *
+     * @return The figure, or null when it has no bounds or cannot be rendered
+     */
+    fun renderReflowFigure(pageIndex: Int, block: PdfReflowBlock, width: Int, isAnnotation: Boolean = false): Bitmap? {
+        val bounds: RectF = block.bounds
+        if (width <= 0 || bounds.width() <= 0f || bounds.top <= bounds.bottom) return null
+        val height: Int = (width * (bounds.top - bounds.bottom) / bounds.width()).roundToInt().coerceAtLeast(minimumValue = 1)
+        val bitmap: Bitmap = createBitmap(width = width, height = height)
+        val status: Int = try {
+            openPage(pageIndex = pageIndex)
+            pdfiumCore.renderPageRegion(pageIndex = pageIndex, region = bounds, bitmap = bitmap, annotation = isAnnotation)
+        } catch (e: Exception) {
+            Log.e(PdfConstants.TAG, "Cannot render a figure of page $pageIndex", e)
+            PdfiumCore.RENDER_STATUS_FAILED
+        }
+        if (status == PdfiumCore.RENDER_STATUS_FAILED) {
+            bitmap.recycle()
+            return null
+        }
+        return bitmap
+    }
+
+    /**
+     * Draws a scanned page without rasterizing it. JPEG scans are decoded per tile with a region decoder,
+     * subsampled to the tile scale, when [isJpegRegionDecoding] is set. Other scans are decoded once and
+     * scaled from a memory bounded cache.
+     *
+     * @param bounds Position and size of the whole page relative to [bitmap], as for [renderPageBitmap]
+     * @return Whether the page is a scan and was drawn
+     */
+    fun drawScannedPage(pageIndex: Int, bitmap: Bitmap, bounds: Rect, isJpegRegionDecoding: Boolean): Boolean {
+        val scan: ScannedPage = getScannedPage(pageIndex = pageIndex) ?: return false
+        val placement: RectF = scan.placement
+        val destination = RectF(
+            bounds.left + placement.left * bounds.width(),
+            bounds.top + placement.top * bounds.height(),
+            bounds.left + placement.right * bounds.width(),
+            bounds.top + placement.bottom * bounds.height()
+        )
+        if (isJpegRegionDecoding && JpegRegionDecoders.isSupported(image = scan.image) &&
+            drawJpegRegion(pageIndex = pageIndex, scan = scan, bitmap = bitmap, destination = destination)
+        ) return true
+        val image: Bitmap = getScanImage(pageIndex = pageIndex, scan = scan) ?: return false
+        drawScan(bitmap = bitmap, image = image, destination = destination)
+        return true
+    }
+
+    private fun drawJpegRegion(pageIndex: Int, scan: ScannedPage, bitmap: Bitmap, destination: RectF): Boolean {
+        val visible = RectF(0f, 0f, bitmap.width.toFloat(), bitmap.height.toFloat())
+        if (!visible.intersect(destination)) {
+            drawScan(bitmap = bitmap, image = null, destination = destination)
+            return true
+        }
+        // Visible part of the tile in image pixels, then back to the tile for the rounded region
+        val scaleX: Float = scan.image.width / destination.width()
+        val scaleY: Float = scan.image.height / destination.height()
+        val region = Rect(
+            ((visible.left - destination.left) * scaleX).toInt().coerceAtLeast(minimumValue = 0),
+            ((visible.top - destination.top) * scaleY).toInt().coerceAtLeast(minimumValue = 0),
+            ceil((visible.right - destination.left) * scaleX).toInt().coerceAtMost(maximumValue = scan.image.width),
+            ceil((visible.bottom - destination.top) * scaleY).toInt().coerceAtMost(maximumValue = scan.image.height)
+        )
+        if (region.isEmpty) return false
+        val sampleSize: Int = JpegRegionDecoders.sampleSize(
+            regionWidth = region.width(),
+            regionHeight = region.height(),
+            targetWidth = visible.width(),
+            targetHeight = visible.height()
+        )
+        val decoded: Bitmap = jpegDecoders.decodeRegion(pageIndex = pageIndex, region = region, sampleSize = sampleSize) {
+            pdfiumCore.getImageData(image = scan.image)
+        } ?: return false
+        drawScan(
+            bitmap = bitmap,
+            image = decoded,
+            destination = RectF(
+                destination.left + region.left / scaleX,
+                destination.top + region.top / scaleY,
+                destination.left + region.right / scaleX,
+                destination.top + region.bottom / scaleY
+            )
         )
+        decoded.recycle()
+        return true
+    }
+
+    private fun drawScan(bitmap: Bitmap, image: Bitmap?, destination: RectF) {
+        val canvas = Canvas(bitmap)
+        if (bitmap.config == Bitmap.Config.ALPHA_8) {
+            // ALPHA_8 parts hold ink coverage, white paper stays transparent
+            image?.let { canvas.drawBitmap(it, null, destination, coveragePaint) }
+        } else {
+            canvas.drawColor(Color.WHITE)
+            image?.let { canvas.drawBitmap(it, null, destination, scanPaint) }
+        }
+    }
+
+    private fun getScanImage(pageIndex: Int, scan: ScannedPage): Bitmap? {
+        scanImages.get(pageIndex = pageIndex)?.let { return it }
+        // Subsampled while decoding so the full resolution image never reaches the Java heap
+        val factor: Int = ScanImageCache.subsampleFactor(
+            width = scan.image.width,
+            height = scan.image.height,
+            maxBytes = PdfConstants.Cache.SCAN_IMAGE_MAX_BYTES
+        )
+        val image: Bitmap = pdfiumCore.getImageBitmap(image = scan.image, sampleSize = factor) ?: return null
+        scanImages.put(pageIndex = pageIndex, image = image)
+        return image
+    }
+
+    /**
+     * Content statistics of the page, null until [scanPageComplexity] reached it.
+     */
+    fun getPageComplexity(pageIndex: Int): PageComplexity? {
+        synchronized(lock = lock) {
+            return pageComplexities.get(pageIndex)
+        }
+    }
+
+    /**
+     * Collects the content statistics of a page for the cost model. Does nothing if it was already scanned.
+     */
+    fun scanPageComplexity(pageIndex: Int) {
+        if (getPageComplexity(pageIndex = pageIndex) != null) return
+        val complexity: PageComplexity = try {
+            pdfiumCore.getPageComplexity(pageIndex = pageIndex)
+        } catch (e: Exception) {
+            Log.e(PdfConstants.TAG, "Cannot scan page $pageIndex", e)
+            PageComplexity.EMPTY
+        }
+        val complexities: List<PageComplexity> = synchronized(lock = lock) {
+            pageComplexities.put(pageIndex, complexity)
+            if (pageComplexities.size() < pagesCount) return
+            List(size = pagesCount) { i -> pageComplexities.get(i) }
+        }
+        saveLayoutIndex(complexities = complexities)
+    }
+
+    /**
+     * Predicted render time of a tile of the page in milliseconds, null if the page was not scanned yet.
+     */
+    fun predictRenderMs(pageIndex: Int, tilePixels: Long): Float? {
+        val complexity: PageComplexity = getPageComplexity(pageIndex = pageIndex) ?: return null
+        return costModel.predictMs(complexity = complexity, tilePixels = tilePixels)
+    }
+
+    /**
+     * Whether tiles of the page are predicted to be slow, either because a render already exceeded
+     * the budget or because the cost model says a standard tile takes longer than [PdfConstants.SLOW_TILE_MS].
+     * Slow pages are tiled coarser, so their content is walked fewer times, and rendered after cheaper pages.
+     */
+    fun isPageSlow(pageIndex: Int): Boolean {
+        if (isPageExpensive(pageIndex = pageIndex)) return true
+        val partPixels: Long = (PdfConstants.PART_SIZE * PdfConstants.PART_SIZE).toLong()
+        val predicted: Float = predictRenderMs(pageIndex = pageIndex, tilePixels = partPixels) ?: return false
+        return predicted > PdfConstants.SLOW_TILE_MS
+    }
+
+    /**
+     * Size in pixels of the tiles the page is split into
+     */
+    fun getPartSize(pageIndex: Int): Float {
+        return if (isPageSlow(pageIndex = pageIndex)) PdfConstants.SLOW_PAGE_PART_SIZE else PdfConstants.PART_SIZE
+    }
+
+    /**
+     * Color class of the page, see [PdfiumCore.getPageColorClass]. Detected once per page.
+     */
+    fun getPageColorClass(pageIndex: Int, isAnnotation: Boolean): Int {
+        synchronized(lock = lock) {
+            val cached: Int = pageColorClasses.get(pageIndex, -1)
+            if (cached >= 0) return cached
+        }
+        val colorClass: Int = pdfiumCore.getPageColorClass(pageIndex = pageIndex, annotation = isAnnotation)
+        synchronized(lock = lock) {
+            pageColorClasses.put(pageIndex, colorClass)
+        }
+        return colorClass
     }
 
+    /**
+     * Whether a render of the page exceeded its budget. Such pages are rendered at reduced quality
+     * and after cheaper pages.
+     */
+    fun isPageExpensive(pageIndex: Int): Boolean = expensivePages.contains(pageIndex)
+
     @Throws(exceptionClasses = [PageRenderingException::class])
     fun openPage(pageIndex: Int): Boolean {
         synchronized(lock = lock) {
@@ -197,9 +709,29 @@ class PdfFile(
         }
     }
 
-    val bookmarks: List<PdfDocument.Bookmark> = pdfDocument.bookmarks
+    private val outline: List<PdfDocument.OutlineEntry> = layoutIndex?.outline ?: pdfDocument.getOutline()
+
+    val bookmarks: List<PdfDocument.Bookmark> = PdfDocument.bookmarksOf(outline = outline)
+
+    val metaData: PdfDocument.Meta = layoutIndex?.meta ?: pdfDocument.metaData
+
+    /**
+     * Character count of every page, from the layout index once it has been counted for the document
+     */
+    val pageCharCounts: IntArray by lazy {
+        layoutIndex?.pageCharCounts ?: pdfDocument.pageCharCounts.also { counts ->
+            val isUpdated: Boolean = synchronized(lock = lock) {
+                val index: LayoutIndex = layoutIndex ?: return@synchronized false
+                layoutIndex = index.copy(pageCharCounts = counts)
+                true
+            }
+            if (isUpdated) writeLayoutIndex()
+        }
+    }
+
+    val summary: PdfDocument.Summary get() = pdfDocument.summary
 
-    val metaData: PdfDocument.Meta = pdfDocument.metaData
+    val fingerprint: PdfFingerprint? get() = pdfDocument.fingerprint
 
     val totalPages: Int = pdfDocument.totalPages
 
@@ -254,26 +786,166 @@ class PdfFile(
     }
 
     private fun setup(viewSize: Size) {
+        // The index holds every page of the document, a page selection is measured from the document
+        val index: LayoutIndex? = layoutIndex?.takeIf { userPages.isEmpty() }
+        val indexCrops: List<RectF>? = index?.pageCrops?.takeIf { isAutoCrop }
+        synchronized(lock = lock) {
+            index?.pageComplexities?.forEachIndexed { i, complexity -> pageComplexities.put(i, complexity) }
+        }
         (0 until pagesCount).forEach { i ->
-            getPageSizeNative(pageIndex = i).let { pageSize ->
-                if (pageSize.width > originalMaxWidthPageSize.width) {
-                    originalMaxWidthPageSize = pageSize
-                }
-                if (pageSize.height > originalMaxHeightPageSize.height) {
-                    originalMaxHeightPageSize = pageSize
-                }
-                originalPageSizes.add(pageSize)
-            }
+            // With auto crop the layout and tiling only see the content region of each page. Pages whose
+            // bounds are not in the index are laid out whole until measureContentBounds reaches them
+            val crop: RectF = indexCrops?.get(index = i) ?: FULL_PAGE
+            val fullSize: Size = index?.pageSizes?.get(index = i) ?: getPageSizeNative(pageIndex = i)
+            pageCrops.add(crop)
+            fullPageSizes.add(fullSize)
+            originalPageSizes.add(croppedSize(fullSize = fullSize, crop = crop))
         }
+        isCropPending = isAutoCrop && indexCrops == null
+        prepareMaxPageSizes()
+        saveLayoutIndex(crops = indexCrops)
         recalculatePageSizes(viewSize = viewSize)
     }
 
+    private fun croppedSize(fullSize: Size, crop: RectF): Size = Size(
+        width = (fullSize.width * crop.width()).roundToInt(),
+        height = (fullSize.height * crop.height()).roundToInt()
+    )
+
+    private fun prepareMaxPageSizes() {
+        originalMaxWidthPageSize = originalPageSizes.maxByOrNull { it.width } ?: Size(width = 0, height = 0)
+        originalMaxHeightPageSize = originalPageSizes.maxByOrNull { it.height } ?: Size(width = 0, height = 0)
+    }
+
+    /**
+     * Measures the content bounds of a page for auto crop, off the main thread, and stores them for
+     * [applyMeasuredCrops]. Does nothing without auto crop or once the page was measured.
+     */
+    fun measureContentBounds(pageIndex: Int) {
+        if (!isCropPending) return
+        synchronized(lock = lock) {
+            if (measuredCrops.indexOfKey(pageIndex) >= 0) return
+        }
+        val crop: RectF = try {
+            pdfiumCore.getPageContentBounds(pageIndex = pageIndex)
+        } catch (e: Exception) {
+            Log.e(PdfConstants.TAG, "Cannot measure the content of page $pageIndex", e)
+            FULL_PAGE
+        }
+        val crops: List<RectF> = synchronized(lock = lock) {
+            measuredCrops.put(pageIndex, crop)
+            unappliedCropPages.add(pageIndex)
+            if (measuredCrops.size() < pagesCount) return
+            isCropPending = false
+            List(size = pagesCount) { i -> measuredCrops.get(i) }
+        }
+        saveLayoutIndex(crops = crops)
+    }
+
+    /**
+     * Whether pages measured by [measureContentBounds] wait for [applyMeasuredCrops]
+     */
+    val hasUnappliedCrops: Boolean
+        get() = synchronized(lock = lock) { unappliedCropPages.isNotEmpty() }
+
+    /**
+     * Lays the pages measured by [measureContentBounds] out at their content bounds, on the main thread
+     *
+     * @return Pages whose crop changed, their rendered parts no longer match the layout
+     */
+    fun applyMeasuredCrops(viewSize: Size): List<Int> {
+        val changed: MutableList<Int> = mutableListOf()
+        synchronized(lock = lock) {
+            unappliedCropPages.forEach { page ->
+                val crop: RectF = measuredCrops.get(page)
+                if (crop == pageCrops[page]) return@forEach
+                pageCrops[page] = crop
+                originalPageSizes[page] = croppedSize(fullSize = fullPageSizes[page], crop = crop)
+                changed.add(page)
+            }
+            unappliedCropPages.clear()
+        }
+        if (changed.isNotEmpty()) {
+            prepareMaxPageSizes()
+            recalculatePageSizes(viewSize = viewSize)
+        }
+        return changed
+    }
+
+    /**
+     * Stores what was measured while opening the document, unless the index already had all of it
+     *
+     * @param crops Content bounds of every page, null while they are not all measured
+     * @param complexities Complexity of every page, null while they are not all scanned
+     */
+    private fun saveLayoutIndex(crops: List<RectF>? = null, complexities: List<PageComplexity>? = null) {
+        if (layoutIndexFile == null || userPages.isNotEmpty()) return
+        synchronized(lock = lock) {
+            val index: LayoutIndex? = layoutIndex
+            layoutIndex = when {
+                index == null -> LayoutIndex(
+                    dpi = densityDpi,
+                    pageSizes = fullPageSizes.toList(),
+                    pageCrops = crops,
+                    pageCharCounts = null,
+                    pageComplexities = complexities,
+                    meta = metaData,
+                    outline = outline
+                )
+
+                crops != null && index.pageCrops == null -> index.copy(pageCrops = crops)
+                complexities != null && index.pageComplexities == null -> index.copy(pageComplexities = complexities)
+                else -> return
+            }
+        }
+        writeLayoutIndex()
+    }
+
+    /**
+     * Writes the latest index outside of [lock], which renders wait on. Writes are serialized and each
+     * one takes the index current at that time, so an older index never replaces a newer one.
+     */
+    private fun writeLayoutIndex() {
+        val file: File = layoutIndexFile ?: return
+        synchronized(lock = indexWriteLock) {
+            val index: LayoutIndex = synchronized(lock = lock) { layoutIndex } ?: return
+            index.write(file = file)
+            val dir: File = file.parentFile ?: return
+            LayoutIndex.trim(dir = dir, maxBytes = PdfConstants.Cache.LAYOUT_INDEX_MAX_BYTES)
+        }
+    }
+
     fun dispose() {
+        jpegDecoders.clear()
+        scanImages.clear()
         pdfDocument.close()
         userPages = intArrayOf()
     }
 
     companion object {
+        private val FULL_PAGE = RectF(0f, 0f, 1f, 1f)
+
+        /**
+         * Device size dirty areas are mapped at before being made relative to the page
+         */
+        private const val DIRTY_RECT_SCALE: Int = 10_000
+        private val scanPaint = Paint(Paint.FILTER_BITMAP_FLAG)
+
+        /**
+         * Turns the luminance of a scan into ink coverage (255 - gray level) in the alpha channel
+         */
+        private val coveragePaint = Paint(Paint.FILTER_BITMAP_FLAG).apply {
+            colorFilter = ColorMatrixColorFilter(
+                ColorMatrix(
+                    floatArrayOf(
+                        0f, 0f, 0f, 0f, 0f,
+                        0f, 0f, 0f, 0f, 0f,
+                        0f, 0f, 0f, 0f, 0f,
+                        -0.299f, -0.587f, -0.114f, 0f, 255f
+                    )
+                )
+            )
+        }
         private val lock = Any()
 
         fun create(
@@ -286,6 +958,8 @@ class PdfFile(
             spacingPixels: Int,
             userPages: IntArray = intArrayOf(),
             size: Size,
+            isAutoCrop: Boolean = false,
+            indexDir: File? = null,
         ): PdfFile {
             return PdfFile(
                 pdfDocument = pdfDocument,
@@ -295,7 +969,9 @@ class PdfFile(
                 isFitEachPage = isFitEachPage,
                 isVertical = isVertical,
                 spacingPixels = spacingPixels,
-                userPages = userPages
+                userPages = userPages,
+                isAutoCrop = isAutoCrop,
+                indexDir = indexDir
             ).apply { setup(viewSize = size) }
         }
     }
@@ -8,19 +8,24 @@ import android.graphics.Matrix
 import android.graphics.Paint
 import android.graphics.Rect
 import android.graphics.RectF
+import android.os.SystemClock
 import android.util.Log
 import androidx.core.graphics.createBitmap
+import com.ahmer.pdfium.PdfiumCore
 import com.ahmer.pdfviewer.exception.PageRenderingException
 import com.ahmer.pdfviewer.model.PagePart
 import com.ahmer.pdfviewer.util.PdfConstants
+import com.ahmer.pdfviewer.util.PdfTracer
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.ExperimentalCoroutinesApi
+import kotlinx.coroutines.Job
 import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.channels.Channel
 import kotlinx.coroutines.flow.consumeAsFlow
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
+import kotlinx.coroutines.yield
 import kotlin.math.roundToInt
 
 class RenderingHandler(private val pdfView: PDFView) {
@@ -30,6 +35,7 @@ class RenderingHandler(private val pdfView: PDFView) {
     private val renderMatrix: Matrix = Matrix()
     private val roundedBounds: Rect = Rect()
     private var isRunning: Boolean = false
+    private var scanJob: Job? = null
 
     fun start() {
         if (isRunning) return
@@ -43,10 +49,13 @@ class RenderingHandler(private val pdfView: PDFView) {
                 }
             }
         }
+        scanJob = coroutineScope.launch { scanPages() }
     }
 
     fun stop() {
         isRunning = false
+        scanJob?.cancel()
+        scanJob = null
         channel.trySend(element = RenderMessage.Stop)
     }
 
@@ -55,15 +64,46 @@ class RenderingHandler(private val pdfView: PDFView) {
         while (!channel.isEmpty) channel.tryReceive().getOrNull()
     }
 
+    @OptIn(ExperimentalCoroutinesApi::class)
     private suspend fun handleTask(task: RenderMessage.RenderingTask) {
+        // Slow pages go behind the tiles queued after them, once, so they don't hold up cheap pages
+        if (!task.isDeferred && !channel.isEmpty && pdfView.pdfFile?.isPageSlow(pageIndex = task.page) == true) {
+            channel.trySend(element = task.copy(isDeferred = true))
+            return
+        }
+        PdfTracer.record(
+            stage = "queue",
+            startNanos = task.queuedNanos,
+            endNanos = SystemClock.elapsedRealtimeNanos(),
+            page = task.page,
+            cacheOrder = task.cacheOrder
+        )
         try {
+            // Parts rendered for a crop that auto crop replaced meanwhile no longer match the layout
+            val crop: RectF? = pdfView.pdfFile?.getPageCrop(pageIndex = task.page)
             val bitmapPagePart: PagePart = proceed(task = task) ?: return
             if (isRunning) {
+                val hopStart: Long = SystemClock.elapsedRealtimeNanos()
                 withContext(context = Dispatchers.Main) {
-                    pdfView.onBitmapRendered(part = bitmapPagePart)
+                    if (pdfView.pdfFile?.getPageCrop(pageIndex = task.page) !== crop) {
+                        bitmapPagePart.renderedBitmap?.recycle()
+                        bitmapPagePart.annotationBitmap?.recycle()
+                        return@withContext
+                    }
+                    PdfTracer.record(
+                        stage = "mainHop",
+                        startNanos = hopStart,
+                        endNanos = SystemClock.elapsedRealtimeNanos(),
+                        page = task.page,
+                        cacheOrder = task.cacheOrder
+                    )
+                    PdfTracer.section(stage = "deliver", page = task.page, cacheOrder = task.cacheOrder) {
+                        pdfView.onBitmapRendered(part = bitmapPagePart)
+                    }
                 }
             } else {
                 bitmapPagePart.renderedBitmap?.recycle()
+                bitmapPagePart.annotationBitmap?.recycle()
             }
         } catch (e: PageRenderingException) {
             withContext(context = Dispatchers.Main) {
@@ -74,7 +114,7 @@ class RenderingHandler(private val pdfView: PDFView) {
 
     fun addRenderingTask(
         page: Int, width: Float, height: Float, bounds: RectF, isThumbnail: Boolean,
-        cacheOrder: Int, isBestQuality: Boolean, isAnnotation: Boolean
+        cacheOrder: Int, isBestQuality: Boolean, isAnnotation: Boolean, isAnnotationLayer: Boolean = false
     ) {
         channel.trySend(
             element = RenderMessage.RenderingTask(
@@ -85,7 +125,8 @@ class RenderingHandler(private val pdfView: PDFView) {
                 isThumbnail = isThumbnail,
                 cacheOrder = cacheOrder,
                 isBestQuality = isBestQuality,
-                isAnnotation = isAnnotation
+                isAnnotation = isAnnotation,
+                isAnnotationLayer = isAnnotationLayer
             )
         )
     }
@@ -94,28 +135,64 @@ class RenderingHandler(private val pdfView: PDFView) {
     private fun proceed(task: RenderMessage.RenderingTask): PagePart? {
         val pdfFile: PdfFile = pdfView.pdfFile ?: return null
         pdfFile.openPage(pageIndex = task.page)
+        // Read before rendering, so an edit made meanwhile leaves the part outdated
+        val version: Int = pdfFile.getAnnotationVersion(pageIndex = task.page)
+        if (task.isAnnotationLayer) return proceedAnnotationLayer(pdfFile = pdfFile, task = task, version = version)
 
-        val width: Int = task.width.roundToInt()
-        val height: Int = task.height.roundToInt()
+        // Pages that exceeded the render budget before, or are predicted to, are rendered at reduced size and quality
+        val isExpensive: Boolean = !task.isThumbnail && (pdfFile.isPageExpensive(pageIndex = task.page) ||
+                isPredictedOverBudget(pdfFile = pdfFile, task = task))
+        val scale: Float = if (isExpensive) PdfConstants.EXPENSIVE_PAGE_SCALE else 1f
+        val isBestQuality: Boolean = task.isBestQuality && !isExpensive
+        val width: Int = (task.width * scale).roundToInt()
+        val height: Int = (task.height * scale).roundToInt()
         if (width == 0 || height == 0 || pdfFile.pageHasError(page = task.page)) return null
 
+        val config: Bitmap.Config = bitmapConfig(pdfFile = pdfFile, task = task, isBestQuality = isBestQuality)
         var bitmap: Bitmap
         bitmap = try {
-            createBitmap(width = width, height = height, config = bitmapConfig(isBestQuality = task.isBestQuality))
+            PdfTracer.section(stage = "allocate", page = task.page, cacheOrder = task.cacheOrder) {
+                createBitmap(width = width, height = height, config = config)
+            }
         } catch (e: IllegalArgumentException) {
             Log.e(PdfConstants.TAG, "Cannot create bitmap", e)
             return null
         }
 
-        calculateBounds(width = width, height = height, sliceRect = task.bounds)
-        pdfFile.renderPageBitmap(
-            pageIndex = task.page,
-            bitmap = bitmap,
-            bounds = roundedBounds,
-            isAnnotation = task.isAnnotation
+        calculateBounds(
+            width = width,
+            height = height,
+            sliceRect = pdfFile.toUncroppedBounds(pageIndex = task.page, bounds = task.bounds)
         )
-        if (pdfView.isNightMode) {
-            bitmap = toNightMode(bitmap = bitmap, bestQuality = task.isBestQuality)
+        // Scanned pages are drawn from their decoded image, without rasterizing the page
+        val isScanDrawn: Boolean = pdfView.isScanDrawing && PdfTracer.section(
+            stage = "scanDraw",
+            page = task.page,
+            cacheOrder = task.cacheOrder
+        ) {
+            pdfFile.drawScannedPage(
+                pageIndex = task.page,
+                bitmap = bitmap,
+                bounds = roundedBounds,
+                isJpegRegionDecoding = pdfView.isJpegRegionDecoding
+            )
+        }
+        if (!isScanDrawn) {
+            pdfFile.renderPageBitmap(
+                pageIndex = task.page,
+                bitmap = bitmap,
+                bounds = roundedBounds,
+                // Parts get the annotations on a layer of their own, see renderAnnotationLayer()
+                isAnnotation = task.isAnnotation && task.isThumbnail,
+                budgetMs = pdfView.renderBudgetMs,
+                cacheOrder = task.cacheOrder
+            )
+        }
+        // ALPHA_8 parts hold ink coverage and are colored for night mode when drawn
+        if (pdfView.isNightMode && config != Bitmap.Config.ALPHA_8) {
+            bitmap = PdfTracer.section(stage = "nightMode", page = task.page, cacheOrder = task.cacheOrder) {
+                toNightMode(bitmap = bitmap, config = config)
+            }
         }
         return PagePart(
             page = task.page,
@@ -123,7 +200,98 @@ class RenderingHandler(private val pdfView: PDFView) {
             pageBounds = task.bounds,
             isThumbnail = task.isThumbnail,
             cacheOrder = task.cacheOrder
+        ).apply {
+            // Thumbnails have the annotations drawn in
+            if (!task.isThumbnail && task.isAnnotation) {
+                annotationBitmap = renderAnnotationLayer(pdfFile = pdfFile, task = task, width = width, height = height)
+                annotationVersion = version
+            }
+        }
+    }
+
+    /**
+     * Renders only the annotation layer of a part already cached, to be attached to it with
+     * [CacheManager.attachAnnotationLayer]
+     */
+    private fun proceedAnnotationLayer(pdfFile: PdfFile, task: RenderMessage.RenderingTask, version: Int): PagePart? {
+        val width: Int = task.width.roundToInt()
+        val height: Int = task.height.roundToInt()
+        if (width == 0 || height == 0 || pdfFile.pageHasError(page = task.page)) return null
+
+        calculateBounds(
+            width = width,
+            height = height,
+            sliceRect = pdfFile.toUncroppedBounds(pageIndex = task.page, bounds = task.bounds)
         )
+        return PagePart(
+            page = task.page,
+            renderedBitmap = null,
+            pageBounds = task.bounds,
+            isThumbnail = false,
+            cacheOrder = task.cacheOrder,
+            isAnnotationLayer = true
+        ).apply {
+            annotationBitmap = renderAnnotationLayer(pdfFile = pdfFile, task = task, width = width, height = height)
+            annotationVersion = version
+        }
+    }
+
+    /**
+     * Renders the annotations and form fields within [roundedBounds] over a transparent bitmap, null if
+     * none of them reaches the part
+     */
+    private fun renderAnnotationLayer(pdfFile: PdfFile, task: RenderMessage.RenderingTask, width: Int, height: Int): Bitmap? {
+        val bounds: List<RectF> = pdfFile.getAnnotationLayerBounds(pageIndex = task.page)
+        if (bounds.none { RectF.intersects(it, task.bounds) }) return null
+        var layer: Bitmap = try {
+            createBitmap(width = width, height = height, config = Bitmap.Config.ARGB_8888)
+        } catch (e: IllegalArgumentException) {
+            Log.e(PdfConstants.TAG, "Cannot create annotation layer", e)
+            return null
+        }
+        val isRendered: Boolean = PdfTracer.locked(page = task.page, cacheOrder = task.cacheOrder) {
+            PdfTracer.section(stage = "annotations", page = task.page, cacheOrder = task.cacheOrder) {
+                pdfFile.renderAnnotationLayer(pageIndex = task.page, bitmap = layer, bounds = roundedBounds)
+            }
+        }
+        if (!isRendered) {
+            layer.recycle()
+            return null
+        }
+        if (pdfView.isNightMode) layer = toNightMode(bitmap = layer, config = Bitmap.Config.ARGB_8888)
+        return layer
+    }
+
+    private fun isPredictedOverBudget(pdfFile: PdfFile, task: RenderMessage.RenderingTask): Boolean {
+        val budgetMs: Long = pdfView.renderBudgetMs
+        if (budgetMs <= 0) return false
+        // The image pixels of a scan weigh on its prediction, but scans are not rasterized
+        if (pdfView.isScanDrawing && pdfFile.getScannedPage(pageIndex = task.page) != null) return false
+        val tilePixels: Long = (task.width * task.height).toLong()
+        val predicted: Float = pdfFile.predictRenderMs(pageIndex = task.page, tilePixels = tilePixels) ?: return false
+        return predicted > budgetMs
+    }
+
+    /**
+     * Collects the complexity of every page in the background, starting at the current page, so the cost
+     * model can tell slow pages apart before they are rendered. With auto crop, the content bounds of the
+     * pages are measured on the way and laid out in batches.
+     */
+    private suspend fun scanPages() {
+        val pdfFile: PdfFile = pdfView.pdfFile ?: return
+        val count: Int = pdfFile.pagesCount
+        val first: Int = pdfView.currentPage.coerceIn(minimumValue = 0, maximumValue = maxOf(a = count - 1, b = 0))
+        for (i in 0 until count) {
+            if (!isRunning) return
+            val page: Int = (first + i) % count
+            pdfFile.measureContentBounds(pageIndex = page)
+            pdfFile.scanPageComplexity(pageIndex = page)
+            val isBatchEnd: Boolean = i == 1 || (i + 1) % PdfConstants.CROP_BATCH_PAGES == 0 || i == count - 1
+            if (isBatchEnd && pdfFile.hasUnappliedCrops) {
+                withContext(context = Dispatchers.Main) { pdfView.onContentBoundsMeasured() }
+            }
+            yield()
+        }
     }
 
     private fun calculateBounds(width: Int, height: Int, sliceRect: RectF) {
@@ -136,8 +304,7 @@ class RenderingHandler(private val pdfView: PDFView) {
         bounds.round(roundedBounds)
     }
 
-    private fun toNightMode(bitmap: Bitmap, bestQuality: Boolean): Bitmap {
-        val config: Bitmap.Config = bitmapConfig(isBestQuality = bestQuality)
+    private fun toNightMode(bitmap: Bitmap, config: Bitmap.Config): Bitmap {
         val newBitmap: Bitmap = createBitmap(width = bitmap.width, height = bitmap.height, config = config)
         val paint = Paint().apply {
             colorFilter = ColorMatrixColorFilter(ColorMatrix().apply {
@@ -165,6 +332,19 @@ class RenderingHandler(private val pdfView: PDFView) {
         return if (isBestQuality) Bitmap.Config.ARGB_8888 else Bitmap.Config.RGB_565
     }
 
+    /**
+     * Adaptive mode picks the smallest format able to hold the page: ALPHA_8 for gray pages,
+     * the quality setting for opaque color pages and ARGB_8888 for pages with transparency
+     */
+    private fun bitmapConfig(pdfFile: PdfFile, task: RenderMessage.RenderingTask, isBestQuality: Boolean): Bitmap.Config {
+        if (!pdfView.isAdaptiveBitmapFormat) return bitmapConfig(isBestQuality = isBestQuality)
+        return when (pdfFile.getPageColorClass(pageIndex = task.page, isAnnotation = task.isAnnotation)) {
+            PdfiumCore.PAGE_COLOR_GRAY -> Bitmap.Config.ALPHA_8
+            PdfiumCore.PAGE_COLOR_OPAQUE -> bitmapConfig(isBestQuality = isBestQuality)
+            else -> Bitmap.Config.ARGB_8888
+        }
+    }
+
     sealed class RenderMessage {
         data class RenderingTask(
             val page: Int,
@@ -174,7 +354,10 @@ class RenderingHandler(private val pdfView: PDFView) {
             val isThumbnail: Boolean,
             val cacheOrder: Int,
             val isBestQuality: Boolean,
-            val isAnnotation: Boolean
+            val isAnnotation: Boolean,
+            val isAnnotationLayer: Boolean = false,
+            val isDeferred: Boolean = false,
+            val queuedNanos: Long = SystemClock.elapsedRealtimeNanos()
         ) : RenderMessage()
 
         object Stop : RenderMessage()
@@ -9,8 +9,23 @@ class PagePart(
     val renderedBitmap: Bitmap?,
     val pageBounds: RectF,
     val isThumbnail: Boolean,
-    var cacheOrder: Int
+    var cacheOrder: Int,
+    val isAnnotationLayer: Boolean = false
 ) {
+    /**
+     * Annotations and form fields of the part, drawn over [renderedBitmap]. Rendered apart so filling a
+     * field or hiding the annotations leaves the page content untouched. Null when none reaches the part.
+     */
+    var annotationBitmap: Bitmap? = null
+
+    /**
+     * Annotation version of the page when [annotationBitmap] was rendered, -1 if it was not
+     */
+    var annotationVersion: Int = -1
+
+    val byteCount: Int
+        get() = (renderedBitmap?.allocationByteCount ?: 0) + (annotationBitmap?.allocationByteCount ?: 0)
+
     override fun equals(other: Any?): Boolean {
         if (other !is PagePart) {
             return false
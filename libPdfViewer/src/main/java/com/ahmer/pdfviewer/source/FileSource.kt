@@ -1,7 +1,6 @@
 package com.ahmer.pdfviewer.source
 
 import android.content.Context
-import android.os.ParcelFileDescriptor
 import com.ahmer.pdfium.PdfDocument
 import com.ahmer.pdfium.PdfiumCore
 import java.io.File
@@ -11,9 +10,6 @@ class FileSource(private val file: File) : DocumentSource {
 
     @Throws(IOException::class)
     override fun createDocument(context: Context, pdfiumCore: PdfiumCore, password: String?): PdfDocument {
-        return pdfiumCore.newDocument(
-            parcelFileDescriptor = ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY),
-            password = password
-        )
+        return pdfiumCore.newDocument(file = file, password = password)
     }
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+package com.ahmer.pdfviewer.util
+
+import android.graphics.Bitmap
+import android.graphics.BitmapFactory
+import android.graphics.BitmapRegionDecoder
+import android.graphics.Rect
+import android.os.Build
+import android.util.Log
+import android.util.LruCache
+import com.ahmer.pdfium.PdfImageInfo
+import java.io.IOException
+
+/**
+ * Region decoders over the JPEG data of scanned pages. A tile then decodes only the part of the scan it
+ * shows, subsampled by the JPEG decoder to the tile scale, instead of the whole image at full resolution.
+ *
+ * Decoders are created and used under one lock, so an evicted decoder is never recycled while it decodes.
+ */
+class JpegRegionDecoders(maxDecoders: Int) {
+    private val lock = Any()
+    private val decoders: LruCache<Int, BitmapRegionDecoder> = object : LruCache<Int, BitmapRegionDecoder>(maxDecoders) {
+        override fun entryRemoved(evicted: Boolean, key: Int, oldValue: BitmapRegionDecoder, newValue: BitmapRegionDecoder?) {
+            oldValue.recycle()
+        }
+    }
+
+    /**
+     * Decodes a region of the page scan
+     *
+     * @param pageIndex Page of the scan
+     * @param region Region of the image to decode, in image pixels
+     * @param sampleSize Power of two subsample factor
+     * @param data Supplies the JPEG data if the page has no decoder yet
+     * @return The decoded region, or null if the data cannot be decoded
+     */
+    fun decodeRegion(pageIndex: Int, region: Rect, sampleSize: Int, data: () -> ByteArray?): Bitmap? {
+        synchronized(lock = lock) {
+            val decoder: BitmapRegionDecoder = decoders.get(pageIndex) ?: createDecoder(data = data)?.also {
+                decoders.put(pageIndex, it)
+            } ?: return null
+            val options = BitmapFactory.Options().apply {
+                inSampleSize = sampleSize
+                inPreferredConfig = Bitmap.Config.ARGB_8888
+            }
+            return try {
+                decoder.decodeRegion(region, options)
+            } catch (e: IllegalArgumentException) {
+                Log.e(PdfConstants.TAG, "Cannot decode region $region of page $pageIndex", e)
+                null
+            }
+        }
+    }
+
+    fun clear() {
+        synchronized(lock = lock) {
+            decoders.evictAll()
+        }
+    }
+
+    private fun createDecoder(data: () -> ByteArray?): BitmapRegionDecoder? {
+        val bytes: ByteArray = data() ?: return null
+        return try {
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S) {
+                BitmapRegionDecoder.newInstance(bytes, 0, bytes.size)
+            } else {
+                @Suppress("DEPRECATION")
+                BitmapRegionDecoder.newInstance(bytes, 0, bytes.size, false)
+            }
+        } catch (e: IOException) {
+            Log.e(PdfConstants.TAG, "Cannot read the JPEG data of a scan", e)
+            null
+        }
+    }
+
+    companion object {
+        /**
+         * Whether the scan image is a JPEG the platform decoder renders like PDFium: gray or RGB data.
+         * CMYK JPEGs, often stored inverted by Adobe applications, go through PDFium.
+         */
+        fun isSupported(image: PdfImageInfo): Boolean {
+            return image.isJpeg && (image.colorSpace == PdfImageInfo.COLOR_SPACE_DEVICE_GRAY ||
+                    image.colorSpace == PdfImageInfo.COLOR_SPACE_DEVICE_RGB)
+        }
+
+        /**
+         * Largest power of two subsample factor keeping a region of [regionWidth] by [regionHeight] image
+         * pixels at least as large as the [targetWidth] by [targetHeight] pixels it is drawn to
+         */
+        fun sampleSize(regionWidth: Int, regionHeight: Int, targetWidth: Float, targetHeight: Float): Int {
+            var sampleSize = 1
+            while (regionWidth / (sampleSize * 2) >= targetWidth && regionHeight / (sampleSize * 2) >= targetHeight) {
+                sampleSize *= 2
+            }
+            return sampleSize
+        }
+    }
+}
@@ -0,0 +1,235 @@
+package com.ahmer.pdfviewer.util
+
+import android.graphics.RectF
+import android.util.Log
+import com.ahmer.pdfium.PageComplexity
+import com.ahmer.pdfium.PdfDocument
+import com.ahmer.pdfium.util.Size
+import java.io.File
+import java.io.IOException
+import java.io.RandomAccessFile
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.channels.FileChannel
+
+/**
+ * Results of the full-document scans done when a document is opened (page sizes, content bounds, char
+ * counts, page complexities, metadata and outline), kept on disk under the document fingerprint so that
+ * reopening the document skips them. An index is never modified, [copy] makes the updated one.
+ *
+ * The file is little-endian and read through a memory map: a header (magic, version, page count,
+ * density of the sizes, section flags), the page sizes in pixels, the optional page crops, char counts
+ * and complexities, the eight metadata strings, then the outline entries (depth, page, x, y, zoom, title
+ * offset and length) followed by their titles as one string. Strings are a char count followed by UTF-16
+ * chars, absent positions are NaN.
+ */
+internal class LayoutIndex(
+    val dpi: Int,
+    val pageSizes: List<Size>,
+    val pageCrops: List<RectF>?,
+    val pageCharCounts: IntArray?,
+    val pageComplexities: List<PageComplexity>?,
+    val meta: PdfDocument.Meta,
+    val outline: List<PdfDocument.OutlineEntry>,
+) {
+    val pageCount: Int get() = pageSizes.size
+
+    fun copy(
+        pageCrops: List<RectF>? = this.pageCrops,
+        pageCharCounts: IntArray? = this.pageCharCounts,
+        pageComplexities: List<PageComplexity>? = this.pageComplexities,
+    ): LayoutIndex = LayoutIndex(
+        dpi = dpi,
+        pageSizes = pageSizes,
+        pageCrops = pageCrops,
+        pageCharCounts = pageCharCounts,
+        pageComplexities = pageComplexities,
+        meta = meta,
+        outline = outline
+    )
+
+    /**
+     * Writes the index through a temporary file, so that readers never see a partial one
+     */
+    fun write(file: File) {
+        val buffer: ByteBuffer = ByteBuffer.allocate(byteCount()).order(ByteOrder.LITTLE_ENDIAN)
+        var flags = 0
+        if (pageCrops != null) flags = flags or FLAG_CROPS
+        if (pageCharCounts != null) flags = flags or FLAG_CHAR_COUNTS
+        if (pageComplexities != null) flags = flags or FLAG_COMPLEXITIES
+        buffer.putInt(MAGIC).putInt(VERSION).putInt(pageCount).putInt(dpi).putInt(flags)
+        pageSizes.forEach { buffer.putInt(it.width).putInt(it.height) }
+        pageCrops?.forEach { buffer.putFloat(it.left).putFloat(it.top).putFloat(it.right).putFloat(it.bottom) }
+        pageCharCounts?.forEach { buffer.putInt(it) }
+        pageComplexities?.forEach {
+            buffer.putInt(it.objectCount).putInt(it.textCount).putInt(it.imageCount)
+            buffer.putLong(it.imagePixels).putLong(it.pathSegments)
+            buffer.putInt(it.transparentCount).putInt(it.shadingCount)
+        }
+        metaValues(meta = meta).forEach { buffer.putString(value = it.orEmpty()) }
+        buffer.putInt(outline.size)
+        var titleOffset = 0
+        outline.forEach { entry ->
+            buffer.putInt(entry.depth).putInt(entry.pageIndex)
+            buffer.putFloat(entry.x ?: Float.NaN).putFloat(entry.y ?: Float.NaN).putFloat(entry.zoom ?: Float.NaN)
+            buffer.putInt(titleOffset).putInt(entry.title.length)
+            titleOffset += entry.title.length
+        }
+        buffer.putString(value = outline.joinToString(separator = "") { it.title })
+
+        val temp = File(file.parentFile, "${file.name}.tmp")
+        try {
+            file.parentFile?.mkdirs()
+            temp.outputStream().use { it.write(buffer.array()) }
+            if (!temp.renameTo(file)) temp.delete()
+        } catch (e: IOException) {
+            Log.w(PdfConstants.TAG, "Cannot write the layout index ${file.name}", e)
+            temp.delete()
+        }
+    }
+
+    private fun byteCount(): Int {
+        val titleChars: Int = outline.sumOf { it.title.length }
+        return HEADER_BYTES + pageCount * 2 * Int.SIZE_BYTES +
+                (pageCrops?.size ?: 0) * 4 * Float.SIZE_BYTES +
+                (pageCharCounts?.size ?: 0) * Int.SIZE_BYTES +
+                (pageComplexities?.size ?: 0) * COMPLEXITY_BYTES +
+                metaValues(meta = meta).sumOf { Int.SIZE_BYTES + it.orEmpty().length * Char.SIZE_BYTES } +
+                Int.SIZE_BYTES + outline.size * OUTLINE_ENTRY_BYTES + Int.SIZE_BYTES + titleChars * Char.SIZE_BYTES
+    }
+
+    companion object {
+        /** "PDFI" read as a little-endian int. */
+        private const val MAGIC: Int = 0x49464450
+        private const val VERSION: Int = 2
+        private const val HEADER_BYTES: Int = 5 * Int.SIZE_BYTES
+        private const val COMPLEXITY_BYTES: Int = 5 * Int.SIZE_BYTES + 2 * Long.SIZE_BYTES
+        private const val OUTLINE_ENTRY_BYTES: Int = 7 * Int.SIZE_BYTES
+        private const val FLAG_CROPS: Int = 1 shl 0
+        private const val FLAG_CHAR_COUNTS: Int = 1 shl 1
+        private const val FLAG_COMPLEXITIES: Int = 1 shl 2
+        private const val FILE_SUFFIX: String = ".idx"
+
+        fun fileFor(dir: File, key: String): File = File(dir, "$key$FILE_SUFFIX")
+
+        /**
+         * Deletes the least recently used indexes of [dir], by modification time, beyond [maxBytes]
+         */
+        fun trim(dir: File, maxBytes: Long) {
+            val files: List<File> = dir.listFiles { file -> file.name.endsWith(suffix = FILE_SUFFIX) }
+                ?.sortedByDescending { it.lastModified() } ?: return
+            var keptBytes = 0L
+            files.forEach { file ->
+                keptBytes += file.length()
+                if (keptBytes > maxBytes) file.delete()
+            }
+        }
+
+        /**
+         * Reads an index written by [write], marking it as recently used for [trim]
+         *
+         * @return The index, or null when the file is missing, from another version or damaged
+         */
+        fun read(file: File): LayoutIndex? {
+            if (!file.isFile) return null
+            return try {
+                RandomAccessFile(file, "r").use { input ->
+                    val buffer: ByteBuffer = input.channel.map(FileChannel.MapMode.READ_ONLY, 0, input.length())
+                        .order(ByteOrder.LITTLE_ENDIAN)
+                    if (buffer.getInt() != MAGIC || buffer.getInt() != VERSION) return null
+                    val pageCount: Int = buffer.getInt().checkCount(buffer = buffer, bytesPerItem = 2 * Int.SIZE_BYTES)
+                    val dpi: Int = buffer.getInt()
+                    val flags: Int = buffer.getInt()
+                    val pageSizes: List<Size> = List(size = pageCount) {
+                        Size(width = buffer.getInt(), height = buffer.getInt())
+                    }
+                    val pageCrops: List<RectF>? = if (flags and FLAG_CROPS == 0) null else List(size = pageCount) {
+                        RectF(buffer.getFloat(), buffer.getFloat(), buffer.getFloat(), buffer.getFloat())
+                    }
+                    val pageCharCounts: IntArray? = if (flags and FLAG_CHAR_COUNTS == 0) null else {
+                        IntArray(size = pageCount) { buffer.getInt() }
+                    }
+                    val pageComplexities: List<PageComplexity>? = if (flags and FLAG_COMPLEXITIES == 0) null else {
+                        List(size = pageCount) {
+                            PageComplexity(
+                                objectCount = buffer.getInt(),
+                                textCount = buffer.getInt(),
+                                imageCount = buffer.getInt(),
+                                imagePixels = buffer.getLong(),
+                                pathSegments = buffer.getLong(),
+                                transparentCount = buffer.getInt(),
+                                shadingCount = buffer.getInt()
+                            )
+                        }
+                    }
+                    val meta = PdfDocument.Meta(
+                        title = buffer.getString(),
+                        author = buffer.getString(),
+                        subject = buffer.getString(),
+                        keywords = buffer.getString(),
+                        creator = buffer.getString(),
+                        producer = buffer.getString(),
+                        creationDate = buffer.getString(),
+                        modDate = buffer.getString(),
+                    )
+                    val outline: List<PdfDocument.OutlineEntry> = readOutline(buffer = buffer)
+                    LayoutIndex(
+                        dpi = dpi,
+                        pageSizes = pageSizes,
+                        pageCrops = pageCrops,
+                        pageCharCounts = pageCharCounts,
+                        pageComplexities = pageComplexities,
+                        meta = meta,
+                        outline = outline
+                    )
+                }.also { file.setLastModified(System.currentTimeMillis()) }
+            } catch (e: IOException) {
+                Log.w(PdfConstants.TAG, "Cannot read the layout index ${file.name}", e)
+                null
+            } catch (_: RuntimeException) {
+                // Truncated or damaged, it is written again on the next open
+                null
+            }
+        }
+
+        private fun readOutline(buffer: ByteBuffer): List<PdfDocument.OutlineEntry> {
+            val count: Int = buffer.getInt().checkCount(buffer = buffer, bytesPerItem = OUTLINE_ENTRY_BYTES)
+            val entries: List<IntArray> = List(size = count) { IntArray(size = 7) { buffer.getInt() } }
+            val titles: String = buffer.getString()
+            return entries.mapIndexed { i, values ->
+                PdfDocument.OutlineEntry(
+                    nativePtr = 0L,
+                    depth = values[0],
+                    title = titles.substring(values[5], values[5] + values[6]),
+                    pageIndex = values[1],
+                    x = Float.fromBits(values[2]).takeUnless { it.isNaN() },
+                    y = Float.fromBits(values[3]).takeUnless { it.isNaN() },
+                    zoom = Float.fromBits(values[4]).takeUnless { it.isNaN() },
+                    hasChildren = entries.getOrNull(index = i + 1)?.let { it[0] > values[0] } ?: false,
+                    isExpanded = true
+                )
+            }
+        }
+
+        private fun metaValues(meta: PdfDocument.Meta): List<String?> = with(meta) {
+            listOf(title, author, subject, keywords, creator, producer, creationDate, modDate)
+        }
+
+        // Counts larger than the rest of the file come from a damaged index
+        private fun Int.checkCount(buffer: ByteBuffer, bytesPerItem: Int): Int {
+            require(value = this >= 0 && this.toLong() * bytesPerItem <= buffer.remaining()) { "Damaged index" }
+            return this
+        }
+
+        private fun ByteBuffer.putString(value: String): ByteBuffer {
+            putInt(value.length)
+            value.forEach { putChar(it) }
+            return this
+        }
+
+        private fun ByteBuffer.getString(): String {
+            val length: Int = getInt().checkCount(buffer = this, bytesPerItem = Char.SIZE_BYTES)
+            return String(CharArray(size = length) { getChar() })
+        }
+    }
+}
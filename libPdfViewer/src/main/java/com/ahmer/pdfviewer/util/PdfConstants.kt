@@ -26,12 +26,81 @@ object PdfConstants {
      */
     const val MAX_PAGES: Int = 15
 
+    /**
+     * Time budget of a single tile render, in milliseconds (0 disables it).
+     * Pages exceeding it are drawn as a draft and rendered at reduced quality afterwards
+     */
+    const val RENDER_BUDGET_MS: Long = 1500L
+
+    /**
+     * Scale applied to tiles of pages that exceeded the render budget
+     */
+    const val EXPENSIVE_PAGE_SCALE: Float = 0.5f
+
+    /**
+     * Predicted time of a [PART_SIZE] tile above which a page is treated as slow, in milliseconds
+     */
+    const val SLOW_TILE_MS: Float = 120f
+
+    /**
+     * The size of the rendered parts of slow pages. Every tile walks the whole page content, so
+     * complex pages render faster overall in fewer, larger tiles
+     */
+    const val SLOW_PAGE_PART_SIZE: Float = 768f
+
+    /**
+     * Pages measured for auto crop between two relayouts, after the first two which are laid out at once
+     */
+    const val CROP_BATCH_PAGES: Int = 32
+
     object Cache {
         /**
          * The size of the cache (number of bitmaps kept)
          */
         const val CACHE_SIZE: Int = 150 // Default 150
+
+        /**
+         * Memory budget of the cache in bytes, the size of [CACHE_SIZE] ARGB_8888 parts of [PART_SIZE].
+         * RGB_565 parts take half of that and ALPHA_8 parts a quarter, so the number of bitmaps kept
+         * depends on the pages being viewed, but is at least [CACHE_SIZE] unless native memory is short
+         */
+        const val CACHE_SIZE_BYTES: Long = (CACHE_SIZE * PART_SIZE * PART_SIZE * 4).toLong()
+
+        /**
+         * Smallest budget the cache is shrunk to when native memory use is high
+         */
+        const val CACHE_MIN_SIZE_BYTES: Long = CACHE_SIZE_BYTES / 4
+
+        /**
+         * Native memory PDFium may hold before the cache budget is reduced by the excess
+         */
+        const val NATIVE_MEMORY_ALLOWANCE_BYTES: Long = 48L * 1024 * 1024
         const val THUMBNAILS_CACHE_SIZE: Int = 10 // Default 8
+
+        /**
+         * Memory budget of the decoded images of scanned pages, in bytes
+         */
+        const val SCAN_CACHE_SIZE_BYTES: Int = 32 * 1024 * 1024
+
+        /**
+         * Largest decoded scan image, in bytes. Larger images are subsampled by powers of two
+         */
+        const val SCAN_IMAGE_MAX_BYTES: Long = 16L * 1024 * 1024
+
+        /**
+         * Number of JPEG region decoders kept for scanned pages, each holds the JPEG data of its page
+         */
+        const val MAX_JPEG_DECODERS: Int = 4
+
+        /**
+         * Directory of the layout indexes, under the cache directory of the app
+         */
+        const val LAYOUT_INDEX_DIR: String = "pdf_layout_index"
+
+        /**
+         * Disk budget of the layout indexes, the least recently opened documents are dropped beyond it
+         */
+        const val LAYOUT_INDEX_MAX_BYTES: Long = 4L * 1024 * 1024
     }
 
     object Pinch {
@@ -0,0 +1,166 @@
+package com.ahmer.pdfviewer.util
+
+import android.os.Process
+import android.os.SystemClock
+import android.os.Trace
+import com.ahmer.pdfium.PdfiumCore
+import java.io.File
+import java.io.IOException
+
+/**
+ * Traces the stages of the tile render pipeline: waiting in the render queue, waiting for [PdfiumCore.lock], rendering in PDFium, color conversion and the hop to the main thread.
+ *
+ * Every stage is emitted as a system trace section ([Trace]), visible in Perfetto or Systrace, next to the
+ * `pdfium:` sections of the native library. While [isRecording], stages are also kept in a ring buffer that
+ * [exportChromeTrace] writes as a Chrome trace JSON file, to analyze jank without a connected profiler.
+ */
+object PdfTracer {
+    const val DEFAULT_CAPACITY: Int = 4096
+
+    private val lock = Any()
+    private val threadNames: MutableMap<Int, String> = mutableMapOf()
+    private var names: Array<String?> = arrayOfNulls(size = 0)
+    private var startNanos: LongArray = LongArray(size = 0)
+    private var durationNanos: LongArray = LongArray(size = 0)
+    private var threadIds: IntArray = IntArray(size = 0)
+    private var pages: IntArray = IntArray(size = 0)
+    private var cacheOrders: IntArray = IntArray(size = 0)
+    private var next: Int = 0
+    private var size: Int = 0
+
+    /**
+     * Whether stages are being recorded for [exportChromeTrace]
+     */
+    @Volatile
+    var isRecording: Boolean = false
+        private set
+
+    /**
+     * Starts recording, dropping previously recorded events. Once [capacity] events are recorded,
+     * the oldest ones are overwritten.
+     */
+    fun startRecording(capacity: Int = DEFAULT_CAPACITY) {
+        require(value = capacity > 0) { "Capacity must be positive" }
+        synchronized(lock = lock) {
+            names = arrayOfNulls(size = capacity)
+            startNanos = LongArray(size = capacity)
+            durationNanos = LongArray(size = capacity)
+            threadIds = IntArray(size = capacity)
+            pages = IntArray(size = capacity)
+            cacheOrders = IntArray(size = capacity)
+            threadNames.clear()
+            next = 0
+            size = 0
+            isRecording = true
+        }
+    }
+
+    /**
+     * Stops recording. Recorded events stay available to [exportChromeTrace].
+     */
+    fun stopRecording() {
+        isRecording = false
+    }
+
+    /**
+     * Runs [block] inside a trace section named after the stage and the tile.
+     *
+     * @param stage Name of the pipeline stage
+     * @param page Page of the tile
+     * @param cacheOrder Cache order of the tile, identifying it within the page
+     */
+    inline fun <T> section(stage: String, page: Int, cacheOrder: Int, block: () -> T): T {
+        Trace.beginSection("$stage page=$page order=$cacheOrder")
+        val start: Long = SystemClock.elapsedRealtimeNanos()
+        try {
+            return block()
+        } finally {
+            Trace.endSection()
+            if (isRecording) {
+                record(
+                    stage = stage,
+                    startNanos = start,
+                    endNanos = SystemClock.elapsedRealtimeNanos(),
+                    page = page,
+                    cacheOrder = cacheOrder
+                )
+            }
+        }
+    }
+
+    /**
+     * Runs [block] holding [PdfiumCore.lock], tracing the wait for it as the `lockWait` stage. The wait is
+     * timed by [PdfiumCore.withLock], so it is counted once in [PdfiumCore.getStats] too.
+     */
+    inline fun <T> locked(page: Int, cacheOrder: Int, block: () -> T): T {
+        Trace.beginSection("lockWait page=$page order=$cacheOrder")
+        return PdfiumCore.withLock(onAcquired = { waitNanos ->
+            Trace.endSection()
+            val end: Long = SystemClock.elapsedRealtimeNanos()
+            record(stage = "lockWait", startNanos = end - waitNanos, endNanos = end, page = page, cacheOrder = cacheOrder)
+        }, block = block)
+    }
+
+    /**
+     * Records a stage measured by the caller, e.g. a wait spanning two threads. Only the recorder sees it,
+     * system trace sections cannot start and end on different threads.
+     */
+    fun record(stage: String, startNanos: Long, endNanos: Long, page: Int, cacheOrder: Int) {
+        if (!isRecording) return
+        val tid: Int = Process.myTid()
+        synchronized(lock = lock) {
+            if (names.isEmpty()) return
+            names[next] = stage
+            this.startNanos[next] = startNanos
+            durationNanos[next] = endNanos - startNanos
+            threadIds[next] = tid
+            pages[next] = page
+            cacheOrders[next] = cacheOrder
+            next = (next + 1) % names.size
+            if (size < names.size) size++
+            if (tid !in threadNames) threadNames[tid] = Thread.currentThread().name
+        }
+    }
+
+    /**
+     * Writes the recorded events as a Chrome trace (open it in ui.perfetto.dev or chrome://tracing).
+     *
+     * @param file Destination file, overwritten
+     * @return Number of events written
+     */
+    @Throws(exceptionClasses = [IOException::class])
+    fun exportChromeTrace(file: File): Int {
+        val pid: Int = Process.myPid()
+        val json = StringBuilder()
+        val count: Int
+        synchronized(lock = lock) {
+            count = size
+            json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[")
+            threadNames.entries.forEachIndexed { i, (tid, name) ->
+                if (i > 0) json.append(',')
+                json.append("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":").append(pid)
+                    .append(",\"tid\":").append(tid)
+                    .append(",\"args\":{\"name\":\"").append(escape(value = name)).append("\"}}")
+            }
+            val first: Int = if (size < names.size) 0 else next
+            for (i in 0 until size) {
+                val index: Int = (first + i) % names.size
+                if (i > 0 || threadNames.isNotEmpty()) json.append(',')
+                json.append("{\"ph\":\"X\",\"cat\":\"render\",\"name\":\"").append(escape(value = names[index]))
+                    .append("\",\"pid\":").append(pid)
+                    .append(",\"tid\":").append(threadIds[index])
+                    .append(",\"ts\":").append(startNanos[index] / 1000.0)
+                    .append(",\"dur\":").append(durationNanos[index] / 1000.0)
+                    .append(",\"args\":{\"page\":").append(pages[index])
+                    .append(",\"cacheOrder\":").append(cacheOrders[index]).append("}}")
+            }
+            json.append("]}")
+        }
+        file.writeText(text = json.toString())
+        return count
+    }
+
+    private fun escape(value: String?): String {
+        return value.orEmpty().replace(oldValue = "\\", newValue = "\\\\").replace(oldValue = "\"", newValue = "\\\"")
+    }
+}
@@ -0,0 +1,110 @@
+package com.ahmer.pdfviewer.util
+
+import com.ahmer.pdfium.PageComplexity
+import kotlin.math.abs
+
+/**
+ * Linear estimate of the time needed to render a tile, learned from measured renders.
+ *
+ * The cost is modelled as a weighted sum of the page content (objects, image pixels, path segments,
+ * transparency, shadings), walked for every tile, and of the tile pixel count. The weights start from
+ * conservative priors and are refitted with ridge regression towards those priors as samples come in,
+ * so a few unusual renders cannot swing the predictions.
+ */
+class RenderCostModel {
+    private val lock = Any()
+    private val normal: Array<DoubleArray> = Array(size = FEATURES) { DoubleArray(size = FEATURES) }
+    private val target: DoubleArray = DoubleArray(size = FEATURES)
+    private var weights: DoubleArray = PRIOR_WEIGHTS.copyOf()
+    private var pendingSamples: Int = 0
+    private var _sampleCount: Int = 0
+
+    /**
+     * Number of renders the model has learned from
+     */
+    val sampleCount: Int get() = synchronized(lock = lock) { _sampleCount }
+
+    /**
+     * Predicted render time of a tile, in milliseconds
+     *
+     * @param complexity Content statistics of the page
+     * @param tilePixels Pixel count of the rendered tile
+     */
+    fun predictMs(complexity: PageComplexity, tilePixels: Long): Float {
+        val features: DoubleArray = features(complexity = complexity, tilePixels = tilePixels)
+        synchronized(lock = lock) {
+            return features.indices.sumOf { features[it] * weights[it] }.coerceAtLeast(minimumValue = 0.0).toFloat()
+        }
+    }
+
+    /**
+     * Records a measured render. Drafts and interrupted renders must not be recorded, their time is truncated.
+     */
+    fun addSample(complexity: PageComplexity, tilePixels: Long, renderMs: Float) {
+        val features: DoubleArray = features(complexity = complexity, tilePixels = tilePixels)
+        synchronized(lock = lock) {
+            for (i in 0 until FEATURES) {
+                for (j in 0 until FEATURES) normal[i][j] += features[i] * features[j]
+                target[i] += features[i] * renderMs
+            }
+            _sampleCount++
+            if (++pendingSamples >= REFIT_INTERVAL) {
+                pendingSamples = 0
+                refit()
+            }
+        }
+    }
+
+    private fun refit() {
+        // Solve (XᵀX + λI) w = Xᵀy + λ w₀ with Gaussian elimination on the augmented matrix
+        val matrix: Array<DoubleArray> = Array(size = FEATURES) { i ->
+            DoubleArray(size = FEATURES + 1) { j ->
+                when {
+                    j == FEATURES -> target[i] + RIDGE * PRIOR_WEIGHTS[i]
+                    i == j -> normal[i][j] + RIDGE
+                    else -> normal[i][j]
+                }
+            }
+        }
+        for (column in 0 until FEATURES) {
+            val pivot: Int = (column until FEATURES).maxByOrNull { abs(x = matrix[it][column]) } ?: return
+            if (abs(x = matrix[pivot][column]) < 1e-9) return
+            matrix[pivot] = matrix[column].also { matrix[column] = matrix[pivot] }
+            for (row in 0 until FEATURES) {
+                if (row == column) continue
+                val factor: Double = matrix[row][column] / matrix[column][column]
+                for (j in column..FEATURES) matrix[row][j] -= factor * matrix[column][j]
+            }
+        }
+        // Negative weights would reward content, keep the prior for those features instead
+        weights = DoubleArray(size = FEATURES) { i ->
+            (matrix[i][FEATURES] / matrix[i][i]).takeIf { it >= 0.0 } ?: PRIOR_WEIGHTS[i]
+        }
+    }
+
+    private fun features(complexity: PageComplexity, tilePixels: Long): DoubleArray = doubleArrayOf(
+        1.0,
+        complexity.objectCount / 100.0,
+        complexity.imagePixels / 1_000_000.0,
+        complexity.pathSegments / 1000.0,
+        complexity.transparentCount / 10.0,
+        complexity.shadingCount.toDouble(),
+        tilePixels / 1_000_000.0
+    )
+
+    companion object {
+        private const val FEATURES: Int = 7
+        private const val REFIT_INTERVAL: Int = 8
+
+        /**
+         * Weight of the priors, in samples
+         */
+        private const val RIDGE: Double = 4.0
+
+        /**
+         * Milliseconds per unit of each feature: base, 100 objects, image megapixel, 1000 path segments,
+         * 10 transparent objects, shading and tile megapixel
+         */
+        private val PRIOR_WEIGHTS: DoubleArray = doubleArrayOf(2.0, 1.0, 15.0, 4.0, 8.0, 10.0, 12.0)
+    }
+}
@@ -0,0 +1,35 @@
+package com.ahmer.pdfviewer.util
+
+import android.graphics.Bitmap
+import android.util.LruCache
+
+/**
+ * Decoded images of scanned pages, least recently used ones are dropped beyond [budgetBytes].
+ * Evicted bitmaps are not recycled, a render may still be drawing from them.
+ */
+class ScanImageCache(budgetBytes: Int) {
+    private val cache: LruCache<Int, Bitmap> = object : LruCache<Int, Bitmap>(budgetBytes) {
+        override fun sizeOf(key: Int, value: Bitmap): Int = value.allocationByteCount
+    }
+
+    fun get(pageIndex: Int): Bitmap? = cache.get(pageIndex)
+
+    fun put(pageIndex: Int, image: Bitmap) {
+        cache.put(pageIndex, image)
+    }
+
+    fun clear() {
+        cache.evictAll()
+    }
+
+    companion object {
+        /**
+         * Smallest power of two subsample factor bringing an ARGB_8888 image within [maxBytes]
+         */
+        fun subsampleFactor(width: Int, height: Int, maxBytes: Long): Int {
+            var factor = 1
+            while ((width / factor).toLong() * (height / factor) * 4 > maxBytes) factor *= 2
+            return factor
+        }
+    }
+}
@@ -39,6 +39,14 @@ android {
     }
 
     buildTypes {
+        debug {
+            @Suppress("UnstableApiUsage")
+            externalNativeBuild {
+                cmake {
+                    arguments += "-DPDFIUM_JNI_STATS=ON"
+                }
+            }
+        }
         release {
             isMinifyEnabled = false
             proguardFiles(getDefaultProguardFile(name = "proguard-android-optimize.txt"), "proguard-rules.pro")
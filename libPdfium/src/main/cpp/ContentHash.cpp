@@ -0,0 +1,80 @@
+#include "ContentHash.h"
+
+#include <string.h>
+
+namespace {
+
+    const int kLanes = 8;
+    const size_t kStripeBytes = kLanes * sizeof(uint64_t);
+    // Stripes accumulated between two scrambles of the lanes
+    const int kStripesPerBlock = 16;
+
+    const uint64_t kPrime32 = 0x9E3779B1ULL;
+    const uint64_t kPrime64a = 0x9E3779B185EBCA87ULL;
+    const uint64_t kPrime64b = 0xC2B2AE3D27D4EB4FULL;
+
+    uint64_t splitMix64(uint64_t *state) {
+        uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t avalanche(uint64_t value) {
+        value ^= value >> 33;
+        value *= kPrime64b;
+        value ^= value >> 29;
+        value *= kPrime64a;
+        return value ^ (value >> 32);
+    }
+
+    // Plain loops over the lanes, left for the compiler to vectorize
+    void accumulate(uint64_t *acc, const uint8_t *stripe, const uint64_t *keys) {
+        uint64_t values[kLanes];
+        memcpy(values, stripe, kStripeBytes);
+        for (int i = 0; i < kLanes; i++) {
+            const uint64_t keyed = values[i] ^ keys[i];
+            // Neighbour lanes also take the raw input, so that no input bit is lost to the multiply
+            acc[i ^ 1] += values[i];
+            acc[i] += (keyed & 0xFFFFFFFFULL) * (keyed >> 32);
+        }
+    }
+
+    void scramble(uint64_t *acc, const uint64_t *keys) {
+        for (int i = 0; i < kLanes; i++) {
+            acc[i] = ((acc[i] ^ (acc[i] >> 47)) ^ keys[i]) * kPrime32;
+        }
+    }
+}
+
+namespace ContentHash {
+
+    uint64_t hash64(const void *data, size_t size, uint64_t seed) {
+        uint64_t state = seed;
+        uint64_t keys[kLanes];
+        uint64_t acc[kLanes];
+        for (int i = 0; i < kLanes; i++) {
+            keys[i] = splitMix64(&state);
+            acc[i] = splitMix64(&state);
+        }
+
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        const size_t stripes = size / kStripeBytes;
+        for (size_t i = 0; i < stripes; i++) {
+            accumulate(acc, bytes + i * kStripeBytes, keys);
+            if ((i + 1) % kStripesPerBlock == 0) scramble(acc, keys);
+        }
+        const size_t tail = size - stripes * kStripeBytes;
+        if (tail > 0) {
+            uint8_t last[kStripeBytes] = {0};
+            memcpy(last, bytes + stripes * kStripeBytes, tail);
+            accumulate(acc, last, keys);
+        }
+
+        uint64_t result = seed ^ (size * kPrime64a);
+        for (int i = 0; i < kLanes; i++) {
+            result = avalanche(result ^ (acc[i] + keys[kLanes - 1 - i]));
+        }
+        return result;
+    }
+}
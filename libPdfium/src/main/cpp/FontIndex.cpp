@@ -0,0 +1,568 @@
+#include "FontIndex.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "include/util.h"
+
+extern "C" {
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+namespace {
+
+    const char *kFontsDir = "/system/fonts";
+    const char *kIndexFileName = "pdfium_font_index.bin";
+    const uint32_t kIndexMagic = 0x58444946; // "FIDX"
+    const uint32_t kIndexVersion = 1;
+
+    const uint32_t kTagTtcf = 0x74746366; // 'ttcf'
+    const uint32_t kTagName = 0x6E616D65; // 'name'
+    const uint32_t kTagOs2 = 0x4F532F32;  // 'OS/2'
+    const uint32_t kTagHead = 0x68656164; // 'head'
+
+    // OS/2 ulCodePageRange1 bit -> PDFium charset.
+    const struct {
+        int bit;
+        int charset;
+    } kCodePageCharsets[] = {
+            {0,  FXFONT_ANSI_CHARSET},
+            {1,  FXFONT_EASTERNEUROPEAN_CHARSET},
+            {2,  FXFONT_CYRILLIC_CHARSET},
+            {3,  FXFONT_GREEK_CHARSET},
+            {5,  FXFONT_HEBREW_CHARSET},
+            {6,  FXFONT_ARABIC_CHARSET},
+            {8,  FXFONT_VIETNAMESE_CHARSET},
+            {16, FXFONT_THAI_CHARSET},
+            {17, FXFONT_SHIFTJIS_CHARSET},
+            {18, FXFONT_GB2312_CHARSET},
+            {19, FXFONT_HANGEUL_CHARSET},
+            {20, FXFONT_CHINESEBIG5_CHARSET},
+            {31, FXFONT_SYMBOL_CHARSET},
+    };
+
+    struct FontFace {
+        std::string path;
+        std::string family;
+        std::string key;          // Normalized family used for matching
+        uint32_t faceOffset = 0;  // Offset of the face's table directory, non-zero only inside collections
+        uint32_t codePages = 0;   // OS/2 ulCodePageRange1
+        uint16_t weight = FXFONT_FW_NORMAL;
+        uint8_t italic = 0;
+        uint8_t collection = 0;
+    };
+
+    struct MappedFile {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+    };
+
+    std::mutex sIndexLock;
+    std::string sCacheDir;
+    std::vector<FontFace> sFaces;
+    bool sLoaded = false;
+
+    inline uint16_t readU16(const uint8_t *p) {
+        return (uint16_t) ((p[0] << 8) | p[1]);
+    }
+
+    inline uint32_t readU32(const uint8_t *p) {
+        return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+    }
+
+    bool mapFile(const char *path, MappedFile *out) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return false;
+        }
+        void *data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return false;
+        out->data = static_cast<const uint8_t *>(data);
+        out->size = (size_t) st.st_size;
+        return true;
+    }
+
+    void unmapFile(MappedFile *file) {
+        if (file->data != nullptr) {
+            munmap((void *) file->data, file->size);
+            file->data = nullptr;
+            file->size = 0;
+        }
+    }
+
+    bool findTable(const MappedFile &file, uint32_t faceOffset, uint32_t tag, uint32_t *offset, uint32_t *length) {
+        if ((size_t) faceOffset + 12 > file.size) return false;
+        uint16_t numTables = readU16(file.data + faceOffset + 4);
+        size_t records = (size_t) faceOffset + 12;
+        if (records + (size_t) numTables * 16 > file.size) return false;
+        for (uint16_t i = 0; i < numTables; i++) {
+            const uint8_t *record = file.data + records + (size_t) i * 16;
+            if (readU32(record) != tag) continue;
+            uint32_t tableOffset = readU32(record + 8);
+            uint32_t tableLength = readU32(record + 12);
+            if ((size_t) tableOffset + tableLength > file.size) return false;
+            *offset = tableOffset;
+            *length = tableLength;
+            return true;
+        }
+        return false;
+    }
+
+    void appendUtf8(std::string *out, uint32_t cp) {
+        if (cp < 0x80) {
+            out->push_back((char) cp);
+        } else if (cp < 0x800) {
+            out->push_back((char) (0xC0 | (cp >> 6)));
+            out->push_back((char) (0x80 | (cp & 0x3F)));
+        } else {
+            out->push_back((char) (0xE0 | (cp >> 12)));
+            out->push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+            out->push_back((char) (0x80 | (cp & 0x3F)));
+        }
+    }
+
+    // Reads the family name (name ID 1), preferring the US English Windows record.
+    std::string readFamilyName(const MappedFile &file, uint32_t faceOffset) {
+        uint32_t offset, length;
+        if (!findTable(file, faceOffset, kTagName, &offset, &length) || length < 6) return {};
+        const uint8_t *table = file.data + offset;
+        uint16_t count = readU16(table + 2);
+        uint16_t storage = readU16(table + 4);
+        if (6 + (size_t) count * 12 > length) return {};
+
+        int best = -1;
+        int bestScore = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            const uint8_t *record = table + 6 + (size_t) i * 12;
+            if (readU16(record + 6) != 1) continue;
+            uint16_t platform = readU16(record);
+            uint16_t language = readU16(record + 4);
+            int score = 0;
+            if (platform == 3) score = language == 0x409 ? 3 : 2;
+            else if (platform == 1 && readU16(record + 2) == 0) score = 1;
+            if (score > bestScore) {
+                best = i;
+                bestScore = score;
+            }
+        }
+        if (best < 0) return {};
+
+        const uint8_t *record = table + 6 + (size_t) best * 12;
+        uint16_t nameLength = readU16(record + 8);
+        size_t nameOffset = (size_t) storage + readU16(record + 10);
+        if (nameOffset + nameLength > length) return {};
+        const uint8_t *name = table + nameOffset;
+
+        std::string family;
+        if (readU16(record) == 3) {
+            for (uint16_t i = 0; i + 1 < nameLength; i += 2) {
+                uint16_t unit = readU16(name + i);
+                appendUtf8(&family, (unit >= 0xD800 && unit <= 0xDFFF) ? '?' : unit);
+            }
+        } else {
+            family.assign(reinterpret_cast<const char *>(name), nameLength);
+        }
+        return family;
+    }
+
+    // Lowercase and drop separators and anything after a style suffix ("Arial-BoldMT", "Arial,Bold").
+    std::string normalizeFamily(const char *name) {
+        std::string key;
+        for (const char *p = name; *p != '\0'; p++) {
+            char c = *p;
+            if (c == ',' || c == '-') break;
+            if (c == ' ' || c == '_') continue;
+            key.push_back((char) ((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c));
+        }
+        return key;
+    }
+
+    bool parseFace(const MappedFile &file, const std::string &path, uint32_t faceOffset, bool collection,
+                   FontFace *face) {
+        face->family = readFamilyName(file, faceOffset);
+        if (face->family.empty()) return false;
+        face->path = path;
+        face->key = normalizeFamily(face->family.c_str());
+        face->faceOffset = faceOffset;
+        face->collection = collection ? 1 : 0;
+
+        uint32_t offset, length;
+        if (findTable(file, faceOffset, kTagOs2, &offset, &length) && length >= 64) {
+            const uint8_t *os2 = file.data + offset;
+            face->weight = readU16(os2 + 4);
+            face->italic = (readU16(os2 + 62) & 0x01) ? 1 : 0;
+            if (readU16(os2) >= 1 && length >= 82) {
+                face->codePages = readU32(os2 + 78);
+            }
+        } else if (findTable(file, faceOffset, kTagHead, &offset, &length) && length >= 46) {
+            uint16_t macStyle = readU16(file.data + offset + 44);
+            face->weight = (macStyle & 0x01) ? FXFONT_FW_BOLD : FXFONT_FW_NORMAL;
+            face->italic = (macStyle & 0x02) ? 1 : 0;
+        }
+        if (face->codePages == 0) face->codePages = 1; // Assume Latin 1
+        return true;
+    }
+
+    void indexFile(const std::string &path, std::vector<FontFace> *faces) {
+        MappedFile file;
+        if (!mapFile(path.c_str(), &file)) return;
+        if (file.size >= 12 && readU32(file.data) == kTagTtcf) {
+            uint32_t numFonts = readU32(file.data + 8);
+            for (uint32_t i = 0; i < numFonts && 12 + (size_t) (i + 1) * 4 <= file.size; i++) {
+                FontFace face;
+                if (parseFace(file, path, readU32(file.data + 12 + i * 4), true, &face)) {
+                    faces->push_back(std::move(face));
+                }
+            }
+        } else {
+            FontFace face;
+            if (parseFace(file, path, 0, false, &face)) faces->push_back(std::move(face));
+        }
+        unmapFile(&file);
+    }
+
+    bool hasFontExtension(const char *name) {
+        size_t length = strlen(name);
+        if (length < 4) return false;
+        const char *ext = name + length - 4;
+        return strcasecmp(ext, ".ttf") == 0 || strcasecmp(ext, ".otf") == 0 || strcasecmp(ext, ".ttc") == 0;
+    }
+
+    void scanFontsDir(std::vector<FontFace> *faces) {
+        DIR *dir = opendir(kFontsDir);
+        if (dir == nullptr) {
+            LOGE("Cannot open %s", kFontsDir);
+            return;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] == '.' || !hasFontExtension(entry->d_name)) continue;
+            indexFile(std::string(kFontsDir) + "/" + entry->d_name, faces);
+        }
+        closedir(dir);
+    }
+
+    struct IndexHeader {
+        uint32_t magic;
+        uint32_t version;
+        int64_t dirMtimeSec;
+        int64_t dirMtimeNsec;
+        uint32_t count;
+    };
+
+    void putString(std::string *out, const std::string &value) {
+        uint32_t length = (uint32_t) value.size();
+        out->append(reinterpret_cast<const char *>(&length), sizeof(length));
+        out->append(value);
+    }
+
+    template<typename T>
+    void putValue(std::string *out, T value) {
+        out->append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool getValue(const std::string &in, size_t *pos, T *value) {
+        if (*pos + sizeof(T) > in.size()) return false;
+        memcpy(value, in.data() + *pos, sizeof(T));
+        *pos += sizeof(T);
+        return true;
+    }
+
+    bool getString(const std::string &in, size_t *pos, std::string *value) {
+        uint32_t length;
+        if (!getValue(in, pos, &length) || *pos + length > in.size()) return false;
+        value->assign(in.data() + *pos, length);
+        *pos += length;
+        return true;
+    }
+
+    bool readWholeFile(const std::string &path, std::string *out) {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return false;
+        char buffer[16 * 1024];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) out->append(buffer, read);
+        fclose(file);
+        return true;
+    }
+
+    bool loadIndex(const std::string &path, const struct stat &dirStat, std::vector<FontFace> *faces) {
+        std::string data;
+        if (!readWholeFile(path, &data)) return false;
+        size_t pos = 0;
+        IndexHeader header{};
+        if (!getValue(data, &pos, &header) || header.magic != kIndexMagic || header.version != kIndexVersion ||
+            header.dirMtimeSec != (int64_t) dirStat.st_mtim.tv_sec ||
+            header.dirMtimeNsec != (int64_t) dirStat.st_mtim.tv_nsec) {
+            return false;
+        }
+        faces->reserve(header.count);
+        for (uint32_t i = 0; i < header.count; i++) {
+            FontFace face;
+            if (!getString(data, &pos, &face.path) || !getString(data, &pos, &face.family) ||
+                !getValue(data, &pos, &face.faceOffset) || !getValue(data, &pos, &face.codePages) ||
+                !getValue(data, &pos, &face.weight) || !getValue(data, &pos, &face.italic) ||
+                !getValue(data, &pos, &face.collection)) {
+                faces->clear();
+                return false;
+            }
+            face.key = normalizeFamily(face.family.c_str());
+            faces->push_back(std::move(face));
+        }
+        return true;
+    }
+
+    void saveIndex(const std::string &path, const struct stat &dirStat, const std::vector<FontFace> &faces) {
+        std::string data;
+        IndexHeader header{kIndexMagic, kIndexVersion, (int64_t) dirStat.st_mtim.tv_sec,
+                           (int64_t) dirStat.st_mtim.tv_nsec, (uint32_t) faces.size()};
+        putValue(&data, header);
+        for (const FontFace &face: faces) {
+            putString(&data, face.path);
+            putString(&data, face.family);
+            putValue(&data, face.faceOffset);
+            putValue(&data, face.codePages);
+            putValue(&data, face.weight);
+            putValue(&data, face.italic);
+            putValue(&data, face.collection);
+        }
+        // Write to a temporary file first so a concurrent reader never sees a partial index.
+        std::string tmpPath = path + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (file == nullptr) return;
+        bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+        written = fclose(file) == 0 && written;
+        if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            unlink(tmpPath.c_str());
+            LOGE("Cannot write font index %s", path.c_str());
+        }
+    }
+
+    // Must be called with sIndexLock held.
+    void loadLocked() {
+        if (sLoaded) return;
+        sLoaded = true;
+        struct stat dirStat{};
+        if (stat(kFontsDir, &dirStat) != 0) {
+            LOGE("Cannot stat %s", kFontsDir);
+            return;
+        }
+        std::string indexPath = sCacheDir.empty() ? std::string() : sCacheDir + "/" + kIndexFileName;
+        if (!indexPath.empty() && loadIndex(indexPath, dirStat, &sFaces)) {
+            LOGD("Loaded font index with %zu faces", sFaces.size());
+            return;
+        }
+        scanFontsDir(&sFaces);
+        LOGD("Indexed %zu faces from %s", sFaces.size(), kFontsDir);
+        if (!indexPath.empty()) saveIndex(indexPath, dirStat, sFaces);
+    }
+
+    bool supportsCharset(const FontFace &face, int charset) {
+        if (charset == FXFONT_DEFAULT_CHARSET) return true;
+        for (const auto &entry: kCodePageCharsets) {
+            if (entry.charset == charset) return (face.codePages & (1u << entry.bit)) != 0;
+        }
+        // Charsets without a code page bit (e.g. Turkish, Baltic) are covered by Latin fonts.
+        return (face.codePages & 1u) != 0;
+    }
+
+    // Generic fallback family for a pitch family, matching what ships on every Android device.
+    bool isGenericMatch(const FontFace &face, int pitchFamily) {
+        if (pitchFamily & FXFONT_FF_FIXEDPITCH) return face.key.find("mono") != std::string::npos;
+        if (pitchFamily & FXFONT_FF_ROMAN) return face.key.find("serif") != std::string::npos;
+        return face.key == "roboto";
+    }
+
+    inline void *toHandle(size_t index) {
+        return reinterpret_cast<void *>(static_cast<uintptr_t>(index + 1));
+    }
+
+    inline const FontFace *fromHandle(void *handle) {
+        auto index = static_cast<size_t>(reinterpret_cast<uintptr_t>(handle));
+        return (index == 0 || index > sFaces.size()) ? nullptr : &sFaces[index - 1];
+    }
+
+    struct SystemFontInfo : public FPDF_SYSFONTINFO {
+        std::mutex lock;
+        std::unordered_map<std::string, MappedFile> mappedFiles;
+
+        ~SystemFontInfo() {
+            for (auto &entry: mappedFiles) unmapFile(&entry.second);
+        }
+
+        const MappedFile *map(const std::string &path) {
+            auto it = mappedFiles.find(path);
+            if (it != mappedFiles.end()) return &it->second;
+            MappedFile file;
+            if (!mapFile(path.c_str(), &file)) return nullptr;
+            return &mappedFiles.emplace(path, file).first->second;
+        }
+    };
+
+    void releaseFontInfo(FPDF_SYSFONTINFO *pThis) {
+        delete static_cast<SystemFontInfo *>(pThis);
+    }
+
+    void enumFonts(FPDF_SYSFONTINFO *, void *pMapper) {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        loadLocked();
+        std::unordered_set<std::string> reported;
+        for (const FontFace &face: sFaces) {
+            for (const auto &entry: kCodePageCharsets) {
+                if (!(face.codePages & (1u << entry.bit))) continue;
+                if (reported.insert(face.family + '\n' + std::to_string(entry.charset)).second) {
+                    FPDF_AddInstalledFont(pMapper, face.family.c_str(), entry.charset);
+                }
+            }
+        }
+    }
+
+    void *mapFont(FPDF_SYSFONTINFO *, int weight, FPDF_BOOL bItalic, int charset, int pitchFamily,
+                  const char *face, FPDF_BOOL *bExact) {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        loadLocked();
+        std::string key = face != nullptr ? normalizeFamily(face) : std::string();
+        int best = -1;
+        int bestScore = 0;
+        bool bestExact = false;
+        for (size_t i = 0; i < sFaces.size(); i++) {
+            const FontFace &candidate = sFaces[i];
+            bool charsetMatch = supportsCharset(candidate, charset);
+            bool exact = !key.empty() && candidate.key == key;
+            int score = 0;
+            if (exact) score += 4000;
+            else if (!key.empty() && !candidate.key.empty() &&
+                     (key.compare(0, candidate.key.size(), candidate.key) == 0 ||
+                      candidate.key.compare(0, key.size(), key) == 0)) {
+                score += 2000;
+            } else if (isGenericMatch(candidate, pitchFamily)) score += 1000;
+            if (charsetMatch) score += 8000;
+            if ((candidate.italic != 0) == (bItalic != 0)) score += 200;
+            score += 100 - std::min(100, std::abs(candidate.weight - weight) / 4);
+            if (score > bestScore) {
+                best = (int) i;
+                bestScore = score;
+                bestExact = exact && charsetMatch;
+            }
+        }
+        if (bExact != nullptr) *bExact = bestExact;
+        return best < 0 ? nullptr : toHandle((size_t) best);
+    }
+
+    void *getFont(FPDF_SYSFONTINFO *, const char *face) {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        loadLocked();
+        if (face == nullptr) return nullptr;
+        std::string key = normalizeFamily(face);
+        for (size_t i = 0; i < sFaces.size(); i++) {
+            if (sFaces[i].key == key) return toHandle(i);
+        }
+        return nullptr;
+    }
+
+    unsigned long getFontData(FPDF_SYSFONTINFO *pThis, void *hFont, unsigned int table,
+                              unsigned char *buffer, unsigned long bufSize) {
+        auto *info = static_cast<SystemFontInfo *>(pThis);
+        const FontFace *face;
+        {
+            const std::lock_guard<std::mutex> lock(sIndexLock);
+            face = fromHandle(hFont);
+        }
+        if (face == nullptr) return 0;
+
+        const std::lock_guard<std::mutex> lock(info->lock);
+        const MappedFile *file = info->map(face->path);
+        if (file == nullptr) return 0;
+
+        // Same contract as PDFium's folder font info: table 0 is the whole file for a single font,
+        // 'ttcf' is the whole file for a face inside a collection.
+        const uint8_t *data = nullptr;
+        unsigned long size = 0;
+        if (table == 0) {
+            if (!face->collection) {
+                data = file->data;
+                size = file->size;
+            }
+        } else if (table == kTagTtcf) {
+            if (face->collection) {
+                data = file->data;
+                size = file->size;
+            }
+        } else {
+            uint32_t offset, length;
+            if (findTable(*file, face->faceOffset, table, &offset, &length)) {
+                data = file->data + offset;
+                size = length;
+            }
+        }
+        if (data != nullptr && buffer != nullptr && bufSize >= size) memcpy(buffer, data, size);
+        return size;
+    }
+
+    unsigned long getFaceName(FPDF_SYSFONTINFO *, void *hFont, char *buffer, unsigned long bufSize) {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        const FontFace *face = fromHandle(hFont);
+        if (face == nullptr) return 0;
+        unsigned long size = face->family.size() + 1;
+        if (buffer != nullptr && bufSize >= size) memcpy(buffer, face->family.c_str(), size);
+        return size;
+    }
+
+    int getFontCharset(FPDF_SYSFONTINFO *, void *hFont) {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        const FontFace *face = fromHandle(hFont);
+        if (face == nullptr) return FXFONT_DEFAULT_CHARSET;
+        for (const auto &entry: kCodePageCharsets) {
+            if (face->codePages & (1u << entry.bit)) return entry.charset;
+        }
+        return FXFONT_DEFAULT_CHARSET;
+    }
+
+    void deleteFont(FPDF_SYSFONTINFO *, void *) {
+        // Handles index into the shared table, mapped files live until Release().
+    }
+}
+
+namespace FontIndex {
+
+    void setCacheDir(const std::string &cacheDir) {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        sCacheDir = cacheDir;
+    }
+
+    size_t ensureLoaded() {
+        const std::lock_guard<std::mutex> lock(sIndexLock);
+        loadLocked();
+        return sFaces.size();
+    }
+
+    FPDF_SYSFONTINFO *createSystemFontInfo() {
+        auto *info = new SystemFontInfo();
+        info->version = 1;
+        info->Release = releaseFontInfo;
+        info->EnumFonts = enumFonts;
+        info->MapFont = mapFont;
+        info->GetFont = getFont;
+        info->GetFontData = getFontData;
+        info->GetFaceName = getFaceName;
+        info->GetFontCharset = getFontCharset;
+        info->DeleteFont = deleteFont;
+        return info;
+    }
+}
@@ -0,0 +1,80 @@
+#include "JniStats.h"
+
+#include <atomic>
+
+extern "C" {
+#include <time.h>
+}
+
+namespace {
+
+    struct Entry {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> totalNanos{0};
+        std::atomic<uint64_t> maxNanos{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+#ifdef PDFIUM_JNI_STATS
+    Entry sEntries[JniStats::COUNTER_COUNT];
+#endif
+}
+
+namespace JniStats {
+
+    bool isEnabled() {
+#ifdef PDFIUM_JNI_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    uint64_t nowNanos() {
+        struct timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+    }
+
+    void record(Counter counter, uint64_t nanos, uint64_t bytes) {
+#ifdef PDFIUM_JNI_STATS
+        Entry &entry = sEntries[counter];
+        entry.calls.fetch_add(1, std::memory_order_relaxed);
+        entry.totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+        if (bytes != 0) entry.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        uint64_t max = entry.maxNanos.load(std::memory_order_relaxed);
+        while (nanos > max && !entry.maxNanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {}
+#else
+        (void) counter;
+        (void) nanos;
+        (void) bytes;
+#endif
+    }
+
+    bool snapshot(int64_t *out) {
+#ifdef PDFIUM_JNI_STATS
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            const Entry &entry = sEntries[i];
+            out[i * kValuesPerCounter] = (int64_t) entry.calls.load(std::memory_order_relaxed);
+            out[i * kValuesPerCounter + 1] = (int64_t) entry.totalNanos.load(std::memory_order_relaxed);
+            out[i * kValuesPerCounter + 2] = (int64_t) entry.maxNanos.load(std::memory_order_relaxed);
+            out[i * kValuesPerCounter + 3] = (int64_t) entry.bytes.load(std::memory_order_relaxed);
+        }
+        return true;
+#else
+        (void) out;
+        return false;
+#endif
+    }
+
+    void reset() {
+#ifdef PDFIUM_JNI_STATS
+        for (Entry &entry: sEntries) {
+            entry.calls.store(0, std::memory_order_relaxed);
+            entry.totalNanos.store(0, std::memory_order_relaxed);
+            entry.maxNanos.store(0, std::memory_order_relaxed);
+            entry.bytes.store(0, std::memory_order_relaxed);
+        }
+#endif
+    }
+}
@@ -0,0 +1,101 @@
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+    struct Usage {
+        int64_t bytes[MemoryTracker::KIND_COUNT] = {0};
+        int64_t handles[MemoryTracker::KIND_COUNT] = {0};
+        int64_t total = 0;
+        int64_t peak = 0;
+
+        void add(MemoryTracker::Kind kind, int64_t size, int64_t count) {
+            bytes[kind] += size;
+            handles[kind] += count;
+            total += size;
+            peak = std::max(peak, total);
+        }
+    };
+
+    struct Allocation {
+        const void *owner;
+        MemoryTracker::Kind kind;
+        size_t bytes;
+    };
+
+    std::mutex sLock;
+    std::unordered_map<const void *, Allocation> sAllocations;
+    std::unordered_map<const void *, Usage> sOwners;
+    Usage sGlobal;
+
+    void releaseLocked(const Allocation &allocation) {
+        const auto size = (int64_t) allocation.bytes;
+        sGlobal.add(allocation.kind, -size, -1);
+        auto owner = sOwners.find(allocation.owner);
+        if (owner != sOwners.end()) owner->second.add(allocation.kind, -size, -1);
+    }
+}
+
+namespace MemoryTracker {
+
+    void track(const void *owner, const void *handle, Kind kind, size_t bytes) {
+        if (handle == nullptr) return;
+        const std::lock_guard<std::mutex> lock(sLock);
+        auto previous = sAllocations.find(handle);
+        if (previous != sAllocations.end()) {
+            releaseLocked(previous->second);
+            sAllocations.erase(previous);
+        }
+        sAllocations[handle] = Allocation{owner, kind, bytes};
+        sGlobal.add(kind, (int64_t) bytes, 1);
+        sOwners[owner].add(kind, (int64_t) bytes, 1);
+    }
+
+    void untrack(const void *handle) {
+        if (handle == nullptr) return;
+        const std::lock_guard<std::mutex> lock(sLock);
+        auto allocation = sAllocations.find(handle);
+        if (allocation == sAllocations.end()) return;
+        releaseLocked(allocation->second);
+        sAllocations.erase(allocation);
+    }
+
+    const void *ownerOf(const void *handle) {
+        const std::lock_guard<std::mutex> lock(sLock);
+        auto allocation = sAllocations.find(handle);
+        return allocation == sAllocations.end() ? nullptr : allocation->second.owner;
+    }
+
+    void releaseOwner(const void *owner) {
+        const std::lock_guard<std::mutex> lock(sLock);
+        for (auto it = sAllocations.begin(); it != sAllocations.end();) {
+            if (it->second.owner == owner) {
+                releaseLocked(it->second);
+                it = sAllocations.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        sOwners.erase(owner);
+    }
+
+    void snapshot(const void *owner, int64_t *out) {
+        const std::lock_guard<std::mutex> lock(sLock);
+        Usage usage;
+        if (owner == nullptr) {
+            usage = sGlobal;
+        } else {
+            auto it = sOwners.find(owner);
+            if (it != sOwners.end()) usage = it->second;
+        }
+        for (int i = 0; i < KIND_COUNT; i++) {
+            out[i] = usage.bytes[i];
+            out[KIND_COUNT + i] = usage.handles[i];
+        }
+        out[KIND_COUNT * 2] = usage.total;
+        out[KIND_COUNT * 2 + 1] = usage.peak;
+    }
+}
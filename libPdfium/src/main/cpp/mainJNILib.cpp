@@ -8,16 +8,29 @@
 
 #include <fpdf_doc.h>
 #include <fpdf_edit.h>
+#include <fpdf_ppo.h>
 #include <fpdf_save.h>
 #include <fpdf_text.h>
 #include <fpdf_transformpage.h>
 #include <fpdf_formfill.h>
+#include <fpdf_progressive.h>
+#include <fpdf_catalog.h>
+#include <fpdf_structtree.h>
 #include <fpdfview.h>
 
 #include "include/util.h"
 #include "fpdf_annot.h"
+#include <ContentHash.h>
+#include <FontIndex.h>
+#include <JniStats.h>
+#include <MemoryTracker.h>
+#include <ScopedTrace.h>
 #include <Mutex.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
 #include <mutex>
+#include <set>
 #include <vector>
 
 extern "C" {
@@ -25,30 +38,87 @@ extern "C" {
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 }
 
 static std::mutex sLibraryLock;
 static int sLibraryReferenceCount = 0;
+static bool sLibraryInitialized = false;
+static bool sLibraryKeepAlive = false;
 JavaVM *javaVm;
 
+// Must be called with sLibraryLock held.
+static bool initLibraryLocked() {
+    if (sLibraryInitialized) {
+        return false;
+    }
+    LOGD("Init FPDF library");
+    FPDF_LIBRARY_CONFIG config;
+    config.version = 2;
+    config.m_pUserFontPaths = nullptr;
+    config.m_pIsolate = nullptr;
+    config.m_v8EmbedderSlot = 0;
+    FPDF_InitLibraryWithConfig(&config);
+    FPDF_SetSystemFontInfo(FontIndex::createSystemFontInfo());
+    sLibraryInitialized = true;
+    return true;
+}
+
+// Must be called with sLibraryLock held. Only tears the library down when no document uses it.
+static bool destroyLibraryLocked() {
+    if (!sLibraryInitialized || sLibraryReferenceCount > 0) {
+        return false;
+    }
+    LOGD("Destroy FPDF library");
+    FPDF_DestroyLibrary();
+    sLibraryInitialized = false;
+    return true;
+}
+
+// Renders a throwaway page with standard-font text so glyph caches, code pages and the font mapper
+// are set up before the first real document. Must be called with sLibraryLock held.
+static bool primeRendererLocked() {
+    FPDF_DOCUMENT document = FPDF_CreateNewDocument();
+    if (document == nullptr) return false;
+    bool primed = false;
+    FPDF_PAGE page = FPDFPage_New(document, 0, 64, 64);
+    if (page != nullptr) {
+        FPDF_FONT font = FPDFText_LoadStandardFont(document, "Helvetica");
+        FPDF_PAGEOBJECT text = font != nullptr ? FPDFPageObj_CreateTextObj(document, font, 12) : nullptr;
+        if (text != nullptr) {
+            static const FPDF_WCHAR kSample[] = {'A', 'g', '0', 0};
+            FPDFText_SetText(text, kSample);
+            FPDFPageObj_Transform(text, 1, 0, 0, 1, 4, 24);
+            FPDFPage_InsertObject(page, text);
+            FPDFPage_GenerateContent(page);
+        }
+        FPDF_BITMAP bitmap = FPDFBitmap_Create(64, 64, 0);
+        if (bitmap != nullptr) {
+            FPDFBitmap_FillRect(bitmap, 0, 0, 64, 64, 0xFFFFFFFF);
+            FPDF_RenderPageBitmap(bitmap, page, 0, 0, 64, 64, 0, FPDF_ANNOT);
+            FPDFBitmap_Destroy(bitmap);
+            primed = true;
+        }
+        if (font != nullptr) FPDFFont_Close(font);
+        FPDF_ClosePage(page);
+    }
+    FPDF_CloseDocument(document);
+    return primed;
+}
+
 static void initLibraryIfNeed() {
     const std::lock_guard<std::mutex> lock(sLibraryLock);
-    if (sLibraryReferenceCount == 0) {
-        LOGD("Init FPDF library");
-        FPDF_InitLibrary();
-    }
+    initLibraryLocked();
     sLibraryReferenceCount++;
-    sLibraryLock.unlock();
 }
 
 static void destroyLibraryIfNeed() {
     const std::lock_guard<std::mutex> lock(sLibraryLock);
     sLibraryReferenceCount--;
     LOGD("sLibraryReferenceCount %d", sLibraryReferenceCount);
-    if (sLibraryReferenceCount == 0) {
-        LOGD("Destroy FPDF library");
-        FPDF_DestroyLibrary();
+    if (!sLibraryKeepAlive) {
+        destroyLibraryLocked();
     }
 }
 
@@ -84,6 +154,21 @@ bool jniDetachCurrentThread(bool attached) {
     return true;
 }
 
+class DocumentFile;
+
+// Page area repainted by the form filler, in page coordinates
+struct FormDirtyRect {
+    FPDF_PAGE page;
+    float left;
+    float top;
+    float right;
+    float bottom;
+};
+
+struct FormFillInfo : FPDF_FORMFILLINFO {
+    DocumentFile *doc;
+};
+
 class DocumentFile {
 
 public:
@@ -92,13 +177,79 @@ public:
 public:
     jobject nativeSourceBridgeGlobalRef = nullptr;
     jbyte *cDataCopy = nullptr;
+    // Source the document reads from, a descriptor or cDataCopy, for the fingerprint samples
+    int sourceFd = -1;
+    size_t sourceLength = 0;
+
+    // Form environment kept while forms are filled interactively, see formFillHandle()
+    FPDF_FORMHANDLE formHandle = nullptr;
+    FormFillInfo formInfo = {};
+    std::vector<FormDirtyRect> formDirtyRects;
 
     DocumentFile() { initLibraryIfNeed(); }
 
     ~DocumentFile();
 };
 
+// Pages known to a persistent form environment, detached from it before they are closed
+static std::map<FPDF_PAGE, FPDF_FORMHANDLE> sFormPages;
+
+static void detachFormPage(FPDF_PAGE page) {
+    auto formPage = sFormPages.find(page);
+    if (formPage != sFormPages.end()) {
+        FORM_OnBeforeClosePage(page, formPage->second);
+        sFormPages.erase(formPage);
+    }
+}
+
+static void detachFormPages(FPDF_FORMHANDLE form) {
+    for (auto it = sFormPages.begin(); it != sFormPages.end();) {
+        if (it->second == form) {
+            FORM_OnBeforeClosePage(it->first, form);
+            it = sFormPages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Instances of pages stripped of their content, drawing the markup annotations of the annotation layer.
+// PDFium only draws markup annotations along with the page content, see markupPage()
+struct MarkupPage {
+    DocumentFile *doc;
+    FPDF_PAGE page;
+};
+static std::map<FPDF_PAGE, MarkupPage> sMarkupPages;
+
+static void closeMarkupPage(FPDF_PAGE page) {
+    auto found = sMarkupPages.find(page);
+    if (found != sMarkupPages.end()) {
+        MemoryTracker::untrack(found->second.page);
+        FPDF_ClosePage(found->second.page);
+        sMarkupPages.erase(found);
+    }
+}
+
+static void closeMarkupPages(DocumentFile *doc) {
+    for (auto it = sMarkupPages.begin(); it != sMarkupPages.end();) {
+        if (it->second.doc == doc) {
+            MemoryTracker::untrack(it->second.page);
+            FPDF_ClosePage(it->second.page);
+            it = sMarkupPages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 DocumentFile::~DocumentFile() {
+    MemoryTracker::releaseOwner(this);
+    closeMarkupPages(this);
+    if (formHandle != nullptr) {
+        detachFormPages(formHandle);
+        FPDFDOC_ExitFormFillEnvironment(formHandle);
+        formHandle = nullptr;
+    }
     if (pdfDocument != nullptr) {
         FPDF_CloseDocument(pdfDocument);
         pdfDocument = nullptr;
@@ -213,7 +364,369 @@ void rgbBitmapTo565(void *source, int sourceStride, void *dest, AndroidBitmapInf
     }
 }
 
+// Status returned by nativeRenderPageBitmap(), mirrored in PdfiumCore.
+enum RenderStatus {
+    RENDER_STATUS_FAILED = -1,
+    RENDER_STATUS_COMPLETE = 0,
+    RENDER_STATUS_DRAFT = 1,
+};
+
+// Linear downscale of the draft drawn when a render exceeds its budget.
+static const int kDraftScale = 4;
+
+static inline int64_t nowNanos() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct RenderDeadline : public IFSDK_PAUSE {
+    int64_t deadlineNanos;
+
+    explicit RenderDeadline(int64_t budgetNanos) : IFSDK_PAUSE() {
+        version = 1;
+        NeedToPauseNow = needToPauseNow;
+        user = nullptr;
+        deadlineNanos = nowNanos() + budgetNanos;
+    }
+
+    bool expired() const { return nowNanos() >= deadlineNanos; }
+
+    static FPDF_BOOL needToPauseNow(IFSDK_PAUSE *pThis) {
+        return static_cast<RenderDeadline *>(pThis)->expired();
+    }
+};
+
+// Renders progressively until the page is done or the deadline passes, returning the PDFium render status.
+// PDFium only checks the deadline between page objects, so a single huge object can still overrun it.
+static int renderWithDeadline(FPDF_BITMAP bitmap, FPDF_PAGE page, int startX, int startY, int sizeX,
+                              int sizeY, int flags, RenderDeadline *deadline) {
+    TRACE_SECTION("pdfium:renderProgressive");
+    int status = FPDF_RenderPageBitmap_Start(bitmap, page, startX, startY, sizeX, sizeY, 0, flags, deadline);
+    while (status == FPDF_RENDER_TOBECONTINUED && !deadline->expired()) {
+        status = FPDF_RenderPage_Continue(page, deadline);
+    }
+    FPDF_RenderPage_Close(page);
+    return status;
+}
+
+// Renders the tile at 1/kDraftScale resolution without anti-aliasing, then scales it up into
+// the [left, top, right, bottom) area of |target|.
+static void renderDraft(const void *owner, FPDF_BITMAP target, int format, FPDF_PAGE page, int startX, int startY,
+                        int sizeX, int sizeY, int flags, int64_t budgetNanos, int left, int top, int right,
+                        int bottom) {
+    TRACE_SECTION("pdfium:renderDraft");
+    int draftWidth = (FPDFBitmap_GetWidth(target) + kDraftScale - 1) / kDraftScale;
+    int draftHeight = (FPDFBitmap_GetHeight(target) + kDraftScale - 1) / kDraftScale;
+    FPDF_BITMAP draft = FPDFBitmap_CreateEx(draftWidth, draftHeight, format, nullptr, 0);
+    if (draft == nullptr) return;
+    MemoryTracker::track(owner, draft, MemoryTracker::SCRATCH, (size_t) FPDFBitmap_GetStride(draft) * draftHeight);
+    FPDFBitmap_FillRect(draft, 0, 0, draftWidth, draftHeight, 0xFFFFFFFF);
+
+    RenderDeadline deadline(budgetNanos);
+    renderWithDeadline(draft, page, startX / kDraftScale, startY / kDraftScale, sizeX / kDraftScale,
+                       sizeY / kDraftScale,
+                       flags | FPDF_RENDER_NO_SMOOTHTEXT | FPDF_RENDER_NO_SMOOTHIMAGE | FPDF_RENDER_NO_SMOOTHPATH,
+                       &deadline);
+
+    right = std::min(right, FPDFBitmap_GetWidth(target));
+    bottom = std::min(bottom, FPDFBitmap_GetHeight(target));
+    const int bytesPerPixel = format == FPDFBitmap_BGRA ? 4 : (format == FPDFBitmap_Gray ? 1 : 3);
+    auto *src = static_cast<const uint8_t *>(FPDFBitmap_GetBuffer(draft));
+    auto *dst = static_cast<uint8_t *>(FPDFBitmap_GetBuffer(target));
+    const int srcStride = FPDFBitmap_GetStride(draft);
+    const int dstStride = FPDFBitmap_GetStride(target);
+    for (int y = top; y < bottom; y++) {
+        const uint8_t *srcLine = src + (y / kDraftScale) * srcStride;
+        uint8_t *dstLine = dst + y * dstStride;
+        for (int x = left; x < right; x++) {
+            memcpy(dstLine + x * bytesPerPixel, srcLine + (x / kDraftScale) * bytesPerPixel, bytesPerPixel);
+        }
+    }
+    MemoryTracker::untrack(draft);
+    FPDFBitmap_Destroy(draft);
+}
+
+// Page color class returned by nativeGetPageColorClass(), mirrored in PdfiumCore.
+enum PageColorClass {
+    PAGE_COLOR_GRAY = 0,
+    PAGE_COLOR_OPAQUE = 1,
+    PAGE_COLOR_TRANSPARENT = 2,
+};
+
+static const int kMaxFormDepth = 8;
+
+static inline bool isGray(FPDF_BOOL hasColor, unsigned int r, unsigned int g, unsigned int b) {
+    return hasColor && r == g && g == b;
+}
+
+static bool hasGrayFill(FPDF_PAGEOBJECT object) {
+    unsigned int r, g, b, a;
+    return isGray(FPDFPageObj_GetFillColor(object, &r, &g, &b, &a), r, g, b);
+}
+
+static bool hasGrayStroke(FPDF_PAGEOBJECT object) {
+    unsigned int r, g, b, a;
+    return isGray(FPDFPageObj_GetStrokeColor(object, &r, &g, &b, &a), r, g, b);
+}
+
+// Conservative check: anything we cannot prove to be gray (patterns, shadings, unknown
+// color spaces) counts as color.
+static bool isGrayObject(FPDF_PAGE page, FPDF_PAGEOBJECT object, int depth) {
+    switch (FPDFPageObj_GetType(object)) {
+        case FPDF_PAGEOBJ_TEXT: {
+            FPDF_TEXT_RENDERMODE mode = FPDFTextObj_GetTextRenderMode(object);
+            if (mode == FPDF_TEXTRENDERMODE_INVISIBLE || mode == FPDF_TEXTRENDERMODE_CLIP) return true;
+            bool fill = mode == FPDF_TEXTRENDERMODE_FILL || mode == FPDF_TEXTRENDERMODE_FILL_STROKE ||
+                        mode == FPDF_TEXTRENDERMODE_FILL_CLIP || mode == FPDF_TEXTRENDERMODE_FILL_STROKE_CLIP;
+            bool stroke = mode == FPDF_TEXTRENDERMODE_STROKE || mode == FPDF_TEXTRENDERMODE_FILL_STROKE ||
+                          mode == FPDF_TEXTRENDERMODE_STROKE_CLIP ||
+                          mode == FPDF_TEXTRENDERMODE_FILL_STROKE_CLIP;
+            return (!fill || hasGrayFill(object)) && (!stroke || hasGrayStroke(object));
+        }
+        case FPDF_PAGEOBJ_PATH: {
+            int fillMode = FPDF_FILLMODE_NONE;
+            FPDF_BOOL stroke = false;
+            if (!FPDFPath_GetDrawMode(object, &fillMode, &stroke)) return false;
+            return (fillMode == FPDF_FILLMODE_NONE || hasGrayFill(object)) && (!stroke || hasGrayStroke(object));
+        }
+        case FPDF_PAGEOBJ_IMAGE: {
+            FPDF_IMAGEOBJ_METADATA metadata;
+            if (!FPDFImageObj_GetImageMetadata(object, page, &metadata)) return false;
+            switch (metadata.colorspace) {
+                case FPDF_COLORSPACE_DEVICEGRAY:
+                case FPDF_COLORSPACE_CALGRAY:
+                    return true;
+                case FPDF_COLORSPACE_ICCBASED:
+                    return metadata.bits_per_pixel <= 8; // Single component profile
+                case FPDF_COLORSPACE_UNKNOWN:
+                    return metadata.bits_per_pixel == 1 && hasGrayFill(object); // Stencil mask
+                default:
+                    return false;
+            }
+        }
+        case FPDF_PAGEOBJ_FORM: {
+            if (depth >= kMaxFormDepth) return false;
+            const int count = FPDFFormObj_CountObjects(object);
+            for (int i = 0; i < count; i++) {
+                FPDF_PAGEOBJECT child = FPDFFormObj_GetObject(object, (unsigned long) i);
+                if (child != nullptr && !isGrayObject(page, child, depth + 1)) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static int getPageColorClass(FPDF_PAGE page, bool annotation) {
+    if (FPDFPage_HasTransparency(page)) return PAGE_COLOR_TRANSPARENT;
+    if (annotation && FPDFPage_GetAnnotCount(page) > 0) return PAGE_COLOR_OPAQUE;
+    const int count = FPDFPage_CountObjects(page);
+    for (int i = 0; i < count; i++) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+        if (object != nullptr && !isGrayObject(page, object, 0)) return PAGE_COLOR_OPAQUE;
+    }
+    return PAGE_COLOR_GRAY;
+}
+
+// Content bounds: an image covering more than this share of the page is treated as a scan.
+static const float kScanCoverage = 0.5f;
+// Crops saving less than this share of the page area are not worth it.
+static const float kMinCropGain = 0.05f;
+// Padding kept around the content, relative to the page size.
+static const float kCropPadding = 0.015f;
+// Longest side of the render used to find ink on scanned pages.
+static const int kInkScanSize = 256;
+// Gray level below which a pixel counts as ink, and ink pixels needed to keep a row or column.
+static const int kInkThreshold = 0xD0;
+static const int kInkMinPixels = 2;
+
+// Finds the inked area of a low resolution gray render. Returns false for blank pages.
+static bool inkScanBounds(FPDF_PAGE page, float *out) {
+    const double pageWidth = FPDF_GetPageWidthF(page);
+    const double pageHeight = FPDF_GetPageHeightF(page);
+    if (pageWidth <= 0 || pageHeight <= 0) return false;
+    const double scale = kInkScanSize / std::max(pageWidth, pageHeight);
+    const int width = std::max(1, (int) (pageWidth * scale));
+    const int height = std::max(1, (int) (pageHeight * scale));
+
+    FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(width, height, FPDFBitmap_Gray, nullptr, 0);
+    if (bitmap == nullptr) return false;
+    FPDFBitmap_FillRect(bitmap, 0, 0, width, height, 0xFFFFFFFF);
+    FPDF_RenderPageBitmap(bitmap, page, 0, 0, width, height, 0, FPDF_GRAYSCALE);
+
+    auto *pixels = static_cast<const uint8_t *>(FPDFBitmap_GetBuffer(bitmap));
+    const int stride = FPDFBitmap_GetStride(bitmap);
+    std::vector<int> columnInk(width, 0);
+    int top = -1, bottom = -1;
+    for (int y = 0; y < height; y++) {
+        const uint8_t *line = pixels + y * stride;
+        int rowInk = 0;
+        for (int x = 0; x < width; x++) {
+            if (line[x] < kInkThreshold) {
+                rowInk++;
+                columnInk[x]++;
+            }
+        }
+        if (rowInk >= kInkMinPixels) {
+            if (top < 0) top = y;
+            bottom = y;
+        }
+    }
+    FPDFBitmap_Destroy(bitmap);
+
+    int left = -1, right = -1;
+    for (int x = 0; x < width; x++) {
+        if (columnInk[x] >= kInkMinPixels) {
+            if (left < 0) left = x;
+            right = x;
+        }
+    }
+    if (top < 0 || left < 0) return false;
+    out[0] = (float) left / width;
+    out[1] = (float) top / height;
+    out[2] = (float) (right + 1) / width;
+    out[3] = (float) (bottom + 1) / height;
+    return true;
+}
+
+// Union of the page object bounds, mapped to relative display coordinates (rotation applied).
+// Sets |isScan| when a large image dominates the page, as object bounds say nothing about its ink.
+static bool objectBounds(FPDF_PAGE page, float *out, bool *isScan) {
+    FS_RECTF box;
+    if (!FPDF_GetPageBoundingBox(page, &box)) return false;
+    const float boxArea = (box.right - box.left) * (box.top - box.bottom);
+    if (boxArea <= 0) return false;
+
+    float left = box.right, bottom = box.top, right = box.left, top = box.bottom;
+    const int count = FPDFPage_CountObjects(page);
+    for (int i = 0; i < count; i++) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+        float l, b, r, t;
+        if (object == nullptr || !FPDFPageObj_GetBounds(object, &l, &b, &r, &t)) continue;
+        l = std::max(l, box.left);
+        b = std::max(b, box.bottom);
+        r = std::min(r, box.right);
+        t = std::min(t, box.top);
+        if (l >= r || b >= t) continue;
+        if (FPDFPageObj_GetType(object) == FPDF_PAGEOBJ_IMAGE && (r - l) * (t - b) > boxArea * kScanCoverage) {
+            *isScan = true;
+        }
+        left = std::min(left, l);
+        bottom = std::min(bottom, b);
+        right = std::max(right, r);
+        top = std::max(top, t);
+    }
+    if (left >= right || bottom >= top) return false;
+
+    const int size = 10000;
+    int x1, y1, x2, y2;
+    FPDF_PageToDevice(page, 0, 0, size, size, 0, left, bottom, &x1, &y1);
+    FPDF_PageToDevice(page, 0, 0, size, size, 0, right, top, &x2, &y2);
+    out[0] = (float) std::min(x1, x2) / size;
+    out[1] = (float) std::min(y1, y2) / size;
+    out[2] = (float) std::max(x1, x2) / size;
+    out[3] = (float) std::max(y1, y2) / size;
+    return true;
+}
+
+// Computes the content bounds of a page as {left, top, right, bottom} relative to its displayed size.
+// Leaves |out| untouched (the full page) for blank pages or when cropping would gain little.
+static void getContentBounds(FPDF_PAGE page, float *out) {
+    float bounds[4];
+    bool isScan = false;
+    if (!objectBounds(page, bounds, &isScan)) return;
+    if (isScan && !inkScanBounds(page, bounds)) return;
+
+    bounds[0] = std::max(0.0f, bounds[0] - kCropPadding);
+    bounds[1] = std::max(0.0f, bounds[1] - kCropPadding);
+    bounds[2] = std::min(1.0f, bounds[2] + kCropPadding);
+    bounds[3] = std::min(1.0f, bounds[3] + kCropPadding);
+    const float width = bounds[2] - bounds[0];
+    const float height = bounds[3] - bounds[1];
+    if (width * height > 1.0f - kMinCropGain || width < kMinCropGain || height < kMinCropGain) return;
+    memcpy(out, bounds, sizeof(bounds));
+}
+
+// Page complexity counters, in the order returned to Java (see PageComplexity.kt).
+enum PageComplexityField {
+    COMPLEXITY_OBJECTS = 0,
+    COMPLEXITY_TEXTS,
+    COMPLEXITY_IMAGES,
+    COMPLEXITY_IMAGE_PIXELS,
+    COMPLEXITY_PATH_SEGMENTS,
+    COMPLEXITY_TRANSPARENT,
+    COMPLEXITY_SHADINGS,
+    COMPLEXITY_FIELD_COUNT
+};
+
+// Accumulates the counters of an object, descending into form XObjects.
+static void addObjectComplexity(FPDF_PAGEOBJECT object, jlong *counters, int depth) {
+    counters[COMPLEXITY_OBJECTS]++;
+    if (FPDFPageObj_HasTransparency(object)) counters[COMPLEXITY_TRANSPARENT]++;
+    switch (FPDFPageObj_GetType(object)) {
+        case FPDF_PAGEOBJ_TEXT:
+            counters[COMPLEXITY_TEXTS]++;
+            break;
+        case FPDF_PAGEOBJ_PATH: {
+            const int segments = FPDFPath_CountSegments(object);
+            if (segments > 0) counters[COMPLEXITY_PATH_SEGMENTS] += segments;
+            break;
+        }
+        case FPDF_PAGEOBJ_IMAGE: {
+            counters[COMPLEXITY_IMAGES]++;
+            unsigned int width = 0, height = 0;
+            if (FPDFImageObj_GetImagePixelSize(object, &width, &height)) {
+                counters[COMPLEXITY_IMAGE_PIXELS] += (jlong) width * height;
+            }
+            break;
+        }
+        case FPDF_PAGEOBJ_SHADING:
+            counters[COMPLEXITY_SHADINGS]++;
+            break;
+        case FPDF_PAGEOBJ_FORM: {
+            if (depth >= kMaxFormDepth) break;
+            const int count = FPDFFormObj_CountObjects(object);
+            for (int i = 0; i < count; i++) {
+                FPDF_PAGEOBJECT child = FPDFFormObj_GetObject(object, (unsigned long) i);
+                if (child != nullptr) addObjectComplexity(child, counters, depth + 1);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// ALPHA_8 tiles store ink coverage (255 - gray) so they can be drawn as a mask
+// with the foreground color on top of the background color.
+// PDFium draws straight alpha, Android bitmaps hold premultiplied alpha
+void premultiplyAlpha(void *pixels, AndroidBitmapInfo *info) {
+    for (uint32_t y = 0; y < info->height; y++) {
+        auto *pixel = reinterpret_cast<uint8_t *>(pixels) + (size_t) y * info->stride;
+        for (uint32_t x = 0; x < info->width; x++, pixel += 4) {
+            const uint8_t alpha = pixel[3];
+            if (alpha == 0xFF) continue;
+            pixel[0] = pixel[0] * alpha / 255;
+            pixel[1] = pixel[1] * alpha / 255;
+            pixel[2] = pixel[2] * alpha / 255;
+        }
+    }
+}
+
+void grayBitmapToCoverage(void *pixels, AndroidBitmapInfo *info) {
+    TRACE_SECTION("pdfium:grayToCoverage %ux%u", info->width, info->height);
+    for (uint32_t y = 0; y < info->height; y++) {
+        auto *line = static_cast<uint8_t *>(pixels) + (size_t) y * info->stride;
+        for (uint32_t x = 0; x < info->width; x++) {
+            line[x] = 255 - line[x];
+        }
+    }
+}
+
 jlong loadTextPageInternal(JNIEnv *env, DocumentFile *doc, jlong pagePtr) {
+    TRACE_SECTION("pdfium:loadTextPage");
     try {
         if (doc == nullptr) throw std::runtime_error("Get page document null");
 
@@ -223,6 +736,9 @@ jlong loadTextPageInternal(JNIEnv *env, DocumentFile *doc, jlong pagePtr) {
             if (textPage == nullptr) {
                 throw std::runtime_error("Loaded text page is null");
             }
+            const int chars = std::max(0, FPDFText_CountChars(textPage));
+            MemoryTracker::track(doc, textPage, MemoryTracker::TEXT_PAGE,
+                                 MemoryTracker::kTextPageBaseBytes + chars * MemoryTracker::kTextCharBytes);
             return reinterpret_cast<jlong>(textPage);
         } else {
             throw std::runtime_error("Load page null");
@@ -241,11 +757,13 @@ public:
     jobject callbackObject;
     jmethodID callbackMethodID;
     _JNIEnv *env;
+    uint64_t bytesWritten = 0;
 
     static int
     WriteBlockCallback(FPDF_FILEWRITE *pFileWrite, const void *data, unsigned long size) {
         auto *pThis = reinterpret_cast<FileWrite *>(pFileWrite);
         _JNIEnv *env = pThis->env;
+        pThis->bytesWritten += size;
         //Convert the native array to Java array.
         jbyteArray a = env->NewByteArray((int) size);
         if (a != nullptr) {
@@ -256,139 +774,801 @@ public:
     }
 };
 
-extern "C" { //For JNI support
-
-int getBlock(void *param, unsigned long position, unsigned char *outBuffer, unsigned long size) {
-    const int fd = reinterpret_cast<intptr_t>(param);
-    const int readCount = pread(fd, outBuffer, size, position);
-    if (readCount < 0) {
-        LOGE("Cannot read from file descriptor. Error: %d", errno);
-        return 0;
+// Writes |size| bytes to |fd|, retrying partial and interrupted writes
+static bool writeFd(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            LOGE("Cannot write to file descriptor. Error: %d", errno);
+            return false;
+        }
+        data += written;
+        size -= written;
     }
-    return 1;
+    return true;
 }
 
-JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd, jstring password) {
-    auto fileLength = (size_t) getFileSize(fd);
-    if (fileLength <= 0) {
-        jniThrowException(env, "java/io/IOException", "File is empty");
-        return -1;
-    }
-    std::unique_ptr<DocumentFile> docFile(new DocumentFile());
-
-    FPDF_FILEACCESS loader;
-    loader.m_FileLen = fileLength;
-    loader.m_Param = reinterpret_cast<void *>(intptr_t(fd));
-    loader.m_GetBlock = &getBlock;
+class FdWrite : public FPDF_FILEWRITE {
+public:
+    static const size_t kBufferSize = 64 * 1024;
 
-    const char *cPassword = nullptr;
-    if (password != nullptr) {
-        cPassword = env->GetStringUTFChars(password, nullptr);
-        if (env->ExceptionCheck()) {
-            return -1; // docFile auto-released by unique_ptr
-        }
+    explicit FdWrite(int fd) : fd(fd) {
+        version = 1;
+        FPDF_FILEWRITE::WriteBlock = WriteBlockCallback;
+        buffer.reserve(kBufferSize);
     }
 
-    FPDF_DOCUMENT document = FPDF_LoadCustomDocument(&loader, cPassword);
-    if (cPassword != nullptr) {
-        env->ReleaseStringUTFChars(password, cPassword);
+    // Writes the buffered bytes, returns whether every block reached the file
+    bool flush() {
+        if (!failed && !buffer.empty()) writeFully(buffer.data(), buffer.size());
+        buffer.clear();
+        return !failed;
     }
 
-    if (!document) {
-        const unsigned long errorNum = FPDF_GetLastError();
-        if (errorNum == FPDF_ERR_PASSWORD) {
-            jniThrowException(env, "com/ahmer/pdfium/PdfPasswordException",
-                              "Password required or incorrect password.");
+    uint64_t bytesWritten = 0;
+
+private:
+    int fd;
+    bool failed = false;
+    std::vector<char> buffer;
+
+    void writeFully(const char *data, size_t size) {
+        if (writeFd(fd, data, size)) {
+            bytesWritten += size;
         } else {
-            char *error = getErrorDescription(errorNum);
-            jniThrowExceptionFmt(env, "java/io/IOException", "Cannot create document: %s", error);
-            free(error);
+            failed = true;
         }
-        return -1;
     }
-    docFile->pdfDocument = document;
-    return reinterpret_cast<jlong>(docFile.release()); // Transfer ownership
-}
-
-JNI_FUNC(jlong, PdfiumCore, nativeOpenMemDocument)(JNI_ARGS, jbyteArray data, jstring password) {
-    std::unique_ptr<DocumentFile> docFile(new DocumentFile());
 
-    const char *cPassword = nullptr;
-    if (password != nullptr) {
-        cPassword = env->GetStringUTFChars(password, nullptr);
+    // PDFium writes many small blocks, they are gathered into one write per buffer
+    static int WriteBlockCallback(FPDF_FILEWRITE *pFileWrite, const void *data, unsigned long size) {
+        auto *pThis = static_cast<FdWrite *>(pFileWrite);
+        if (pThis->failed) return 0;
+        if (pThis->buffer.size() + size > kBufferSize) {
+            pThis->flush();
+            if (size >= kBufferSize) {
+                pThis->writeFully(static_cast<const char *>(data), size);
+                return !pThis->failed;
+            }
+        }
+        auto *bytes = static_cast<const char *>(data);
+        pThis->buffer.insert(pThis->buffer.end(), bytes, bytes + size);
+        return !pThis->failed;
     }
+};
 
-    jbyte *cData = env->GetByteArrayElements(data, nullptr);
-    int size = (int) env->GetArrayLength(data);
-    auto *cDataCopy = new jbyte[size];
-    env->GetByteArrayRegion(data, 0, size, cDataCopy);
-    FPDF_DOCUMENT document = FPDF_LoadMemDocument(reinterpret_cast<const void *>(cDataCopy), size,
-                                                  cPassword);
-    env->ReleaseByteArrayElements(data, cData, JNI_ABORT);
-    if (cPassword != nullptr) {
-        env->ReleaseStringUTFChars(password, cPassword);
-    }
+// Saves a document created by the split or merge engine to a file descriptor
+static bool saveToFd(FPDF_DOCUMENT document, int fd, uint64_t *bytesWritten) {
+    FdWrite fw(fd);
+    const bool saved = FPDF_SaveAsCopy(document, &fw, FPDF_NO_INCREMENTAL) && fw.flush();
+    *bytesWritten += fw.bytesWritten;
+    return saved;
+}
 
-    if (!document) {
-        const unsigned long errorNum = FPDF_GetLastError();
-        if (errorNum == FPDF_ERR_PASSWORD) {
-            jniThrowException(env, "com/ahmer/pdfium/PdfPasswordException",
-                              "Password required or incorrect password.");
-        } else {
-            char *error = getErrorDescription(errorNum);
-            jniThrowExceptionFmt(env, "java/io/IOException", "Cannot create document: %s", error);
-            free(error);
+// Values per image of nativeGetPageImages: object index, width, height, bits per pixel, color space,
+// raw data size and the bounds on the page (left, bottom, right, top)
+static const int kImageInfoSize = 10;
+
+static FPDF_PAGEOBJECT getImageObject(FPDF_PAGE page, int objectIndex) {
+    FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, objectIndex);
+    return object != nullptr && FPDFPageObj_GetType(object) == FPDF_PAGEOBJ_IMAGE ? object : nullptr;
+}
+
+// Reads the pixel at x of a row decoded by PDFium into premultiplied RGBA, as Android bitmaps are
+static void readRgba(int format, const uint8_t *in, int x, uint32_t *rgba) {
+    switch (format) {
+        case FPDFBitmap_Gray:
+            rgba[0] = rgba[1] = rgba[2] = in[x];
+            rgba[3] = 0xFF;
+            break;
+        case FPDFBitmap_BGR:
+            rgba[0] = in[x * 3 + 2];
+            rgba[1] = in[x * 3 + 1];
+            rgba[2] = in[x * 3];
+            rgba[3] = 0xFF;
+            break;
+        default: {
+            const uint8_t alpha = format == FPDFBitmap_BGRx ? 0xFF : in[x * 4 + 3];
+            const bool premultiply = format == FPDFBitmap_BGRA;
+            rgba[0] = premultiply ? in[x * 4 + 2] * alpha / 255 : in[x * 4 + 2];
+            rgba[1] = premultiply ? in[x * 4 + 1] * alpha / 255 : in[x * 4 + 1];
+            rgba[2] = premultiply ? in[x * 4] * alpha / 255 : in[x * 4];
+            rgba[3] = alpha;
+            break;
         }
-        return -1;
     }
-    docFile->pdfDocument = document;
-    docFile->cDataCopy = cDataCopy;
-    return reinterpret_cast<jlong>(docFile.release());
 }
 
-static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex) {
-    try {
-        if (doc == nullptr) throw std::runtime_error("Get page document null");
-        FPDF_DOCUMENT pdfDoc = doc->pdfDocument;
-        if (pdfDoc != nullptr) {
-            FPDF_PAGE page = FPDF_LoadPage(pdfDoc, pageIndex);
-            if (page == nullptr) {
-                throw std::runtime_error("Loaded page is null");
+// Copies a bitmap decoded by PDFium into an RGBA_8888 Android bitmap, averaging blocks of
+// sampleSize x sampleSize pixels: the Android bitmap is the decoded size divided by sampleSize
+static bool copyToRgba(FPDF_BITMAP source, void *dest, const AndroidBitmapInfo *info, int sampleSize) {
+    const int format = FPDFBitmap_GetFormat(source);
+    const int width = FPDFBitmap_GetWidth(source);
+    const int height = FPDFBitmap_GetHeight(source);
+    const int stride = FPDFBitmap_GetStride(source);
+    const auto *pixels = static_cast<const uint8_t *>(FPDFBitmap_GetBuffer(source));
+    if (pixels == nullptr || sampleSize < 1) return false;
+    if (std::max(1, width / sampleSize) != (int) info->width || std::max(1, height / sampleSize) != (int) info->height) {
+        return false;
+    }
+    if (format != FPDFBitmap_Gray && format != FPDFBitmap_BGR && format != FPDFBitmap_BGRx &&
+        format != FPDFBitmap_BGRA && format != FPDFBitmap_BGRA_Premul) {
+        return false;
+    }
+    for (int y = 0; y < (int) info->height; y++) {
+        auto *out = reinterpret_cast<uint8_t *>(dest) + (size_t) y * info->stride;
+        const int rowEnd = std::min(height, (y + 1) * sampleSize);
+        for (int x = 0; x < (int) info->width; x++, out += 4) {
+            const int columnEnd = std::min(width, (x + 1) * sampleSize);
+            uint32_t sum[4] = {0, 0, 0, 0};
+            uint32_t count = 0;
+            for (int sourceY = y * sampleSize; sourceY < rowEnd; sourceY++) {
+                const uint8_t *in = pixels + (size_t) sourceY * stride;
+                for (int sourceX = x * sampleSize; sourceX < columnEnd; sourceX++, count++) {
+                    uint32_t rgba[4];
+                    readRgba(format, in, sourceX, rgba);
+                    for (int i = 0; i < 4; i++) sum[i] += rgba[i];
+                }
             }
-            return reinterpret_cast<jlong>(page);
-        } else {
-            throw std::runtime_error("Get page PDF document null");
+            for (int i = 0; i < 4; i++) out[i] = (uint8_t) (sum[i] / count);
         }
-    } catch (const char *msg) {
-        LOGE("%s", msg);
-        jniThrowException(env, "java/lang/IllegalStateException", "Cannot load page");
-        return -1;
     }
+    return true;
 }
 
-static void closePageInternal(jlong pagePtr) {
-    FPDF_ClosePage(reinterpret_cast<FPDF_PAGE>(pagePtr));
-}
+// Share of the crop box a single image must cover for the page to be treated as a scan
+static const float kScanImageCoverage = 0.98f;
 
-static void closeTextPageInternal(jlong textPagePtr) {
-    FPDFText_ClosePage(reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr));
+// Finds the image of a scanned page: a single upright image covering the crop box, with no other content
+// and no annotations. Fills |out| with the object index and the image placement relative to the crop box
+// (left, top, right, bottom, top-down) and returns true if the page is such a scan.
+static bool getScanImage(FPDF_PAGE page, float *out) {
+    if (FPDFPage_CountObjects(page) != 1 || FPDFPage_GetAnnotCount(page) != 0 || FPDFPage_GetRotation(page) != 0) {
+        return false;
+    }
+    FPDF_PAGEOBJECT object = getImageObject(page, 0);
+    FS_MATRIX matrix;
+    if (object == nullptr || !FPDFPageObj_GetMatrix(object, &matrix)) return false;
+    if (matrix.b != 0 || matrix.c != 0 || matrix.a <= 0 || matrix.d <= 0) return false;
+    // Scans are drawn from FPDFImageObj_GetBitmap, which ignores masks. Soft masked images are reported as
+    // transparent, stencil masks (/ImageMask) have no color space
+    FPDF_IMAGEOBJ_METADATA metadata;
+    if (FPDFPageObj_HasTransparency(object) || !FPDFImageObj_GetImageMetadata(object, page, &metadata) ||
+        metadata.colorspace == FPDF_COLORSPACE_UNKNOWN) {
+        return false;
+    }
+
+    FS_RECTF crop;
+    float left, bottom, right, top;
+    if (!FPDF_GetPageBoundingBox(page, &crop) || !FPDFPageObj_GetBounds(object, &left, &bottom, &right, &top)) {
+        return false;
+    }
+    const float cropWidth = crop.right - crop.left;
+    const float cropHeight = crop.top - crop.bottom;
+    if (cropWidth <= 0 || cropHeight <= 0) return false;
+    const float coveredWidth = std::min(right, crop.right) - std::max(left, crop.left);
+    const float coveredHeight = std::min(top, crop.top) - std::max(bottom, crop.bottom);
+    if (coveredWidth <= 0 || coveredHeight <= 0 ||
+        coveredWidth * coveredHeight < kScanImageCoverage * cropWidth * cropHeight) {
+        return false;
+    }
+    out[0] = 0;
+    out[1] = (left - crop.left) / cropWidth;
+    out[2] = (crop.top - top) / cropHeight;
+    out[3] = (right - crop.left) / cropWidth;
+    out[4] = (crop.top - bottom) / cropHeight;
+    return true;
 }
 
-static void renderPageInternal(FPDF_PAGE page, ANativeWindow_Buffer *windowBuffer, int startX, int startY,
-                               int canvasHorSize, int canvasVerSize, int drawSizeHor, int drawSizeVer,
-                               bool annotation) {
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(canvasHorSize, canvasVerSize,
-                                                FPDFBitmap_BGRA, windowBuffer->bits,
-                                                (int) (windowBuffer->stride) * 4);
+// Margin and gap between the cells of an overview sheet, in sheet points
+static const float kSheetGap = 8.0f;
 
-    if (drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize) {
-        FPDFBitmap_FillRect(pdfBitmap, 0, 0, canvasHorSize, canvasVerSize, 0x848484FF); //Gray
+// Builds a one page document showing up to columns * rows pages of the source, starting at firstPage,
+// each page scaled into its cell as a form XObject, so the sheet renders in a single pass
+static FPDF_DOCUMENT createOverviewSheet(FPDF_DOCUMENT source, int firstPage, int columns, int rows,
+                                         float sheetWidth, float sheetHeight) {
+    FPDF_DOCUMENT sheet = FPDF_CreateNewDocument();
+    if (sheet == nullptr) return nullptr;
+    FPDF_PAGE page = FPDFPage_New(sheet, 0, sheetWidth, sheetHeight);
+    if (page == nullptr) {
+        FPDF_CloseDocument(sheet);
+        return nullptr;
     }
-    int baseHorSize = (canvasHorSize < drawSizeHor) ? canvasHorSize : drawSizeHor;
-    int baseVerSize = (canvasVerSize < drawSizeVer) ? canvasVerSize : drawSizeVer;
-    int baseX = (startX < 0) ? 0 : startX;
-    int baseY = (startY < 0) ? 0 : startY;
-    int flags = FPDF_REVERSE_BYTE_ORDER;
+    const float cellWidth = (sheetWidth - kSheetGap * (columns + 1)) / columns;
+    const float cellHeight = (sheetHeight - kSheetGap * (rows + 1)) / rows;
+    const int lastPage = std::min(firstPage + columns * rows, FPDF_GetPageCount(source));
+    for (int index = firstPage; index < lastPage; index++) {
+        // The XObject holds the unrotated page in its own space, bounded by the page box
+        FPDF_PAGE sourcePage = FPDF_LoadPage(source, index);
+        if (sourcePage == nullptr) continue;
+        FS_RECTF box;
+        const bool hasBox = FPDF_GetPageBoundingBox(sourcePage, &box);
+        const int rotation = FPDFPage_GetRotation(sourcePage);
+        FPDF_ClosePage(sourcePage);
+        const float boxWidth = box.right - box.left;
+        const float boxHeight = box.top - box.bottom;
+        if (!hasBox || boxWidth <= 0 || boxHeight <= 0) continue;
+        FPDF_XOBJECT xobject = FPDF_NewXObjectFromPage(sheet, source, index);
+        if (xobject == nullptr) continue;
+        FPDF_PAGEOBJECT form = FPDF_NewFormObjectFromXObject(xobject);
+        FPDF_CloseXObject(xobject);
+        if (form == nullptr) continue;
+
+        const bool isSideways = rotation % 2 == 1;
+        const float pageWidth = isSideways ? boxHeight : boxWidth;
+        const float pageHeight = isSideways ? boxWidth : boxHeight;
+        const int cell = index - firstPage;
+        const float scale = std::min(cellWidth / pageWidth, cellHeight / pageHeight);
+        const float width = pageWidth * scale;
+        const float height = pageHeight * scale;
+        // PDF space grows upwards, the first row is at the top of the sheet
+        const float x = kSheetGap + (cell % columns) * (cellWidth + kSheetGap) + (cellWidth - width) / 2;
+        const float y = sheetHeight - (cell / columns + 1) * (cellHeight + kSheetGap) + (cellHeight - height) / 2;
+        // Move the box to the origin, turn it clockwise by the page rotation so it stays in the positive
+        // quadrant, then scale it into the cell
+        FPDFPageObj_Transform(form, 1, 0, 0, 1, -box.left, -box.bottom);
+        switch (rotation) {
+            case 1:
+                FPDFPageObj_Transform(form, 0, -1, 1, 0, 0, boxWidth);
+                break;
+            case 2:
+                FPDFPageObj_Transform(form, -1, 0, 0, -1, boxWidth, boxHeight);
+                break;
+            case 3:
+                FPDFPageObj_Transform(form, 0, 1, -1, 0, boxHeight, 0);
+                break;
+            default:
+                break;
+        }
+        FPDFPageObj_Transform(form, scale, 0, 0, scale, x, y);
+        FPDFPage_InsertObject(page, form);
+
+        FPDF_PAGEOBJECT frame = FPDFPageObj_CreateNewRect(x, y, width, height);
+        FPDFPageObj_SetStrokeColor(frame, 160, 160, 160, 255);
+        FPDFPageObj_SetStrokeWidth(frame, 0.5f);
+        FPDFPath_SetDrawMode(frame, FPDF_FILLMODE_NONE, true);
+        FPDFPage_InsertObject(page, frame);
+    }
+    FPDFPage_GenerateContent(page);
+    FPDF_ClosePage(page);
+    return sheet;
+}
+
+// Appends values to a buffer read back with a native order ByteBuffer
+class PackedWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void putInt(int32_t value) { put(&value, sizeof(value)); }
+
+    void putLong(int64_t value) { put(&value, sizeof(value)); }
+
+    void putFloat(float value) { put(&value, sizeof(value)); }
+
+    void putBytes(const void *data, size_t size) {
+        putInt((int32_t) size);
+        put(data, size);
+    }
+
+    // PDFium writes UTF-16 strings with their terminator, the buffer holds the length then the chars
+    void putString(const std::u16string &value) {
+        putInt((int32_t) value.size());
+        put(value.data(), value.size() * sizeof(char16_t));
+    }
+
+    template<typename Getter>
+    void putWideString(Getter getter) {
+        const unsigned long size = getter(nullptr, 0);
+        const int32_t length = size >= sizeof(FPDF_WCHAR) ? (int32_t) (size / sizeof(FPDF_WCHAR)) - 1 : 0;
+        putInt(length);
+        if (length <= 0) return;
+        std::vector<FPDF_WCHAR> chars(length + 1);
+        getter(chars.data(), size);
+        put(chars.data(), length * sizeof(FPDF_WCHAR));
+    }
+
+private:
+    void put(const void *data, size_t size) {
+        auto *begin = reinterpret_cast<const uint8_t *>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+};
+
+static std::u16string toU16String(JNIEnv *env, jstring value) {
+    const jchar *chars = env->GetStringChars(value, nullptr);
+    if (chars == nullptr) return {};
+    std::u16string result(chars, chars + env->GetStringLength(value));
+    env->ReleaseStringChars(value, chars);
+    return result;
+}
+
+template<typename Getter>
+static std::u16string getWideString(Getter getter) {
+    const unsigned long size = getter(nullptr, 0);
+    if (size <= sizeof(FPDF_WCHAR)) return {};
+    std::vector<FPDF_WCHAR> chars(size / sizeof(FPDF_WCHAR));
+    getter(chars.data(), size);
+    return {chars.begin(), chars.end() - 1};
+}
+
+/**
+ * Pages walked by the bulk form calls: the pages the caller has open are reused, the others are loaded
+ * one at a time, each closed as soon as the walk moves to the next page
+ */
+class FormPages {
+public:
+    FormPages(JNIEnv *env, FPDF_DOCUMENT document, jintArray openIndices, jlongArray openPtrs)
+            : document(document) {
+        const jsize count = env->GetArrayLength(openIndices);
+        std::vector<jint> indices(count);
+        std::vector<jlong> ptrs(count);
+        env->GetIntArrayRegion(openIndices, 0, count, indices.data());
+        env->GetLongArrayRegion(openPtrs, 0, count, ptrs.data());
+        for (jsize i = 0; i < count; i++) openPages[indices[i]] = reinterpret_cast<FPDF_PAGE>(ptrs[i]);
+    }
+
+    ~FormPages() { closeLoadedPage(); }
+
+    // The page previously returned is done with: a page loaded for it is closed, after its fields were committed
+    FPDF_PAGE get(int pageIndex) {
+        closeLoadedPage();
+        auto open = openPages.find(pageIndex);
+        if (open != openPages.end()) return open->second;
+        loadedPage = FPDF_LoadPage(document, pageIndex);
+        return loadedPage;
+    }
+
+private:
+    void closeLoadedPage() {
+        if (loadedPage == nullptr) return;
+        detachFormPage(loadedPage);
+        FPDF_ClosePage(loadedPage);
+        loadedPage = nullptr;
+    }
+
+    FPDF_DOCUMENT document;
+    std::map<int, FPDF_PAGE> openPages;
+    FPDF_PAGE loadedPage = nullptr;
+};
+
+// Applies a value through the form filler, which regenerates the appearance when the field loses the focus
+static bool setFormFieldValue(FPDF_FORMHANDLE form, FPDF_PAGE page, FPDF_ANNOTATION annot,
+                              const std::u16string &value) {
+    const int flags = FPDFAnnot_GetFormFieldFlags(form, annot);
+    if (flags & FPDF_FORMFLAG_READONLY) return false;
+
+    switch (FPDFAnnot_GetFormFieldType(form, annot)) {
+        case FPDF_FORMFIELD_CHECKBOX:
+        case FPDF_FORMFIELD_RADIOBUTTON: {
+            // Widgets of a group differ by export value, a lone check box is checked by any value but Off
+            const std::u16string exportValue = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                return FPDFAnnot_GetFormFieldExportValue(form, annot, buffer, length);
+            });
+            const bool isLone = FPDFAnnot_GetFormControlCount(form, annot) == 1;
+            const bool checked = value == exportValue || (isLone && value != u"Off");
+            const bool isRadio = FPDFAnnot_GetFormFieldType(form, annot) == FPDF_FORMFIELD_RADIOBUTTON;
+            if ((bool) FPDFAnnot_IsChecked(form, annot) != checked && (checked || !isRadio)) {
+                FORM_SetFocusedAnnot(form, annot);
+                FORM_OnChar(form, page, ' ', 0);
+            }
+            return true;
+        }
+        case FPDF_FORMFIELD_COMBOBOX:
+        case FPDF_FORMFIELD_LISTBOX: {
+            const int optionCount = FPDFAnnot_GetOptionCount(form, annot);
+            for (int i = 0; i < optionCount; i++) {
+                const std::u16string label = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                    return FPDFAnnot_GetOptionLabel(form, annot, i, buffer, length);
+                });
+                if (label == value) {
+                    FORM_SetFocusedAnnot(form, annot);
+                    return FORM_SetIndexSelected(form, page, i, true);
+                }
+            }
+            if (!(flags & FPDF_FORMFLAG_CHOICE_EDIT)) return false;
+            // Editable combo boxes take any text
+            [[fallthrough]];
+        }
+        case FPDF_FORMFIELD_TEXTFIELD:
+            if (!FORM_SetFocusedAnnot(form, annot)) return false;
+            FORM_SelectAllText(form, page);
+            FORM_ReplaceSelection(form, page, reinterpret_cast<FPDF_WIDESTRING>(value.c_str()));
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Block kinds of the reflow view, mirrored by PdfReflowBlock
+enum ReflowKind {
+    REFLOW_NONE = 0,
+    REFLOW_HEADING = 1,
+    REFLOW_PARAGRAPH = 2,
+    REFLOW_LIST_ITEM = 3,
+    REFLOW_TABLE_CELL = 4,
+    REFLOW_FIGURE = 5,
+    // Groups blocks, like Sect or Table, or marks inline content, like Span or Link
+    REFLOW_CONTAINER = -1,
+};
+
+struct ReflowBlock {
+    int kind;
+    int level;
+    std::u16string altText;
+    std::u16string actualText;
+    // Marked content of the block in reading order
+    std::vector<int> mcids;
+};
+
+static ReflowKind reflowKind(const std::u16string &type, int *level) {
+    *level = 0;
+    if (type.size() == 2 && type[0] == u'H' && type[1] >= u'1' && type[1] <= u'6') {
+        *level = type[1] - u'0';
+        return REFLOW_HEADING;
+    }
+    if (type == u"H" || type == u"Title") {
+        *level = 1;
+        return REFLOW_HEADING;
+    }
+    if (type == u"P" || type == u"Caption" || type == u"BlockQuote" || type == u"Note" || type == u"Code" ||
+        type == u"TOCI" || type == u"BibEntry") {
+        return REFLOW_PARAGRAPH;
+    }
+    if (type == u"LI") return REFLOW_LIST_ITEM;
+    if (type == u"TD" || type == u"TH") return REFLOW_TABLE_CELL;
+    if (type == u"Figure" || type == u"Formula") return REFLOW_FIGURE;
+    return REFLOW_CONTAINER;
+}
+
+// Marked content of an element and its descendants, in the order of the structure tree
+static void collectMcids(FPDF_STRUCTELEMENT element, std::vector<int> &mcids) {
+    const int count = FPDF_StructElement_CountChildren(element);
+    for (int i = 0; i < count; i++) {
+        FPDF_STRUCTELEMENT child = FPDF_StructElement_GetChildAtIndex(element, i);
+        if (child != nullptr) {
+            collectMcids(child, mcids);
+            continue;
+        }
+        const int mcid = FPDF_StructElement_GetChildMarkedContentID(element, i);
+        if (mcid >= 0) mcids.push_back(mcid);
+    }
+}
+
+/**
+ * Turns the structure tree into blocks in reading order. Text blocks take the whole content of their
+ * subtree, nested blocks included, except figures which always stand alone so they can be rendered as
+ * crops. Content hanging directly from a container becomes a paragraph.
+ */
+static void walkReflow(FPDF_STRUCTELEMENT element, std::vector<ReflowBlock> &blocks) {
+    const std::u16string type = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+        return FPDF_StructElement_GetType(element, buffer, length);
+    });
+    int level;
+    const ReflowKind kind = reflowKind(type, &level);
+    if (kind != REFLOW_CONTAINER) {
+        ReflowBlock block = {kind, level};
+        block.actualText = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+            return FPDF_StructElement_GetActualText(element, buffer, length);
+        });
+        if (kind == REFLOW_FIGURE) {
+            block.altText = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                return FPDF_StructElement_GetAltText(element, buffer, length);
+            });
+            collectMcids(element, block.mcids);
+            blocks.push_back(std::move(block));
+            return;
+        }
+        // The block is placed before the figures found inside it
+        const size_t index = blocks.size();
+        blocks.push_back(std::move(block));
+        const int count = FPDF_StructElement_CountChildren(element);
+        for (int i = 0; i < count; i++) {
+            FPDF_STRUCTELEMENT child = FPDF_StructElement_GetChildAtIndex(element, i);
+            if (child == nullptr) {
+                const int mcid = FPDF_StructElement_GetChildMarkedContentID(element, i);
+                if (mcid >= 0) blocks[index].mcids.push_back(mcid);
+                continue;
+            }
+            int childLevel;
+            std::u16string childType = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                return FPDF_StructElement_GetType(child, buffer, length);
+            });
+            if (reflowKind(childType, &childLevel) == REFLOW_FIGURE) {
+                walkReflow(child, blocks);
+            } else {
+                collectMcids(child, blocks[index].mcids);
+            }
+        }
+        return;
+    }
+
+    bool inParagraph = false;
+    const int count = FPDF_StructElement_CountChildren(element);
+    for (int i = 0; i < count; i++) {
+        FPDF_STRUCTELEMENT child = FPDF_StructElement_GetChildAtIndex(element, i);
+        if (child != nullptr) {
+            walkReflow(child, blocks);
+            inParagraph = false;
+            continue;
+        }
+        const int mcid = FPDF_StructElement_GetChildMarkedContentID(element, i);
+        if (mcid < 0) continue;
+        if (!inParagraph) blocks.push_back({REFLOW_PARAGRAPH, 0});
+        blocks.back().mcids.push_back(mcid);
+        inParagraph = true;
+    }
+}
+
+// Joins the text objects of a block, a space goes where the next object starts a line or leaves a gap
+static void appendReflowText(std::u16string &text, const std::u16string &run, const FS_RECTF &bounds,
+                             const FS_RECTF &previous, float fontSize) {
+    if (run.empty()) return;
+    if (!text.empty()) {
+        const float height = std::min(bounds.top - bounds.bottom, previous.top - previous.bottom);
+        const bool isNewLine = std::abs(bounds.bottom - previous.bottom) > height / 2;
+        const bool isGap = bounds.left - previous.right > fontSize * 0.2f;
+        if (isNewLine && (text.back() == u'\u00AD' || text.back() == u'\u0002')) {
+            // A hyphen the layout added to break a word
+            text.pop_back();
+        } else if ((isNewLine || isGap) && text.back() != u' ' && text.back() != u'-' && run.front() != u' ') {
+            text.push_back(u' ');
+        }
+    }
+    text.append(run);
+}
+
+extern "C" { //For JNI support
+
+int getBlock(void *param, unsigned long position, unsigned char *outBuffer, unsigned long size) {
+    const int fd = reinterpret_cast<intptr_t>(param);
+    const int readCount = pread(fd, outBuffer, size, position);
+    if (readCount < 0) {
+        LOGE("Cannot read from file descriptor. Error: %d", errno);
+        return 0;
+    }
+    return 1;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeSetFontCacheDir)(JNI_ARGS, jstring cacheDir) {
+    const char *path = env->GetStringUTFChars(cacheDir, nullptr);
+    if (path == nullptr) return;
+    FontIndex::setCacheDir(path);
+    env->ReleaseStringUTFChars(cacheDir, path);
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeWarmUpLibrary)(JNI_ARGS) {
+    const std::lock_guard<std::mutex> lock(sLibraryLock);
+    return (jboolean) initLibraryLocked();
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeWarmUpFonts)(JNI_ARGS) {
+    return (jint) FontIndex::ensureLoaded();
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativePrimeRenderer)(JNI_ARGS) {
+    const std::lock_guard<std::mutex> lock(sLibraryLock);
+    initLibraryLocked();
+    return (jboolean) primeRendererLocked();
+}
+
+JNI_FUNC(void, PdfiumCore, nativeSetLibraryKeepAlive)(JNI_ARGS, jboolean keepAlive) {
+    const std::lock_guard<std::mutex> lock(sLibraryLock);
+    sLibraryKeepAlive = keepAlive;
+    if (!sLibraryKeepAlive) {
+        destroyLibraryLocked();
+    }
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeReleaseLibrary)(JNI_ARGS) {
+    const std::lock_guard<std::mutex> lock(sLibraryLock);
+    return (jboolean) destroyLibraryLocked();
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetStats)(JNI_ARGS) {
+    jlong values[JniStats::COUNTER_COUNT * JniStats::kValuesPerCounter];
+    if (!JniStats::snapshot(reinterpret_cast<int64_t *>(values))) return nullptr;
+    const jsize size = JniStats::COUNTER_COUNT * JniStats::kValuesPerCounter;
+    jlongArray result = env->NewLongArray(size);
+    if (result != nullptr) env->SetLongArrayRegion(result, 0, size, values);
+    return result;
+}
+
+JNI_FUNC(void, PdfiumCore, nativeResetStats)(JNI_ARGS) {
+    JniStats::reset();
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetMemoryUsage)(JNI_ARGS, jlong docPtr) {
+    jlong values[MemoryTracker::kSnapshotSize];
+    MemoryTracker::snapshot(reinterpret_cast<const void *>(docPtr), reinterpret_cast<int64_t *>(values));
+    jlongArray result = env->NewLongArray(MemoryTracker::kSnapshotSize);
+    if (result != nullptr) env->SetLongArrayRegion(result, 0, MemoryTracker::kSnapshotSize, values);
+    return result;
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeOpenDocument)(JNI_ARGS, jint fd, jstring password) {
+    JNI_STATS_SCOPE(OPEN);
+    TRACE_SECTION("pdfium:openDocument");
+    auto fileLength = (size_t) getFileSize(fd);
+    if (fileLength <= 0) {
+        jniThrowException(env, "java/io/IOException", "File is empty");
+        return -1;
+    }
+    JNI_STATS_BYTES(fileLength);
+    std::unique_ptr<DocumentFile> docFile(new DocumentFile());
+
+    FPDF_FILEACCESS loader;
+    loader.m_FileLen = fileLength;
+    loader.m_Param = reinterpret_cast<void *>(intptr_t(fd));
+    loader.m_GetBlock = &getBlock;
+
+    const char *cPassword = nullptr;
+    if (password != nullptr) {
+        cPassword = env->GetStringUTFChars(password, nullptr);
+        if (env->ExceptionCheck()) {
+            return -1; // docFile auto-released by unique_ptr
+        }
+    }
+
+    FPDF_DOCUMENT document = FPDF_LoadCustomDocument(&loader, cPassword);
+    if (cPassword != nullptr) {
+        env->ReleaseStringUTFChars(password, cPassword);
+    }
+
+    if (!document) {
+        const unsigned long errorNum = FPDF_GetLastError();
+        if (errorNum == FPDF_ERR_PASSWORD) {
+            jniThrowException(env, "com/ahmer/pdfium/PdfPasswordException",
+                              "Password required or incorrect password.");
+        } else {
+            char *error = getErrorDescription(errorNum);
+            jniThrowExceptionFmt(env, "java/io/IOException", "Cannot create document: %s", error);
+            free(error);
+        }
+        return -1;
+    }
+    docFile->pdfDocument = document;
+    docFile->sourceFd = fd;
+    docFile->sourceLength = fileLength;
+    return reinterpret_cast<jlong>(docFile.release()); // Transfer ownership
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeOpenMemDocument)(JNI_ARGS, jbyteArray data, jstring password) {
+    JNI_STATS_SCOPE(OPEN);
+    TRACE_SECTION("pdfium:openMemDocument");
+    std::unique_ptr<DocumentFile> docFile(new DocumentFile());
+
+    const char *cPassword = nullptr;
+    if (password != nullptr) {
+        cPassword = env->GetStringUTFChars(password, nullptr);
+    }
+
+    jbyte *cData = env->GetByteArrayElements(data, nullptr);
+    int size = (int) env->GetArrayLength(data);
+    JNI_STATS_BYTES(size);
+    auto *cDataCopy = new jbyte[size];
+    env->GetByteArrayRegion(data, 0, size, cDataCopy);
+    FPDF_DOCUMENT document = FPDF_LoadMemDocument(reinterpret_cast<const void *>(cDataCopy), size,
+                                                  cPassword);
+    env->ReleaseByteArrayElements(data, cData, JNI_ABORT);
+    if (cPassword != nullptr) {
+        env->ReleaseStringUTFChars(password, cPassword);
+    }
+
+    if (!document) {
+        const unsigned long errorNum = FPDF_GetLastError();
+        if (errorNum == FPDF_ERR_PASSWORD) {
+            jniThrowException(env, "com/ahmer/pdfium/PdfPasswordException",
+                              "Password required or incorrect password.");
+        } else {
+            char *error = getErrorDescription(errorNum);
+            jniThrowExceptionFmt(env, "java/io/IOException", "Cannot create document: %s", error);
+            free(error);
+        }
+        return -1;
+    }
+    docFile->pdfDocument = document;
+    docFile->cDataCopy = cDataCopy;
+    docFile->sourceLength = (size_t) size;
+    MemoryTracker::track(docFile.get(), cDataCopy, MemoryTracker::SOURCE, (size_t) size);
+    return reinterpret_cast<jlong>(docFile.release());
+}
+
+static jlong loadPageInternal(JNIEnv *env, DocumentFile *doc, int pageIndex) {
+    TRACE_SECTION("pdfium:loadPage %d", pageIndex);
+    try {
+        if (doc == nullptr) throw std::runtime_error("Get page document null");
+        FPDF_DOCUMENT pdfDoc = doc->pdfDocument;
+        if (pdfDoc != nullptr) {
+            FPDF_PAGE page = FPDF_LoadPage(pdfDoc, pageIndex);
+            if (page == nullptr) {
+                throw std::runtime_error("Loaded page is null");
+            }
+            const int objects = std::max(0, FPDFPage_CountObjects(page));
+            MemoryTracker::track(doc, page, MemoryTracker::PAGE,
+                                 MemoryTracker::kPageBaseBytes + objects * MemoryTracker::kPageObjectBytes);
+            return reinterpret_cast<jlong>(page);
+        } else {
+            throw std::runtime_error("Get page PDF document null");
+        }
+    } catch (const char *msg) {
+        LOGE("%s", msg);
+        jniThrowException(env, "java/lang/IllegalStateException", "Cannot load page");
+        return -1;
+    }
+}
+
+static void closePageInternal(jlong pagePtr) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    detachFormPage(page);
+    closeMarkupPage(page);
+    MemoryTracker::untrack(reinterpret_cast<const void *>(pagePtr));
+    FPDF_ClosePage(page);
+}
+
+static void formInvalidate(FPDF_FORMFILLINFO *info, FPDF_PAGE page, double left, double top, double right,
+                           double bottom) {
+    auto *formInfo = static_cast<FormFillInfo *>(info);
+    formInfo->doc->formDirtyRects.push_back({page, (float) left, (float) top, (float) right, (float) bottom});
+}
+
+/**
+ * Form environment of the document, created on the first interactive use and kept until the document is
+ * closed, so focus, caret and edited text survive between calls. The page is attached to it if needed.
+ */
+static FPDF_FORMHANDLE formFillHandle(DocumentFile *doc, FPDF_PAGE page) {
+    if (doc->formHandle == nullptr) {
+        doc->formInfo.version = 2;
+        doc->formInfo.FFI_Invalidate = formInvalidate;
+        doc->formInfo.doc = doc;
+        doc->formHandle = FPDFDOC_InitFormFillEnvironment(doc->pdfDocument, &doc->formInfo);
+        if (doc->formHandle == nullptr) return nullptr;
+    }
+    if (page != nullptr && sFormPages.find(page) == sFormPages.end()) {
+        FORM_OnAfterLoadPage(page, doc->formHandle);
+        sFormPages[page] = doc->formHandle;
+    }
+    return doc->formHandle;
+}
+
+/**
+ * The persistent form environment if forms are being filled, so renders show the focused field and its
+ * caret, otherwise nullptr
+ */
+static FPDF_FORMHANDLE activeFormHandle(DocumentFile *doc, FPDF_PAGE page) {
+    return doc->formHandle != nullptr ? formFillHandle(doc, page) : nullptr;
+}
+
+/**
+ * Form environment drawing the form fields of every band of a page: the persistent one when forms are
+ * being filled, so typed values are rendered, otherwise one created for the page and owned here
+ */
+struct BandForm {
+    FPDF_FORMFILLINFO info;
+    FPDF_FORMHANDLE handle;
+    bool isOwned;
+};
+
+static void closeTextPageInternal(jlong textPagePtr) {
+    MemoryTracker::untrack(reinterpret_cast<const void *>(textPagePtr));
+    FPDFText_ClosePage(reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr));
+}
+
+static void renderPageInternal(FPDF_PAGE page, ANativeWindow_Buffer *windowBuffer, int startX, int startY,
+                               int canvasHorSize, int canvasVerSize, int drawSizeHor, int drawSizeVer,
+                               bool annotation) {
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(canvasHorSize, canvasVerSize,
+                                                FPDFBitmap_BGRA, windowBuffer->bits,
+                                                (int) (windowBuffer->stride) * 4);
+
+    if (drawSizeHor < canvasHorSize || drawSizeVer < canvasVerSize) {
+        FPDFBitmap_FillRect(pdfBitmap, 0, 0, canvasHorSize, canvasVerSize, 0x848484FF); //Gray
+    }
+    int baseHorSize = (canvasHorSize < drawSizeHor) ? canvasHorSize : drawSizeHor;
+    int baseVerSize = (canvasVerSize < drawSizeVer) ? canvasVerSize : drawSizeVer;
+    int baseX = (startX < 0) ? 0 : startX;
+    int baseY = (startY < 0) ? 0 : startY;
+    int flags = FPDF_REVERSE_BYTE_ORDER;
 
     if (startX + baseHorSize > drawSizeHor) {
         baseHorSize = drawSizeHor - startX;
@@ -420,6 +1600,7 @@ JNI_PdfDocument(jint, PdfiumCore, nativeGetPageCount)(JNI_ARGS, jlong docPtr) {
 }
 
 JNI_PdfDocument(jlong, PdfiumCore, nativeLoadPage)(JNI_ARGS, jlong docPtr, jint pageIndex) {
+    JNI_STATS_SCOPE(LOAD_PAGE);
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
     return loadPageInternal(env, doc, (int) pageIndex);
 }
@@ -442,6 +1623,7 @@ JNI_PdfDocument(void, PdfiumCore, nativeCloseDocument)(JNI_ARGS, jlong docPtr) {
 
 JNI_PdfDocument(jlongArray, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr, jint fromIndex,
                                                          jint toIndex) {
+    JNI_STATS_SCOPE(LOAD_PAGE);
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
 
     // Check for invalid index range
@@ -470,91 +1652,360 @@ JNI_PdfDocument(jlongArray, PdfiumCore, nativeLoadPages)(JNI_ARGS, jlong docPtr,
 }
 
 JNI_PdfDocument(jstring, PdfiumCore, nativeGetDocumentMetaText)(JNI_ARGS, jlong docPtr, jstring tag) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
     const char *cTag = env->GetStringUTFChars(tag, nullptr);
     if (cTag == nullptr) {
         return env->NewStringUTF("");
     }
+    const std::u16string text = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+        return FPDF_GetMetaText(doc->pdfDocument, cTag, buffer, length);
+    });
+    env->ReleaseStringUTFChars(tag, cTag);
+    return env->NewString(reinterpret_cast<const jchar *>(text.data()), (jsize) text.size());
+}
+
+JNI_PdfDocument(jlong, PdfiumCore, nativeLoadTextPage)(JNI_ARGS, jlong docPtr, jlong pagePtr) {
+    JNI_STATS_SCOPE(LOAD_TEXT);
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    return loadTextPageInternal(env, doc, pagePtr);
+}
 
-    size_t bufferLen = FPDF_GetMetaText(doc->pdfDocument, cTag, nullptr, 0);
-    if (bufferLen <= 2) {
-        return env->NewStringUTF("");
+JNI_PdfDocument(jboolean, PdfiumCore, nativeSaveAsCopy)(JNI_ARGS, jlong docPtr, jobject callback,
+                                                        jint flags) {
+    JNI_STATS_SCOPE(SAVE);
+    jclass callbackClass = env->FindClass("com/ahmer/pdfium/PdfWriteCallback");
+    if (callback != nullptr && env->IsInstanceOf(callback, callbackClass)) {
+        //Setup the callback to Java.
+        FileWrite fw = FileWrite();
+        fw.version = 1;
+        fw.FPDF_FILEWRITE::WriteBlock = FileWrite::WriteBlockCallback;
+        fw.callbackObject = callback;
+        fw.callbackMethodID = env->GetMethodID(callbackClass, "WriteBlock", "([B)I");
+        fw.env = env;
+
+        auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+        const jboolean saved = (jboolean) FPDF_SaveAsCopy(doc->pdfDocument, &fw, flags);
+        JNI_STATS_BYTES(fw.bytesWritten);
+        return saved;
     }
-    std::wstring text;
-    FPDF_GetMetaText(doc->pdfDocument, cTag, WriteInto(&text, bufferLen + 1), bufferLen);
-    env->ReleaseStringUTFChars(tag, cTag);
-    return env->NewString((jchar *) text.c_str(), bufferLen / 2 - 1);
+    return false;
 }
 
-JNI_PdfDocument(jlong, PdfiumCore, nativeGetFirstChildBookmark)(JNI_ARGS, jlong docPtr, jlong bookmarkPtr) {
+JNI_PdfDocument(jint, PdfiumCore, nativeSplitDocument)(JNI_ARGS, jlong docPtr, jintArray pageIndices,
+                                                     jintArray partSizes, jintArray outputFds) {
+    JNI_STATS_SCOPE(SAVE);
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
-    FPDF_BOOKMARK parent;
-    if (bookmarkPtr == 0) {
-        parent = nullptr;
-    } else {
-        parent = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
-    }
-    FPDF_BOOKMARK bookmark = FPDFBookmark_GetFirstChild(doc->pdfDocument, parent);
-    if (bookmark == nullptr) {
-        return 0;
+    const jsize partCount = env->GetArrayLength(partSizes);
+    if (doc == nullptr || env->GetArrayLength(outputFds) != partCount) return 0;
+    TRACE_SECTION("pdfium:splitDocument parts=%d", (int) partCount);
+
+    jint *indices = env->GetIntArrayElements(pageIndices, nullptr);
+    jint *sizes = env->GetIntArrayElements(partSizes, nullptr);
+    jint *fds = env->GetIntArrayElements(outputFds, nullptr);
+    const jsize indexCount = env->GetArrayLength(pageIndices);
+    uint64_t bytesWritten = 0;
+    int written = 0;
+    int offset = 0;
+    for (; written < partCount; written++) {
+        const int size = sizes[written];
+        if (size <= 0 || offset + size > indexCount) break;
+        FPDF_DOCUMENT part = FPDF_CreateNewDocument();
+        if (part == nullptr) break;
+        // Copying the viewer preferences fails when the source has none, which is not an error
+        FPDF_CopyViewerPreferences(part, doc->pdfDocument);
+        const bool saved = FPDF_ImportPagesByIndex(part, doc->pdfDocument, indices + offset, size, 0) &&
+                           saveToFd(part, fds[written], &bytesWritten);
+        FPDF_CloseDocument(part);
+        if (!saved) {
+            LOGE("Cannot write split part %d", written);
+            break;
+        }
+        offset += size;
+    }
+    env->ReleaseIntArrayElements(outputFds, fds, JNI_ABORT);
+    env->ReleaseIntArrayElements(partSizes, sizes, JNI_ABORT);
+    env->ReleaseIntArrayElements(pageIndices, indices, JNI_ABORT);
+    JNI_STATS_BYTES(bytesWritten);
+    return written;
+}
+
+JNI_PdfDocument(jboolean, PdfiumCore, nativeMergeDocuments)(JNI_ARGS, jlongArray docPtrs, jintArray pageIndices,
+                                                          jintArray partSizes, jint outputFd) {
+    JNI_STATS_SCOPE(SAVE);
+    const jsize docCount = env->GetArrayLength(docPtrs);
+    if (docCount == 0 || env->GetArrayLength(partSizes) != docCount) return false;
+    TRACE_SECTION("pdfium:mergeDocuments sources=%d", (int) docCount);
+
+    jlong *docs = env->GetLongArrayElements(docPtrs, nullptr);
+    jint *indices = env->GetIntArrayElements(pageIndices, nullptr);
+    jint *sizes = env->GetIntArrayElements(partSizes, nullptr);
+    const jsize indexCount = env->GetArrayLength(pageIndices);
+    FPDF_DOCUMENT merged = FPDF_CreateNewDocument();
+    bool saved = merged != nullptr;
+    int offset = 0;
+    for (int i = 0; saved && i < docCount; i++) {
+        auto *source = reinterpret_cast<DocumentFile *>(docs[i]);
+        // A negative size imports every page of the source
+        const int size = sizes[i];
+        if (source == nullptr || offset + (size > 0 ? size : 0) > indexCount) {
+            saved = false;
+            break;
+        }
+        if (size == 0) continue;
+        const int insertAt = FPDF_GetPageCount(merged);
+        saved = size < 0 ? FPDF_ImportPagesByIndex(merged, source->pdfDocument, nullptr, 0, insertAt)
+                         : FPDF_ImportPagesByIndex(merged, source->pdfDocument, indices + offset, size, insertAt);
+        if (i == 0) FPDF_CopyViewerPreferences(merged, source->pdfDocument);
+        if (size > 0) offset += size;
+    }
+    uint64_t bytesWritten = 0;
+    saved = saved && saveToFd(merged, outputFd, &bytesWritten);
+    if (merged != nullptr) FPDF_CloseDocument(merged);
+    env->ReleaseIntArrayElements(partSizes, sizes, JNI_ABORT);
+    env->ReleaseIntArrayElements(pageIndices, indices, JNI_ABORT);
+    env->ReleaseLongArrayElements(docPtrs, docs, JNI_ABORT);
+    JNI_STATS_BYTES(bytesWritten);
+    if (!saved) LOGE("Cannot merge documents");
+    return (jboolean) saved;
+}
+
+JNI_PdfDocument(jboolean, PdfiumCore, nativeSaveNUp)(JNI_ARGS, jlong docPtr, jint columns, jint rows,
+                                                   jfloat sheetWidth, jfloat sheetHeight, jint outputFd) {
+    JNI_STATS_SCOPE(SAVE);
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr || columns <= 0 || rows <= 0) return false;
+    TRACE_SECTION("pdfium:saveNUp %dx%d", columns, rows);
+    FPDF_DOCUMENT imposed = FPDF_ImportNPagesToOne(doc->pdfDocument, sheetWidth, sheetHeight, columns, rows);
+    if (imposed == nullptr) {
+        LOGE("Cannot impose %dx%d pages", columns, rows);
+        return false;
     }
-    return reinterpret_cast<jlong>(bookmark);
+    FPDF_CopyViewerPreferences(imposed, doc->pdfDocument);
+    uint64_t bytesWritten = 0;
+    const bool saved = saveToFd(imposed, outputFd, &bytesWritten);
+    FPDF_CloseDocument(imposed);
+    JNI_STATS_BYTES(bytesWritten);
+    return (jboolean) saved;
+}
+
+// Destination of a bookmark, given directly or through a GoTo action
+static FPDF_DEST getBookmarkDest(FPDF_DOCUMENT document, FPDF_BOOKMARK bookmark) {
+    FPDF_DEST dest = FPDFBookmark_GetDest(document, bookmark);
+    if (dest != nullptr) return dest;
+    FPDF_ACTION action = FPDFBookmark_GetAction(bookmark);
+    if (action == nullptr || FPDFAction_GetType(action) != PDFACTION_GOTO) return nullptr;
+    return FPDFAction_GetDest(document, action);
+}
+
+// Flags of the packed destinations and outline entries, mirrored by PdfDocument
+enum DestinationFlag {
+    DEST_HAS_X = 1 << 0,
+    DEST_HAS_Y = 1 << 1,
+    DEST_HAS_ZOOM = 1 << 2,
+    OUTLINE_HAS_CHILDREN = 1 << 3,
+    OUTLINE_EXPANDED = 1 << 4,
+};
+
+// Position and zoom of a destination, returns the DEST_HAS_ flags of the values that are set
+static int getDestLocation(FPDF_DEST dest, FS_FLOAT *x, FS_FLOAT *y, FS_FLOAT *zoom) {
+    FPDF_BOOL hasX = false, hasY = false, hasZoom = false;
+    if (!FPDFDest_GetLocationInPage(dest, &hasX, &hasY, &hasZoom, x, y, zoom)) return 0;
+    return (hasX ? DEST_HAS_X : 0) | (hasY ? DEST_HAS_Y : 0) | (hasZoom ? DEST_HAS_ZOOM : 0);
 }
 
-JNI_PdfDocument(jlong, PdfiumCore, nativeGetSiblingBookmark)(JNI_ARGS, jlong docPtr, jlong bookmarkPtr) {
+/**
+ * Walks the outline below a bookmark, or the whole outline when parentPtr is 0, in one call. Entries
+ * come depth first in display order: the entry count, then per entry its bookmark pointer, depth,
+ * title offset and length, destination page, flags and destination x, y and zoom, then the titles as
+ * one string: a char count followed by UTF-16 chars. Subtrees deeper than maxDepth levels are not walked,
+ * their root reports children that are not expanded. Bookmarks met twice in a malformed outline are
+ * skipped.
+ */
+JNI_PdfDocument(jbyteArray, PdfiumCore, nativeGetOutline)(JNI_ARGS, jlong docPtr, jlong parentPtr,
+                                                          jint maxDepth) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr || maxDepth <= 0) return nullptr;
+    TRACE_SECTION("pdfium:getOutline");
+
+    PackedWriter writer;
+    writer.putInt(0);
+    std::u16string titles;
+    int32_t count = 0;
+    std::set<FPDF_BOOKMARK> visited;
+    // Next sibling pushed before the first child, so that children are popped first
+    std::vector<std::pair<FPDF_BOOKMARK, int>> pending;
+    FPDF_BOOKMARK first = FPDFBookmark_GetFirstChild(doc->pdfDocument, reinterpret_cast<FPDF_BOOKMARK>(parentPtr));
+    if (first != nullptr) pending.emplace_back(first, 0);
+    while (!pending.empty()) {
+        const auto [bookmark, depth] = pending.back();
+        pending.pop_back();
+        if (!visited.insert(bookmark).second) continue;
+
+        FPDF_BOOKMARK sibling = FPDFBookmark_GetNextSibling(doc->pdfDocument, bookmark);
+        if (sibling != nullptr) pending.emplace_back(sibling, depth);
+        FPDF_BOOKMARK child = FPDFBookmark_GetFirstChild(doc->pdfDocument, bookmark);
+        int flags = child != nullptr ? OUTLINE_HAS_CHILDREN : 0;
+        if (child != nullptr && depth + 1 < maxDepth) {
+            pending.emplace_back(child, depth + 1);
+            flags |= OUTLINE_EXPANDED;
+        }
+
+        const std::u16string title = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+            return FPDFBookmark_GetTitle(bookmark, buffer, length);
+        });
+        int pageIndex = -1;
+        FS_FLOAT x = 0, y = 0, zoom = 0;
+        FPDF_DEST dest = getBookmarkDest(doc->pdfDocument, bookmark);
+        if (dest != nullptr) {
+            pageIndex = FPDFDest_GetDestPageIndex(doc->pdfDocument, dest);
+            flags |= getDestLocation(dest, &x, &y, &zoom);
+        }
 
-    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
-    auto parent = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
-    FPDF_BOOKMARK bookmark = FPDFBookmark_GetNextSibling(doc->pdfDocument, parent);
-    if (bookmark == nullptr) {
-        return 0;
+        writer.putLong(reinterpret_cast<int64_t>(bookmark));
+        writer.putInt(depth);
+        writer.putInt((int32_t) titles.size());
+        writer.putInt((int32_t) title.size());
+        writer.putInt(pageIndex);
+        writer.putInt(flags);
+        writer.putFloat(x);
+        writer.putFloat(y);
+        writer.putFloat(zoom);
+        titles.append(title);
+        count++;
+    }
+    memcpy(writer.bytes.data(), &count, sizeof(count));
+    writer.putString(titles);
+
+    jbyteArray result = env->NewByteArray((jsize) writer.bytes.size());
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, (jsize) writer.bytes.size(),
+                                reinterpret_cast<const jbyte *>(writer.bytes.data()));
     }
-    return reinterpret_cast<jlong>(bookmark);
+    return result;
 }
 
-JNI_PdfDocument(jlong, PdfiumCore, nativeLoadTextPage)(JNI_ARGS, jlong docPtr, jlong pagePtr) {
+/**
+ * Everything the document summary shows, in one call: the standard info dictionary entries (in the
+ * order of kInfoKeys), the page count and the label of every page, then the named destination count
+ * and per destination its name, page, DEST_HAS_ flags and x, y and zoom. Strings are a char count
+ * followed by UTF-16 chars, pages without a label have an empty one.
+ */
+JNI_PdfDocument(jbyteArray, PdfiumCore, nativeGetSummary)(JNI_ARGS, jlong docPtr) {
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
-    return loadTextPageInternal(env, doc, pagePtr);
-}
+    if (doc == nullptr) return nullptr;
+    TRACE_SECTION("pdfium:getSummary");
+    static const char *const kInfoKeys[] = {
+            "Title", "Author", "Subject", "Keywords", "Creator", "Producer", "CreationDate", "ModDate"
+    };
 
-JNI_PdfDocument(jstring, PdfiumCore, nativeGetBookmarkTitle)(JNI_ARGS, jlong bookmarkPtr) {
+    PackedWriter writer;
+    for (const char *key: kInfoKeys) {
+        writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+            return FPDF_GetMetaText(doc->pdfDocument, key, buffer, length);
+        });
+    }
 
-    auto bookmark = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
-    int bufferLen = FPDFBookmark_GetTitle(bookmark, nullptr, 0);
-    if (bufferLen <= 2) {
-        return env->NewStringUTF("");
+    const int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+    writer.putInt(pageCount);
+    for (int i = 0; i < pageCount; i++) {
+        writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+            return FPDF_GetPageLabel(doc->pdfDocument, i, buffer, length);
+        });
+    }
+
+    const int destCount = (int) FPDF_CountNamedDests(doc->pdfDocument);
+    writer.putInt(destCount);
+    for (int i = 0; i < destCount; i++) {
+        // The name length is in and out, it is -1 when the buffer is too small. The destination comes with
+        // the name, the one of the last call is kept
+        FPDF_DEST dest = nullptr;
+        writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+            long size = (long) length;
+            dest = FPDF_GetNamedDest(doc->pdfDocument, i, buffer, &size);
+            return (unsigned long) std::max(size, 0L);
+        });
+        FS_FLOAT x = 0, y = 0, zoom = 0;
+        writer.putInt(dest != nullptr ? FPDFDest_GetDestPageIndex(doc->pdfDocument, dest) : -1);
+        writer.putInt(dest != nullptr ? getDestLocation(dest, &x, &y, &zoom) : 0);
+        writer.putFloat(x);
+        writer.putFloat(y);
+        writer.putFloat(zoom);
+    }
+
+    jbyteArray result = env->NewByteArray((jsize) writer.bytes.size());
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, (jsize) writer.bytes.size(),
+                                reinterpret_cast<const jbyte *>(writer.bytes.data()));
     }
-    std::wstring title;
-    FPDFBookmark_GetTitle(bookmark, WriteInto(&title, bufferLen + 1), bufferLen);
-    return env->NewString((jchar *) title.c_str(), bufferLen / 2 - 1);
+    return result;
 }
 
-JNI_PdfDocument(jboolean, PdfiumCore, nativeSaveAsCopy)(JNI_ARGS, jlong docPtr, jobject callback,
-                                                        jint flags) {
-    jclass callbackClass = env->FindClass("com/ahmer/pdfium/PdfWriteCallback");
-    if (callback != nullptr && env->IsInstanceOf(callback, callbackClass)) {
-        //Setup the callback to Java.
-        FileWrite fw = FileWrite();
-        fw.version = 1;
-        fw.FPDF_FILEWRITE::WriteBlock = FileWrite::WriteBlockCallback;
-        fw.callbackObject = callback;
-        fw.callbackMethodID = env->GetMethodID(callbackClass, "WriteBlock", "([B)I");
-        fw.env = env;
+// Bytes of the fingerprint samples spread over the source, the whole source when it is smaller
+static const int kFingerprintSamples = 16;
+static const size_t kFingerprintSampleBytes = 4 * 1024;
 
-        auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
-        return FPDF_SaveAsCopy(doc->pdfDocument, &fw, flags);
+static bool readSource(const DocumentFile *doc, size_t offset, uint8_t *buffer, size_t size) {
+    if (doc->cDataCopy != nullptr) {
+        memcpy(buffer, doc->cDataCopy + offset, size);
+        return true;
     }
-    return false;
+    return doc->sourceFd >= 0 && pread(doc->sourceFd, buffer, size, (off_t) offset) == (ssize_t) size;
 }
 
-JNI_PdfDocument(jlong, PdfiumCore, nativeGetBookmarkDestIndex)(JNI_ARGS, jlong docPtr, jlong bookmarkPtr) {
+/**
+ * Identity of the document for cache keys, without reading it whole: the permanent and changing file
+ * identifiers, the source size, the trailer end offsets (an incremental update appends one) and a hash
+ * of evenly spread samples of the source, the first and last bytes included. Packed as both identifiers
+ * (byte count then bytes), the size, the trailer count and offsets, the content hash, then the key
+ * hashing all of it.
+ */
+JNI_PdfDocument(jbyteArray, PdfiumCore, nativeGetFingerprint)(JNI_ARGS, jlong docPtr) {
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
-    auto bookmark = reinterpret_cast<FPDF_BOOKMARK>(bookmarkPtr);
-    FPDF_DEST dest = FPDFBookmark_GetDest(doc->pdfDocument, bookmark);
-    if (dest == nullptr) {
-        return -1;
+    if (doc == nullptr || doc->sourceLength == 0) return nullptr;
+    TRACE_SECTION("pdfium:getFingerprint");
+
+    const size_t length = doc->sourceLength;
+    const size_t sampleBytes = std::min(length, kFingerprintSamples * kFingerprintSampleBytes);
+    std::vector<uint8_t> samples(sampleBytes);
+    bool isRead;
+    if (sampleBytes == length) {
+        isRead = readSource(doc, 0, samples.data(), length);
+    } else {
+        isRead = true;
+        for (int i = 0; i < kFingerprintSamples && isRead; i++) {
+            const size_t offset = (length - kFingerprintSampleBytes) * i / (kFingerprintSamples - 1);
+            isRead = readSource(doc, offset, samples.data() + i * kFingerprintSampleBytes, kFingerprintSampleBytes);
+        }
     }
-    return (jlong) FPDFDest_GetDestPageIndex(doc->pdfDocument, dest);
+    if (!isRead) {
+        LOGE("Cannot read the fingerprint samples. Error: %d", errno);
+        return nullptr;
+    }
+
+    PackedWriter writer;
+    for (FPDF_FILEIDTYPE type: {FILEIDTYPE_PERMANENT, FILEIDTYPE_CHANGING}) {
+        // Identifiers are byte strings, returned with a terminator
+        const unsigned long size = FPDF_GetFileIdentifier(doc->pdfDocument, type, nullptr, 0);
+        std::vector<uint8_t> id(size);
+        if (size > 0) FPDF_GetFileIdentifier(doc->pdfDocument, type, id.data(), size);
+        writer.putBytes(id.data(), size > 0 ? size - 1 : 0);
+    }
+    writer.putLong((int64_t) length);
+    const unsigned long trailerCount = FPDF_GetTrailerEnds(doc->pdfDocument, nullptr, 0);
+    std::vector<unsigned int> trailerEnds(trailerCount);
+    if (trailerCount > 0) FPDF_GetTrailerEnds(doc->pdfDocument, trailerEnds.data(), trailerCount);
+    writer.putInt((int32_t) trailerCount);
+    for (unsigned int end: trailerEnds) writer.putInt((int32_t) end);
+    writer.putLong((int64_t) ContentHash::hash64(samples.data(), samples.size()));
+    // The key covers everything written so far
+    writer.putLong((int64_t) ContentHash::hash64(writer.bytes.data(), writer.bytes.size(), length));
+
+    jbyteArray result = env->NewByteArray((jsize) writer.bytes.size());
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, (jsize) writer.bytes.size(),
+                                reinterpret_cast<const jbyte *>(writer.bytes.data()));
+    }
+    return result;
 }
 
 JNI_PdfDocument(jintArray, PdfiumCore, nativeGetPageCharCounts)(JNI_ARGS, jlong docPtr) {
@@ -607,36 +2058,41 @@ JNI_FUNC(jint, PdfiumCore, nativeGetPageHeightPoint)(JNI_ARGS, jlong pagePtr) {
     return (jint) FPDF_GetPageHeight(page);
 }
 
-JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jlong pagePtr, jobject bitmap,
+JNI_FUNC(jint, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jlong pagePtr, jobject bitmap,
                                                    jint startX, jint startY, jint drawSizeHor,
-                                                   jint drawSizeVer, jboolean annotation) {
+                                                   jint drawSizeVer, jboolean annotation, jboolean forms,
+                                                   jlong budgetMs) {
+    JNI_STATS_SCOPE(RENDER);
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
     auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
 
     if (page == nullptr || bitmap == nullptr) {
         LOGE("Render page pointers invalid");
-        return;
+        return RENDER_STATUS_FAILED;
     }
 
     AndroidBitmapInfo info;
     int ret;
     if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
         LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
-        return;
+        return RENDER_STATUS_FAILED;
     }
 
     int canvasHorSize = info.width;
     int canvasVerSize = info.height;
+    TRACE_SECTION("pdfium:renderPageBitmap %dx%d format=%d", canvasHorSize, canvasVerSize, info.format);
     if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 &&
-        info.format != ANDROID_BITMAP_FORMAT_RGB_565) {
-        LOGE("Bitmap format must be RGBA_8888 or RGB_565");
-        return;
+        info.format != ANDROID_BITMAP_FORMAT_RGB_565 &&
+        info.format != ANDROID_BITMAP_FORMAT_A_8) {
+        LOGE("Bitmap format must be RGBA_8888, RGB_565 or A_8");
+        return RENDER_STATUS_FAILED;
     }
+    JNI_STATS_BYTES((uint64_t) info.stride * info.height);
 
     void *addr;
     if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
         LOGE("Locking bitmap failed: %s", strerror(ret * -1));
-        return;
+        return RENDER_STATUS_FAILED;
     }
 
     void *tmp;
@@ -644,8 +2100,13 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jlong
     int sourceStride;
     if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
         tmp = malloc(canvasVerSize * canvasHorSize * sizeof(rgb));
+        MemoryTracker::track(doc, tmp, MemoryTracker::SCRATCH, canvasVerSize * canvasHorSize * sizeof(rgb));
         sourceStride = canvasHorSize * sizeof(rgb);
         format = FPDFBitmap_BGR;
+    } else if (info.format == ANDROID_BITMAP_FORMAT_A_8) {
+        tmp = addr;
+        sourceStride = info.stride;
+        format = FPDFBitmap_Gray;
     } else {
         tmp = addr;
         sourceStride = info.stride;
@@ -668,31 +2129,758 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPageBitmap)(JNI_ARGS, jlong docPtr, jlong
     form_callbacks.version = 2;
     FPDF_FORMHANDLE form;
 
-    if (annotation) {
-        form = FPDFDOC_InitFormFillEnvironment(doc->pdfDocument, &form_callbacks);
-        flags |= FPDF_ANNOT;
+    // Markup annotations are drawn with the page, form fields by FPDF_FFLDraw. Without forms the caller
+    // draws them on a separate layer, see nativeRenderAnnotationLayer(), which has the markup too
+    const bool drawForms = annotation && forms;
+    FPDF_FORMHANDLE activeForm = drawForms ? activeFormHandle(doc, page) : nullptr;
+    if (annotation) flags |= FPDF_ANNOT;
+    if (drawForms) {
+        form = activeForm != nullptr ? activeForm : FPDFDOC_InitFormFillEnvironment(doc->pdfDocument,
+                                                                                     &form_callbacks);
     }
 
     FPDFBitmap_FillRect(pdfBitmap, baseX, baseY, baseHorSize, baseVerSize, 0xFFFFFFFF); //White
-    FPDF_RenderPageBitmap(pdfBitmap, page, startX, startY, (int) drawSizeHor,
-                          (int) drawSizeVer, 0, flags);
+    int status = RENDER_STATUS_COMPLETE;
+    if (budgetMs > 0) {
+        const int64_t budgetNanos = (int64_t) budgetMs * 1000000LL;
+        RenderDeadline deadline(budgetNanos);
+        if (renderWithDeadline(pdfBitmap, page, startX, startY, (int) drawSizeHor, (int) drawSizeVer, flags,
+                               &deadline) == FPDF_RENDER_TOBECONTINUED) {
+            LOGD("Render budget of %lld ms exceeded, drawing a draft", (long long) budgetMs);
+            renderDraft(doc, pdfBitmap, format, page, startX, startY, (int) drawSizeHor, (int) drawSizeVer, flags,
+                        budgetNanos, baseX, baseY, baseX + baseHorSize, baseY + baseVerSize);
+            status = RENDER_STATUS_DRAFT;
+        }
+    } else {
+        TRACE_SECTION("pdfium:render");
+        FPDF_RenderPageBitmap(pdfBitmap, page, startX, startY, (int) drawSizeHor,
+                              (int) drawSizeVer, 0, flags);
+    }
 
-    if (annotation) {
-        FPDF_FFLDraw(form, pdfBitmap, page, startX, startY, (int) drawSizeHor,
-                     (int) drawSizeVer, 0, FPDF_ANNOT);
-        FPDFDOC_ExitFormFillEnvironment(form);
+    if (drawForms) {
+        if (status == RENDER_STATUS_COMPLETE) {
+            TRACE_SECTION("pdfium:drawForms");
+            FPDF_FFLDraw(form, pdfBitmap, page, startX, startY, (int) drawSizeHor,
+                         (int) drawSizeVer, 0, FPDF_ANNOT);
+        }
+        if (form != activeForm) FPDFDOC_ExitFormFillEnvironment(form);
     }
+    FPDFBitmap_Destroy(pdfBitmap);
 
     if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        TRACE_SECTION("pdfium:convert565");
         rgbBitmapTo565(tmp, sourceStride, addr, &info);
+        MemoryTracker::untrack(tmp);
         free(tmp);
+    } else if (info.format == ANDROID_BITMAP_FORMAT_A_8) {
+        grayBitmapToCoverage(addr, &info);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return status;
+}
+
+/**
+ * A second instance of the page with its objects removed, loaded once and closed with the page. Rendered
+ * with FPDF_ANNOT it draws only the markup annotations, read from the page dictionary on every render so
+ * edits made through the page are shown. Objects removed from an instance leave the document untouched
+ * until FPDFPage_GenerateContent(), which is never called on it.
+ */
+static FPDF_PAGE markupPage(DocumentFile *doc, FPDF_PAGE page, int pageIndex) {
+    auto found = sMarkupPages.find(page);
+    if (found != sMarkupPages.end()) return found->second.page;
+    FPDF_PAGE markup = FPDF_LoadPage(doc->pdfDocument, pageIndex);
+    if (markup == nullptr) return nullptr;
+    for (int i = FPDFPage_CountObjects(markup) - 1; i >= 0; i--) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(markup, i);
+        if (FPDFPage_RemoveObject(markup, object)) FPDFPageObj_Destroy(object);
+    }
+    MemoryTracker::track(doc, markup, MemoryTracker::PAGE, MemoryTracker::kPageBaseBytes);
+    sMarkupPages[page] = {doc, markup};
+    return markup;
+}
+
+// Whether a page has widgets, drawn by FPDF_FFLDraw, and other annotations, drawn with FPDF_ANNOT
+static void getAnnotationKinds(FPDF_PAGE page, bool *hasWidgets, bool *hasMarkup) {
+    *hasWidgets = *hasMarkup = false;
+    const int count = FPDFPage_GetAnnotCount(page);
+    for (int i = 0; i < count && !(*hasWidgets && *hasMarkup); i++) {
+        FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, i);
+        if (FPDFAnnot_GetSubtype(annot) == FPDF_ANNOT_WIDGET) {
+            *hasWidgets = true;
+        } else {
+            *hasMarkup = true;
+        }
+        FPDFPage_CloseAnnot(annot);
+    }
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeRenderAnnotationLayer)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint pageIndex,
+                                                        jobject bitmap, jint startX, jint startY, jint drawSizeHor,
+                                                        jint drawSizeVer) {
+    JNI_STATS_SCOPE(RENDER);
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+
+    if (doc == nullptr || page == nullptr || bitmap == nullptr) {
+        LOGE("Render annotation layer pointers invalid");
+        return RENDER_STATUS_FAILED;
+    }
+
+    AndroidBitmapInfo info;
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return RENDER_STATUS_FAILED;
+    }
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Annotation layer format must be RGBA_8888");
+        return RENDER_STATUS_FAILED;
+    }
+    TRACE_SECTION("pdfium:renderAnnotationLayer %dx%d", info.width, info.height);
+    JNI_STATS_BYTES((uint64_t) info.stride * info.height);
+
+    void *addr;
+    if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return RENDER_STATUS_FAILED;
+    }
+
+    // Only the annotations are drawn, over a transparent background, so the layer can be composited
+    // over page content rendered without them: markup annotations first, then the form fields
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx((int) info.width, (int) info.height, FPDFBitmap_BGRA, addr,
+                                                (int) info.stride);
+    FPDFBitmap_FillRect(pdfBitmap, 0, 0, (int) info.width, (int) info.height, 0x00000000); //Transparent
+
+    bool hasWidgets, hasMarkup;
+    getAnnotationKinds(page, &hasWidgets, &hasMarkup);
+    FPDF_PAGE markup = hasMarkup ? markupPage(doc, page, pageIndex) : nullptr;
+    if (markup != nullptr) {
+        FPDF_RenderPageBitmap(pdfBitmap, markup, startX, startY, (int) drawSizeHor, (int) drawSizeVer, 0,
+                              FPDF_ANNOT | FPDF_REVERSE_BYTE_ORDER);
+    }
+    if (hasWidgets) {
+        FPDF_FORMFILLINFO form_callbacks = {0};
+        form_callbacks.version = 2;
+        FPDF_FORMHANDLE activeForm = activeFormHandle(doc, page);
+        FPDF_FORMHANDLE form = activeForm != nullptr ? activeForm
+                                                     : FPDFDOC_InitFormFillEnvironment(doc->pdfDocument,
+                                                                                       &form_callbacks);
+        FPDF_FFLDraw(form, pdfBitmap, page, startX, startY, (int) drawSizeHor, (int) drawSizeVer, 0,
+                     FPDF_ANNOT | FPDF_REVERSE_BYTE_ORDER);
+        if (form != activeForm) FPDFDOC_ExitFormFillEnvironment(form);
+    }
+    FPDFBitmap_Destroy(pdfBitmap);
+
+    premultiplyAlpha(addr, &info);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return RENDER_STATUS_COMPLETE;
+}
+
+// Values of the touch actions, mirrored in PdfiumCore
+enum FormTouchAction {
+    FORM_TOUCH_DOWN = 0,
+    FORM_TOUCH_UP = 1,
+    FORM_TOUCH_MOVE = 2,
+};
+
+JNI_FUNC(jboolean, PdfiumCore, nativeFormTouch)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint action,
+                                                jdouble pageX, jdouble pageY) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (doc == nullptr || page == nullptr) return JNI_FALSE;
+    FPDF_FORMHANDLE form = formFillHandle(doc, page);
+    if (form == nullptr) return JNI_FALSE;
+
+    switch (action) {
+        case FORM_TOUCH_DOWN:
+            return (jboolean) FORM_OnLButtonDown(form, page, 0, pageX, pageY);
+        case FORM_TOUCH_UP:
+            return (jboolean) FORM_OnLButtonUp(form, page, 0, pageX, pageY);
+        case FORM_TOUCH_MOVE:
+            return (jboolean) FORM_OnMouseMove(form, page, 0, pageX, pageY);
+        default:
+            return JNI_FALSE;
+    }
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeFormKey)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint keyCode,
+                                              jint modifiers, jboolean isDown) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (doc == nullptr || page == nullptr || doc->formHandle == nullptr) return JNI_FALSE;
+    FPDF_FORMHANDLE form = formFillHandle(doc, page);
+    return (jboolean) (isDown ? FORM_OnKeyDown(form, page, keyCode, modifiers)
+                              : FORM_OnKeyUp(form, page, keyCode, modifiers));
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeFormChar)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint charCode,
+                                               jint modifiers) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (doc == nullptr || page == nullptr || doc->formHandle == nullptr) return JNI_FALSE;
+    return (jboolean) FORM_OnChar(formFillHandle(doc, page), page, charCode, modifiers);
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeFormKillFocus)(JNI_ARGS, jlong docPtr) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr || doc->formHandle == nullptr) return JNI_FALSE;
+    return (jboolean) FORM_ForceToKillFocus(doc->formHandle);
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeGetFocusedFormFieldType)(JNI_ARGS, jlong docPtr) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr || doc->formHandle == nullptr) return -1;
+
+    int pageIndex = -1;
+    FPDF_ANNOTATION annot = nullptr;
+    if (!FORM_GetFocusedAnnot(doc->formHandle, &pageIndex, &annot) || annot == nullptr) return -1;
+    const int type = FPDFAnnot_GetFormFieldType(doc->formHandle, annot);
+    FPDFPage_CloseAnnot(annot);
+    return type;
+}
+
+/**
+ * Returns and clears the areas repainted by the form filler since the last call, as groups of
+ * [index in pagePtrs, left, top, right, bottom]. Areas of pages missing from pagePtrs are dropped.
+ */
+JNI_FUNC(jfloatArray, PdfiumCore, nativeTakeFormDirtyRects)(JNI_ARGS, jlong docPtr, jlongArray pagePtrs) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr || doc->formDirtyRects.empty()) return env->NewFloatArray(0);
+
+    const jsize pageCount = env->GetArrayLength(pagePtrs);
+    jlong *pages = env->GetLongArrayElements(pagePtrs, nullptr);
+    std::vector<float> values;
+    values.reserve(doc->formDirtyRects.size() * 5);
+    for (const FormDirtyRect &rect: doc->formDirtyRects) {
+        const jlong *found = std::find(pages, pages + pageCount, reinterpret_cast<jlong>(rect.page));
+        if (found == pages + pageCount) continue;
+        values.insert(values.end(), {(float) (found - pages), rect.left, rect.top, rect.right, rect.bottom});
+    }
+    env->ReleaseLongArrayElements(pagePtrs, pages, JNI_ABORT);
+    doc->formDirtyRects.clear();
+
+    jfloatArray result = env->NewFloatArray((jsize) values.size());
+    if (result != nullptr && !values.empty()) {
+        env->SetFloatArrayRegion(result, 0, (jsize) values.size(), values.data());
+    }
+    return result;
+}
+
+/**
+ * Every widget of a page, or of the document when pageIndex is -1, in one buffer: the widget count,
+ * then per widget its page and annotation index, field type, field flags, checked state, rect (left,
+ * top, right, bottom), name, value, export value and options (count, then label and selected state).
+ * Strings are a char count followed by UTF-16 chars.
+ */
+JNI_FUNC(jbyteArray, PdfiumCore, nativeGetFormFields)(JNI_ARGS, jlong docPtr, jint pageIndex, jintArray openIndices,
+                                                      jlongArray openPtrs) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr) return nullptr;
+    TRACE_SECTION("pdfium:getFormFields");
+
+    FPDF_FORMFILLINFO form_callbacks = {0};
+    form_callbacks.version = 2;
+    FPDF_FORMHANDLE form = doc->formHandle != nullptr ? doc->formHandle
+                                                      : FPDFDOC_InitFormFillEnvironment(doc->pdfDocument,
+                                                                                        &form_callbacks);
+    if (form == nullptr) return nullptr;
+
+    PackedWriter writer;
+    writer.putInt(0);
+    int32_t count = 0;
+    {
+        FormPages pages(env, doc->pdfDocument, openIndices, openPtrs);
+        const int first = pageIndex >= 0 ? pageIndex : 0;
+        const int last = pageIndex >= 0 ? pageIndex : FPDF_GetPageCount(doc->pdfDocument) - 1;
+        for (int i = first; i <= last; i++) {
+            FPDF_PAGE page = pages.get(i);
+            if (page == nullptr) continue;
+            const int annotCount = FPDFPage_GetAnnotCount(page);
+            for (int j = 0; j < annotCount; j++) {
+                FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, j);
+                if (annot == nullptr) continue;
+                if (FPDFAnnot_GetSubtype(annot) != FPDF_ANNOT_WIDGET) {
+                    FPDFPage_CloseAnnot(annot);
+                    continue;
+                }
+                FS_RECTF rect = {0, 0, 0, 0};
+                FPDFAnnot_GetRect(annot, &rect);
+                writer.putInt(i);
+                writer.putInt(j);
+                writer.putInt(FPDFAnnot_GetFormFieldType(form, annot));
+                writer.putInt(FPDFAnnot_GetFormFieldFlags(form, annot));
+                writer.putInt(FPDFAnnot_IsChecked(form, annot) ? 1 : 0);
+                writer.putFloat(rect.left);
+                writer.putFloat(rect.top);
+                writer.putFloat(rect.right);
+                writer.putFloat(rect.bottom);
+                writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                    return FPDFAnnot_GetFormFieldName(form, annot, buffer, length);
+                });
+                writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                    return FPDFAnnot_GetFormFieldValue(form, annot, buffer, length);
+                });
+                writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                    return FPDFAnnot_GetFormFieldExportValue(form, annot, buffer, length);
+                });
+                const int optionCount = std::max(FPDFAnnot_GetOptionCount(form, annot), 0);
+                writer.putInt(optionCount);
+                for (int k = 0; k < optionCount; k++) {
+                    writer.putWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                        return FPDFAnnot_GetOptionLabel(form, annot, k, buffer, length);
+                    });
+                    writer.putInt(FPDFAnnot_IsOptionSelected(form, annot, k) ? 1 : 0);
+                }
+                FPDFPage_CloseAnnot(annot);
+                count++;
+            }
+        }
+    }
+    if (form != doc->formHandle) FPDFDOC_ExitFormFillEnvironment(form);
+    memcpy(writer.bytes.data(), &count, sizeof(count));
+
+    jbyteArray result = env->NewByteArray((jsize) writer.bytes.size());
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, (jsize) writer.bytes.size(),
+                                reinterpret_cast<const jbyte *>(writer.bytes.data()));
+    }
+    return result;
+}
+
+/**
+ * Sets many fields, identified by their full name, in one walk of the document. Values go through the
+ * persistent form environment like typed input, so appearances are regenerated as the fields are
+ * committed. Returns the number of names that were applied.
+ */
+JNI_FUNC(jint, PdfiumCore, nativeSetFormFieldValues)(JNI_ARGS, jlong docPtr, jintArray openIndices,
+                                                     jlongArray openPtrs, jobjectArray names,
+                                                     jobjectArray values) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr) return 0;
+    TRACE_SECTION("pdfium:setFormFieldValues");
+
+    std::map<std::u16string, std::u16string> pending;
+    const jsize valueCount = env->GetArrayLength(names);
+    for (jsize i = 0; i < valueCount; i++) {
+        auto name = (jstring) env->GetObjectArrayElement(names, i);
+        auto value = (jstring) env->GetObjectArrayElement(values, i);
+        pending[toU16String(env, name)] = toU16String(env, value);
+        env->DeleteLocalRef(name);
+        env->DeleteLocalRef(value);
+    }
+    if (pending.empty() || formFillHandle(doc, nullptr) == nullptr) return 0;
+
+    std::set<std::u16string> applied;
+    {
+        FormPages pages(env, doc->pdfDocument, openIndices, openPtrs);
+        const int pageCount = FPDF_GetPageCount(doc->pdfDocument);
+        for (int i = 0; i < pageCount && applied.size() < pending.size(); i++) {
+            FPDF_PAGE page = pages.get(i);
+            if (page == nullptr || FPDFPage_GetAnnotCount(page) == 0) continue;
+            FPDF_FORMHANDLE form = formFillHandle(doc, page);
+            const int annotCount = FPDFPage_GetAnnotCount(page);
+            for (int j = 0; j < annotCount; j++) {
+                FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, j);
+                if (annot == nullptr) continue;
+                if (FPDFAnnot_GetSubtype(annot) == FPDF_ANNOT_WIDGET) {
+                    const std::u16string name = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                        return FPDFAnnot_GetFormFieldName(form, annot, buffer, length);
+                    });
+                    auto value = pending.find(name);
+                    if (value != pending.end() && setFormFieldValue(form, page, annot, value->second)) {
+                        applied.insert(name);
+                    }
+                }
+                FPDFPage_CloseAnnot(annot);
+            }
+            // Commits the last field of the page before the next get() closes a loaded page
+            FORM_ForceToKillFocus(form);
+        }
+    }
+    // Callers refresh the pages they show, the repainted areas of a bulk update are not tracked
+    doc->formDirtyRects.clear();
+    return (jint) applied.size();
+}
+
+/**
+ * Rects of the annotations drawn by nativeRenderAnnotationLayer(), hidden ones excluded, as left, top,
+ * right and bottom in page coordinates
+ */
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetAnnotationLayerRects)(JNI_ARGS, jlong pagePtr) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr) return env->NewFloatArray(0);
+    const int count = FPDFPage_GetAnnotCount(page);
+    std::vector<float> values;
+    values.reserve((size_t) std::max(0, count) * 4);
+    for (int i = 0; i < count; i++) {
+        FPDF_ANNOTATION annot = FPDFPage_GetAnnot(page, i);
+        FS_RECTF rect;
+        if ((FPDFAnnot_GetFlags(annot) & FPDF_ANNOT_FLAG_HIDDEN) == 0 && FPDFAnnot_GetRect(annot, &rect)) {
+            values.insert(values.end(), {rect.left, rect.top, rect.right, rect.bottom});
+        }
+        FPDFPage_CloseAnnot(annot);
+    }
+
+    jfloatArray result = env->NewFloatArray((jsize) values.size());
+    if (result != nullptr && !values.empty()) {
+        env->SetFloatArrayRegion(result, 0, (jsize) values.size(), values.data());
+    }
+    return result;
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeIsTagged)(JNI_ARGS, jlong docPtr) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr) return JNI_FALSE;
+    return (jboolean) FPDFCatalog_IsTagged(doc->pdfDocument);
+}
+
+/**
+ * Reading order blocks of a tagged page in one buffer: the block count, then per block its kind,
+ * heading level, rect (left, top, right, bottom), font size, font weight, text and alternate text.
+ * Strings are a char count followed by UTF-16 chars. Returns null when the page has no structure tree.
+ */
+JNI_FUNC(jbyteArray, PdfiumCore, nativeGetReflowBlocks)(JNI_ARGS, jlong pagePtr) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr) return nullptr;
+    TRACE_SECTION("pdfium:getReflowBlocks");
+
+    FPDF_STRUCTTREE tree = FPDF_StructTree_GetForPage(page);
+    if (tree == nullptr) return nullptr;
+    std::vector<ReflowBlock> blocks;
+    const int rootCount = FPDF_StructTree_CountChildren(tree);
+    for (int i = 0; i < rootCount; i++) {
+        FPDF_STRUCTELEMENT element = FPDF_StructTree_GetChildAtIndex(tree, i);
+        if (element != nullptr) walkReflow(element, blocks);
+    }
+    FPDF_StructTree_Close(tree);
+    if (blocks.empty()) return nullptr;
+
+    // Page objects by marked content, artifacts like running headers have none and are left out
+    std::map<int, std::vector<FPDF_PAGEOBJECT>> objects;
+    const int objectCount = FPDFPage_CountObjects(page);
+    for (int i = 0; i < objectCount; i++) {
+        FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+        const int mcid = FPDFPageObj_GetMarkedContentID(object);
+        if (mcid >= 0) objects[mcid].push_back(object);
+    }
+    FPDF_TEXTPAGE textPage = FPDFText_LoadPage(page);
+
+    PackedWriter writer;
+    writer.putInt(0);
+    int32_t count = 0;
+    for (const ReflowBlock &block: blocks) {
+        std::u16string text;
+        FS_RECTF bounds = {0, 0, 0, 0};
+        FS_RECTF previous = {0, 0, 0, 0};
+        bool hasBounds = false;
+        float fontSize = 0;
+        float sizeWeight = 0;
+        int fontWeight = 0;
+        for (int mcid: block.mcids) {
+            auto found = objects.find(mcid);
+            if (found == objects.end()) continue;
+            for (FPDF_PAGEOBJECT object: found->second) {
+                FS_RECTF rect;
+                if (!FPDFPageObj_GetBounds(object, &rect.left, &rect.bottom, &rect.right, &rect.top)) continue;
+                if (hasBounds) {
+                    bounds.left = std::min(bounds.left, rect.left);
+                    bounds.bottom = std::min(bounds.bottom, rect.bottom);
+                    bounds.right = std::max(bounds.right, rect.right);
+                    bounds.top = std::max(bounds.top, rect.top);
+                } else {
+                    bounds = rect;
+                    hasBounds = true;
+                }
+                if (block.kind == REFLOW_FIGURE || FPDFPageObj_GetType(object) != FPDF_PAGEOBJ_TEXT) continue;
+
+                const std::u16string run = getWideString([&](FPDF_WCHAR *buffer, unsigned long length) {
+                    return FPDFTextObj_GetText(object, textPage, buffer, length);
+                });
+                // The size on screen, the font size is scaled by the text matrix
+                float size = 0;
+                FS_MATRIX matrix;
+                if (FPDFTextObj_GetFontSize(object, &size) && FPDFPageObj_GetMatrix(object, &matrix)) {
+                    size *= std::sqrt(matrix.c * matrix.c + matrix.d * matrix.d);
+                }
+                appendReflowText(text, run, rect, previous, size);
+                previous = rect;
+                // Averaged over the characters, a bold lead-in does not make a paragraph bold
+                fontSize += size * run.size();
+                sizeWeight += run.size();
+                if (fontWeight == 0) fontWeight = FPDFFont_GetWeight(FPDFTextObj_GetFont(object));
+            }
+        }
+        if (!block.actualText.empty()) text = block.actualText;
+        if (!hasBounds && text.empty()) continue;
+
+        writer.putInt(block.kind);
+        writer.putInt(block.level);
+        writer.putFloat(bounds.left);
+        writer.putFloat(bounds.top);
+        writer.putFloat(bounds.right);
+        writer.putFloat(bounds.bottom);
+        writer.putFloat(sizeWeight > 0 ? fontSize / sizeWeight : 0);
+        writer.putInt(std::max(fontWeight, 0));
+        writer.putString(text);
+        writer.putString(block.altText);
+        count++;
+    }
+    if (textPage != nullptr) FPDFText_ClosePage(textPage);
+    memcpy(writer.bytes.data(), &count, sizeof(count));
+
+    jbyteArray result = env->NewByteArray((jsize) writer.bytes.size());
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, (jsize) writer.bytes.size(),
+                                reinterpret_cast<const jbyte *>(writer.bytes.data()));
+    }
+    return result;
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeOpenBandForm)(JNI_ARGS, jlong docPtr, jlong pagePtr) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (doc == nullptr || page == nullptr) return 0;
+    auto *form = new BandForm();
+    form->info.version = 2;
+    form->handle = activeFormHandle(doc, page);
+    if (form->handle == nullptr) {
+        // PDFium keeps the callbacks for the lifetime of the environment, they live with it
+        form->handle = FPDFDOC_InitFormFillEnvironment(doc->pdfDocument, &form->info);
+        form->isOwned = true;
+    }
+    if (form->handle == nullptr) {
+        delete form;
+        return 0;
+    }
+    return reinterpret_cast<jlong>(form);
+}
+
+JNI_FUNC(void, PdfiumCore, nativeCloseBandForm)(JNI_ARGS, jlong formPtr) {
+    auto *form = reinterpret_cast<BandForm *>(formPtr);
+    if (form == nullptr) return;
+    if (form->isOwned) FPDFDOC_ExitFormFillEnvironment(form->handle);
+    delete form;
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeRenderPageBand)(JNI_ARGS, jlong pagePtr, jlong formPtr, jobject bitmap,
+                                                 jint pageHeight, jint bandTop, jint bandHeight,
+                                                 jboolean annotation) {
+    JNI_STATS_SCOPE(RENDER);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    auto *form = reinterpret_cast<BandForm *>(formPtr);
+
+    if (page == nullptr || bitmap == nullptr) {
+        LOGE("Render band pointers invalid");
+        return RENDER_STATUS_FAILED;
+    }
+
+    AndroidBitmapInfo info;
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return RENDER_STATUS_FAILED;
+    }
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Band bitmap format must be RGBA_8888");
+        return RENDER_STATUS_FAILED;
+    }
+    int pageWidth = (int) info.width;
+    int rows = bandHeight < (int) info.height ? (int) bandHeight : (int) info.height;
+    float pointWidth = FPDF_GetPageWidthF(page);
+    float pointHeight = FPDF_GetPageHeightF(page);
+    if (rows <= 0 || pageHeight <= 0 || pointWidth <= 0 || pointHeight <= 0) {
+        LOGE("Render band size invalid");
+        return RENDER_STATUS_FAILED;
+    }
+    TRACE_SECTION("pdfium:renderBand %dx%d top=%d", pageWidth, rows, bandTop);
+    JNI_STATS_BYTES((uint64_t) info.stride * rows);
+
+    void *addr;
+    if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return RENDER_STATUS_FAILED;
+    }
+
+    // The strip only covers the rows of the band: the matrix scales the page to its full pixel size and
+    // moves the band to the top of the strip, the clip keeps PDFium from rasterizing anything outside it
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(pageWidth, rows, FPDFBitmap_BGRA, addr, (int) info.stride);
+    FPDFBitmap_FillRect(pdfBitmap, 0, 0, pageWidth, rows, 0xFFFFFFFF); //White
+    const FS_MATRIX matrix = {pageWidth / pointWidth, 0, 0, pageHeight / pointHeight, 0, (float) -bandTop};
+    const FS_RECTF clip = {0, 0, (float) pageWidth, (float) rows};
+    int flags = FPDF_REVERSE_BYTE_ORDER;
+    if (annotation) flags |= FPDF_ANNOT;
+
+    {
+        TRACE_SECTION("pdfium:render");
+        FPDF_RenderPageBitmapWithMatrix(pdfBitmap, page, &matrix, &clip, flags);
+    }
+
+    if (annotation && form != nullptr) {
+        TRACE_SECTION("pdfium:drawForms");
+        FPDF_FFLDraw(form->handle, pdfBitmap, page, 0, -bandTop, pageWidth, pageHeight, 0,
+                     FPDF_ANNOT | FPDF_REVERSE_BYTE_ORDER);
+    }
+    FPDFBitmap_Destroy(pdfBitmap);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return RENDER_STATUS_COMPLETE;
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeRenderOverviewSheet)(JNI_ARGS, jlong docPtr, jint firstPage, jint columns,
+                                                      jint rows, jobject bitmap) {
+    JNI_STATS_SCOPE(RENDER);
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr || bitmap == nullptr || columns <= 0 || rows <= 0) return RENDER_STATUS_FAILED;
+
+    AndroidBitmapInfo info;
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return RENDER_STATUS_FAILED;
+    }
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Overview bitmap format must be RGBA_8888");
+        return RENDER_STATUS_FAILED;
+    }
+    TRACE_SECTION("pdfium:renderOverviewSheet %dx%d pages=%dx%d", info.width, info.height, columns, rows);
+
+    // One sheet point per bitmap pixel
+    FPDF_DOCUMENT sheet = createOverviewSheet(doc->pdfDocument, firstPage, columns, rows, (float) info.width,
+                                              (float) info.height);
+    FPDF_PAGE page = sheet != nullptr ? FPDF_LoadPage(sheet, 0) : nullptr;
+    if (page == nullptr) {
+        if (sheet != nullptr) FPDF_CloseDocument(sheet);
+        LOGE("Cannot build overview sheet");
+        return RENDER_STATUS_FAILED;
     }
+
+    void *addr;
+    if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        FPDF_ClosePage(page);
+        FPDF_CloseDocument(sheet);
+        return RENDER_STATUS_FAILED;
+    }
+    JNI_STATS_BYTES((uint64_t) info.stride * info.height);
+    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx((int) info.width, (int) info.height, FPDFBitmap_BGRA, addr,
+                                                (int) info.stride);
+    FPDFBitmap_FillRect(pdfBitmap, 0, 0, (int) info.width, (int) info.height, 0xFFFFFFFF); //White
+    {
+        TRACE_SECTION("pdfium:render");
+        FPDF_RenderPageBitmap(pdfBitmap, page, 0, 0, (int) info.width, (int) info.height, 0,
+                              FPDF_REVERSE_BYTE_ORDER);
+    }
+    FPDFBitmap_Destroy(pdfBitmap);
     AndroidBitmap_unlockPixels(env, bitmap);
+    FPDF_ClosePage(page);
+    FPDF_CloseDocument(sheet);
+    return RENDER_STATUS_COMPLETE;
+}
+
+JNI_FUNC(jdoubleArray, PdfiumCore, nativeGetPageImages)(JNI_ARGS, jlong pagePtr, jint minWidth, jint minHeight) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    std::vector<jdouble> values;
+    if (page != nullptr) {
+        TRACE_SECTION("pdfium:getPageImages");
+        const int count = FPDFPage_CountObjects(page);
+        for (int i = 0; i < count; i++) {
+            FPDF_PAGEOBJECT object = getImageObject(page, i);
+            FPDF_IMAGEOBJ_METADATA metadata;
+            if (object == nullptr || !FPDFImageObj_GetImageMetadata(object, page, &metadata)) continue;
+            if ((int) metadata.width < minWidth || (int) metadata.height < minHeight) continue;
+            float left = 0, bottom = 0, right = 0, top = 0;
+            FPDFPageObj_GetBounds(object, &left, &bottom, &right, &top);
+            const jdouble info[kImageInfoSize] = {
+                    (jdouble) i, (jdouble) metadata.width, (jdouble) metadata.height,
+                    (jdouble) metadata.bits_per_pixel, (jdouble) metadata.colorspace,
+                    (jdouble) FPDFImageObj_GetImageDataRaw(object, nullptr, 0), left, bottom, right, top
+            };
+            values.insert(values.end(), info, info + kImageInfoSize);
+        }
+    }
+    jdoubleArray result = env->NewDoubleArray((jsize) values.size());
+    if (result != nullptr && !values.empty()) {
+        env->SetDoubleArrayRegion(result, 0, (jsize) values.size(), values.data());
+    }
+    return result;
+}
+
+JNI_FUNC(jstring, PdfiumCore, nativeGetImageFilters)(JNI_ARGS, jlong pagePtr, jint objectIndex) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGEOBJECT object = page != nullptr ? getImageObject(page, objectIndex) : nullptr;
+    if (object == nullptr) return nullptr;
+    std::string filters;
+    char name[64];
+    const int count = FPDFImageObj_GetImageFilterCount(object);
+    for (int i = 0; i < count; i++) {
+        const unsigned long length = FPDFImageObj_GetImageFilter(object, i, name, sizeof(name));
+        if (length == 0 || length > sizeof(name)) continue;
+        if (!filters.empty()) filters += ',';
+        filters += name;
+    }
+    return env->NewStringUTF(filters.c_str());
+}
+
+JNI_FUNC(jlong, PdfiumCore, nativeWriteImageRaw)(JNI_ARGS, jlong docPtr, jlong pagePtr, jint objectIndex,
+                                                jint outputFd) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGEOBJECT object = page != nullptr ? getImageObject(page, objectIndex) : nullptr;
+    const unsigned long size = object != nullptr ? FPDFImageObj_GetImageDataRaw(object, nullptr, 0) : 0;
+    if (size == 0) return -1;
+    TRACE_SECTION("pdfium:writeImageRaw %lu bytes", size);
+    void *data = malloc(size);
+    if (data == nullptr) return -1;
+    MemoryTracker::track(reinterpret_cast<const void *>(docPtr), data, MemoryTracker::SCRATCH, size);
+    FPDFImageObj_GetImageDataRaw(object, data, size);
+    const bool written = writeFd(outputFd, static_cast<const char *>(data), size);
+    MemoryTracker::untrack(data);
+    free(data);
+    return written ? (jlong) size : -1;
+}
+
+JNI_FUNC(jbyteArray, PdfiumCore, nativeGetImageRaw)(JNI_ARGS, jlong pagePtr, jint objectIndex) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGEOBJECT object = page != nullptr ? getImageObject(page, objectIndex) : nullptr;
+    const unsigned long size = object != nullptr ? FPDFImageObj_GetImageDataRaw(object, nullptr, 0) : 0;
+    if (size == 0) return nullptr;
+    std::vector<uint8_t> bytes(size);
+    if (FPDFImageObj_GetImageDataRaw(object, bytes.data(), size) != size) return nullptr;
+    jbyteArray result = env->NewByteArray((jsize) size);
+    if (result == nullptr) return nullptr;
+    env->SetByteArrayRegion(result, 0, (jsize) size, reinterpret_cast<const jbyte *>(bytes.data()));
+    return result;
+}
+
+JNI_FUNC(jboolean, PdfiumCore, nativeGetImageBitmap)(JNI_ARGS, jlong pagePtr, jint objectIndex, jobject bitmap,
+                                                     jint sampleSize) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    FPDF_PAGEOBJECT object = page != nullptr ? getImageObject(page, objectIndex) : nullptr;
+    if (object == nullptr || bitmap == nullptr) return false;
+
+    AndroidBitmapInfo info;
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0 || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Image bitmap must be RGBA_8888");
+        return false;
+    }
+    TRACE_SECTION("pdfium:getImageBitmap %dx%d", info.width, info.height);
+    FPDF_BITMAP decoded = FPDFImageObj_GetBitmap(object);
+    if (decoded == nullptr) return false;
+    void *addr;
+    bool copied = false;
+    if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) == 0) {
+        copied = copyToRgba(decoded, addr, &info, sampleSize);
+        AndroidBitmap_unlockPixels(env, bitmap);
+    } else {
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+    }
+    FPDFBitmap_Destroy(decoded);
+    return (jboolean) copied;
 }
 
 JNI_FUNC(void, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject objSurface, jint startX,
                                              jint startY, jint drawSizeHor, jint drawSizeVer,
                                              jboolean annotation) {
+    JNI_STATS_SCOPE(RENDER);
     ANativeWindow *nativeWindow = ANativeWindow_fromSurface(env, objSurface);
     if (nativeWindow == nullptr) {
         LOGE("native window pointer null");
@@ -719,7 +2907,9 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject ob
         LOGE("Locking native window failed: %s", strerror(ret * -1));
         return;
     }
+    JNI_STATS_BYTES((uint64_t) buffer.stride * buffer.height * 4);
 
+    TRACE_SECTION("pdfium:renderSurface %dx%d", buffer.width, buffer.height);
     renderPageInternal(page, &buffer, (int) startX, (int) startY,
                        buffer.width, buffer.height, (int) drawSizeHor,
                        (int) drawSizeVer, (bool) annotation);
@@ -728,6 +2918,64 @@ JNI_FUNC(void, PdfiumCore, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject ob
     ANativeWindow_release(nativeWindow);
 }
 
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetPageContentBounds)(JNI_ARGS, jlong docPtr, jint pageIndex) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr) {
+        LOGE("Document is null");
+        jniThrowException(env, "java/lang/IllegalStateException", "Document is null");
+        return nullptr;
+    }
+    float bounds[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, pageIndex);
+    if (page != nullptr) {
+        getContentBounds(page, bounds);
+        FPDF_ClosePage(page);
+    }
+    jfloatArray result = env->NewFloatArray(4);
+    if (result != nullptr) env->SetFloatArrayRegion(result, 0, 4, bounds);
+    return result;
+}
+
+JNI_FUNC(jfloatArray, PdfiumCore, nativeGetScanImage)(JNI_ARGS, jlong pagePtr) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    float scan[5];
+    if (page == nullptr || !getScanImage(page, scan)) return nullptr;
+    jfloatArray result = env->NewFloatArray(5);
+    if (result != nullptr) env->SetFloatArrayRegion(result, 0, 5, scan);
+    return result;
+}
+
+JNI_FUNC(jlongArray, PdfiumCore, nativeGetPageComplexity)(JNI_ARGS, jlong docPtr, jint pageIndex) {
+    auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
+    if (doc == nullptr) {
+        LOGE("Document is null");
+        jniThrowException(env, "java/lang/IllegalStateException", "Document is null");
+        return nullptr;
+    }
+    jlong counters[COMPLEXITY_FIELD_COUNT] = {0};
+    FPDF_PAGE page = FPDF_LoadPage(doc->pdfDocument, pageIndex);
+    if (page != nullptr) {
+        const int count = FPDFPage_CountObjects(page);
+        for (int i = 0; i < count; i++) {
+            FPDF_PAGEOBJECT object = FPDFPage_GetObject(page, i);
+            if (object != nullptr) addObjectComplexity(object, counters, 0);
+        }
+        FPDF_ClosePage(page);
+    }
+    jlongArray result = env->NewLongArray(COMPLEXITY_FIELD_COUNT);
+    if (result != nullptr) env->SetLongArrayRegion(result, 0, COMPLEXITY_FIELD_COUNT, counters);
+    return result;
+}
+
+JNI_FUNC(jint, PdfiumCore, nativeGetPageColorClass)(JNI_ARGS, jlong pagePtr, jboolean annotation) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr) {
+        LOGE("Page is null");
+        return PAGE_COLOR_TRANSPARENT;
+    }
+    return getPageColorClass(page, (bool) annotation);
+}
+
 JNI_FUNC(jobject, PdfiumCore, nativeGetPageSizeByIndex)(JNI_ARGS, jlong docPtr, jint pageIndex, jint dpi) {
     auto *doc = reinterpret_cast<DocumentFile *>(docPtr);
     if (doc == nullptr) {
@@ -920,10 +3168,12 @@ JNI_PdfTextPage(jint, PdfiumCore, nativeTextCountChars)(JNI_ARGS, jlong textPage
 
 JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetText)(JNI_ARGS, jlong textPagePtr, jint startIndex, jint count,
                                                      jshortArray result) {
+    JNI_STATS_SCOPE(TEXT_EXTRACT);
     auto textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
     jboolean isCopy = 1;
     auto *arr = (unsigned short *) env->GetShortArrayElements(result, &isCopy);
     jint output = (jint) FPDFText_GetText(textPage, (int) startIndex, (int) count, arr);
+    JNI_STATS_BYTES(output * sizeof(unsigned short));
     if (isCopy) {
         env->SetShortArrayRegion(result, 0, output, (jshort *) arr);
         env->ReleaseShortArrayElements(result, (jshort *) arr, JNI_ABORT);
@@ -933,6 +3183,7 @@ JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetText)(JNI_ARGS, jlong textPagePtr
 
 JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetTextByteArray)(JNI_ARGS, jlong textPagePtr, jint startIndex,
                                                               jint count, jbyteArray result) {
+    JNI_STATS_SCOPE(TEXT_EXTRACT);
     auto textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
     jboolean isCopy = JNI_FALSE;
     jbyte *arr = env->GetByteArrayElements(result, &isCopy);
@@ -945,6 +3196,7 @@ JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetTextByteArray)(JNI_ARGS, jlong te
     jint output = static_cast<jint>(FPDFText_GetText(textPage, static_cast<int>(startIndex),
                                                      static_cast<int>(count), buffer.data()));
     memcpy(arr, buffer.data(), count * sizeof(unsigned short));
+    JNI_STATS_BYTES(count * sizeof(unsigned short));
 
     if (isCopy) {
         // If it was a copy, update the Java array and discard the native copy
@@ -1015,6 +3267,7 @@ JNI_PdfTextPage(jdoubleArray, PdfiumCore, nativeTextGetRect)(JNI_ARGS, jlong tex
 JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetBoundedText)(JNI_ARGS, jlong textPagePtr, jdouble left,
                                                             jdouble top, jdouble right, jdouble bottom,
                                                             jshortArray arr) {
+    JNI_STATS_SCOPE(TEXT_EXTRACT);
     auto textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
     jboolean isCopy = 0;
     unsigned short *buffer = nullptr;
@@ -1025,6 +3278,7 @@ JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetBoundedText)(JNI_ARGS, jlong text
     }
     jint output = (jint) FPDFText_GetBoundedText(textPage, (double) left, (double) top,
                                                  (double) right, (double) bottom, buffer, bufLen);
+    JNI_STATS_BYTES(output * sizeof(unsigned short));
     if (isCopy) {
         env->SetShortArrayRegion(arr, 0, output, (jshort *) buffer);
         env->ReleaseShortArrayElements(arr, (jshort *) buffer, JNI_ABORT);
@@ -1034,6 +3288,7 @@ JNI_PdfTextPage(jint, PdfiumCore, nativeTextGetBoundedText)(JNI_ARGS, jlong text
 
 JNI_PdfTextPage(jlong, PdfiumCore, nativeFindStart)(JNI_ARGS, jlong textPagePtr, jstring findWhat, jint flags,
                                                     jint startIndex) {
+    JNI_STATS_SCOPE(SEARCH);
     auto textPage = reinterpret_cast<FPDF_TEXTPAGE>(textPagePtr);
 
     const jchar *raw = env->GetStringChars(findWhat, nullptr);
@@ -1047,6 +3302,8 @@ JNI_PdfTextPage(jlong, PdfiumCore, nativeFindStart)(JNI_ARGS, jlong textPagePtr,
 
     auto handle = FPDFText_FindStart(textPage, (FPDF_WIDESTRING) result.c_str(), flags,
                                      startIndex);
+    MemoryTracker::track(MemoryTracker::ownerOf(textPage), handle, MemoryTracker::SEARCH,
+                         MemoryTracker::kSearchBaseBytes + len * sizeof(jchar));
 
     env->ReleaseStringChars(findWhat, raw);
 
@@ -1109,12 +3366,14 @@ JNI_PdfTextPage(jdoubleArray, PdfiumCore, nativeTextGetRects)(JNI_ARGS, jlong pa
 }
 
 JNI_FindResult(jlong, PdfiumCore, nativeFindNext)(JNI_ARGS, jlong findHandle) {
+    JNI_STATS_SCOPE(SEARCH);
     auto handle = reinterpret_cast<FPDF_SCHHANDLE>(findHandle);
     auto result = FPDFText_FindNext(handle);
     return result;
 }
 
 JNI_FindResult(jlong, PdfiumCore, nativeFindPrev)(JNI_ARGS, jlong findHandle) {
+    JNI_STATS_SCOPE(SEARCH);
     auto handle = reinterpret_cast<FPDF_SCHHANDLE>(findHandle);
     auto result = FPDFText_FindPrev(handle);
     return result;
@@ -1134,6 +3393,7 @@ JNI_FindResult(jlong, PdfiumCore, nativeGetSchCount)(JNI_ARGS, jlong findHandle)
 
 JNI_FindResult(void, PdfiumCore, nativeCloseFind)(JNI_ARGS, jlong findHandle) {
     auto handle = reinterpret_cast<FPDF_SCHHANDLE>(findHandle);
+    MemoryTracker::untrack(handle);
     FPDFText_FindClose(handle);
 }
 
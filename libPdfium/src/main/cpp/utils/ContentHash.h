@@ -0,0 +1,20 @@
+#ifndef _CONTENT_HASH_H_
+#define _CONTENT_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fast non-cryptographic 64-bit hash for cache keys, in the style of XXH3: eight independent 64-bit
+ * lanes each take a 32x32->64 multiply of the input mixed with a key, so the stripe loop compiles to
+ * NEON (umlal) on ARM and to SSE2 (pmuludq) on x86. Results are stable across ABIs, inputs are read
+ * as little-endian, which every Android ABI is.
+ *
+ * Not compatible with XXH3 and not suitable against adversarial input.
+ */
+namespace ContentHash {
+
+    uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
+}
+
+#endif
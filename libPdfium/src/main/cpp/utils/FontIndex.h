@@ -0,0 +1,29 @@
+#ifndef _FONT_INDEX_H_
+#define _FONT_INDEX_H_
+
+#include <fpdf_sysfontinfo.h>
+#include <string>
+
+/*
+ * Compact index of the fonts installed under /system/fonts (family, charsets, weight, path).
+ *
+ * The index is built once per fonts directory revision and persisted to the app cache,
+ * so PDFium no longer has to walk and parse every system font before the first render of a
+ * document using non-embedded fonts. Font data is served straight from mmap'd font files.
+ */
+namespace FontIndex {
+
+    // Directory used to persist the index across process starts. May be called at any time,
+    // the index itself is only loaded the first time PDFium asks for a font.
+    void setCacheDir(const std::string &cacheDir);
+
+    // Loads the index from the cache, or scans the fonts directory when the cache is stale.
+    // Returns the number of indexed faces.
+    size_t ensureLoaded();
+
+    // Creates a FPDF_SYSFONTINFO backed by the index. Ownership passes to PDFium,
+    // which calls Release() from FPDF_DestroyLibrary().
+    FPDF_SYSFONTINFO *createSystemFontInfo();
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _JNI_STATS_H_
+#define _JNI_STATS_H_
+
+#include <stdint.h>
+
+/*
+ * Performance counters of the JNI entry points: calls, total and max latency, bytes moved.
+ *
+ * Only compiled in when PDFIUM_JNI_STATS is defined (CMake option of the same name, on for
+ * debug builds). Otherwise the macros below expand to nothing and snapshot() reports
+ * that no counters are available.
+ */
+namespace JniStats {
+
+    // Counter groups, in the order of the snapshot returned to Java (see PdfiumCore.getStats()).
+    enum Counter {
+        OPEN = 0,
+        LOAD_PAGE,
+        RENDER,
+        LOAD_TEXT,
+        TEXT_EXTRACT,
+        SEARCH,
+        SAVE,
+        COUNTER_COUNT
+    };
+
+    // Values per counter in a snapshot: calls, total nanos, max nanos, bytes.
+    const int kValuesPerCounter = 4;
+
+    // Whether the counters are compiled in.
+    bool isEnabled();
+
+    void record(Counter counter, uint64_t nanos, uint64_t bytes);
+
+    // Fills |out| with COUNTER_COUNT * kValuesPerCounter values. Returns false when disabled.
+    bool snapshot(int64_t *out);
+
+    void reset();
+
+    uint64_t nowNanos();
+
+    // Times the enclosing scope and records it, with the bytes added meanwhile, on exit.
+    class Scope {
+    public:
+        explicit Scope(Counter counter) : counter_(counter), start_(nowNanos()) {}
+
+        ~Scope() { record(counter_, nowNanos() - start_, bytes_); }
+
+        void addBytes(uint64_t bytes) { bytes_ += bytes; }
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        const Counter counter_;
+        const uint64_t start_;
+        uint64_t bytes_ = 0;
+    };
+}
+
+#ifdef PDFIUM_JNI_STATS
+#define JNI_STATS_SCOPE(counter) JniStats::Scope jniStatsScope(JniStats::counter)
+#define JNI_STATS_BYTES(bytes) jniStatsScope.addBytes((uint64_t) (bytes))
+#else
+#define JNI_STATS_SCOPE(counter) ((void) 0)
+#define JNI_STATS_BYTES(bytes) ((void) 0)
+#endif
+
+#endif
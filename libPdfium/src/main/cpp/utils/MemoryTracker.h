@@ -0,0 +1,53 @@
+#ifndef _MEMORY_TRACKER_H_
+#define _MEMORY_TRACKER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Accounting of the native memory held on behalf of each document: the in-memory source buffer,
+ * open pages, text pages, search handles and render scratch buffers.
+ *
+ * Buffers allocated by this library are counted exactly. Objects owned by PDFium (pages, text pages,
+ * search handles) are counted with size estimates derived from their content, as PDFium does not
+ * report its own allocations. Owners are opaque pointers (the DocumentFile), handles are the
+ * pointers handed to Java.
+ */
+namespace MemoryTracker {
+
+    // Allocation kinds, in the order of the snapshot returned to Java (see NativeMemoryUsage.kt).
+    enum Kind {
+        SOURCE = 0,
+        PAGE,
+        TEXT_PAGE,
+        SEARCH,
+        SCRATCH,
+        KIND_COUNT
+    };
+
+    // Snapshot layout: bytes per kind, live handles per kind, then total and high-water bytes.
+    const int kSnapshotSize = KIND_COUNT * 2 + 2;
+
+    // Estimates for PDFium-owned objects.
+    const size_t kPageBaseBytes = 16 * 1024;
+    const size_t kPageObjectBytes = 320;
+    const size_t kTextPageBaseBytes = 4 * 1024;
+    const size_t kTextCharBytes = 96;
+    const size_t kSearchBaseBytes = 2 * 1024;
+
+    void track(const void *owner, const void *handle, Kind kind, size_t bytes);
+
+    // Releases what was tracked under |handle|, if anything.
+    void untrack(const void *handle);
+
+    // Owner of a tracked handle, or nullptr.
+    const void *ownerOf(const void *handle);
+
+    // Releases every handle of |owner| and forgets it; called when the document is closed.
+    void releaseOwner(const void *owner);
+
+    // Fills |out| with kSnapshotSize values for |owner|, or for all owners when nullptr.
+    void snapshot(const void *owner, int64_t *out);
+}
+
+#endif
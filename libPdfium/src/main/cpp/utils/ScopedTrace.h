@@ -0,0 +1,41 @@
+#ifndef _SCOPED_TRACE_H_
+#define _SCOPED_TRACE_H_
+
+#include <android/trace.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+/*
+ * Systrace / Perfetto section covering the enclosing scope. The name is only formatted
+ * while a trace is being captured, so idle sections cost a single ATrace_isEnabled() call.
+ */
+class ScopedTrace {
+public:
+    explicit ScopedTrace(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        enabled_ = ATrace_isEnabled();
+        if (!enabled_) return;
+        char name[128];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(name, sizeof(name), format, args);
+        va_end(args);
+        ATrace_beginSection(name);
+    }
+
+    ~ScopedTrace() {
+        if (enabled_) ATrace_endSection();
+    }
+
+    ScopedTrace(const ScopedTrace &) = delete;
+
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+private:
+    bool enabled_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SECTION(...) ScopedTrace TRACE_CONCAT(scopedTrace, __LINE__)(__VA_ARGS__)
+
+#endif
@@ -19,7 +19,7 @@ class FindResult(
      * @see nativeFindNext
      */
     fun findNext(): Boolean {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return nativeFindNext(findHandle = handle)
         }
     }
@@ -32,7 +32,7 @@ class FindResult(
      * @see nativeFindPrev
      */
     fun findPrev(): Boolean {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return nativeFindPrev(findHandle = handle)
         }
     }
@@ -45,7 +45,7 @@ class FindResult(
      * @see nativeGetSchResultIndex
      */
     fun getSchResultIndex(): Int {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return nativeGetSchResultIndex(findHandle = handle)
         }
     }
@@ -58,7 +58,7 @@ class FindResult(
      * @see nativeGetSchCount
      */
     fun getSchCount(): Int {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return nativeGetSchCount(findHandle = handle)
         }
     }
@@ -71,7 +71,7 @@ class FindResult(
      */
 
     fun closeFind() {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeCloseFind(findHandle = handle)
         }
     }
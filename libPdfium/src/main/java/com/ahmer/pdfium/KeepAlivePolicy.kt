@@ -0,0 +1,36 @@
+package com.ahmer.pdfium
+
+/**
+ * Controls how long the native PDFium library stays initialized once the last document is closed.
+ *
+ * Re-initializing PDFium means paying library setup and font enumeration again, which is noticeable when
+ * documents are closed and opened in quick succession (e.g. a file browser).
+ *
+ * @property keepAlive Whether the library outlives the last open document.
+ * @property idleTimeoutMs Delay after the last document is closed before the library is released,
+ * or 0 to keep it until [PdfiumCore.releaseLibrary] or a memory trim.
+ * @property releaseOnTrimMemory Whether an idle library is released when the system asks the app to trim memory.
+ */
+data class KeepAlivePolicy(
+    val keepAlive: Boolean,
+    val idleTimeoutMs: Long = DEFAULT_IDLE_TIMEOUT_MS,
+    val releaseOnTrimMemory: Boolean = true,
+) {
+    init {
+        require(value = idleTimeoutMs >= 0) { "Idle timeout cannot be negative" }
+    }
+
+    companion object {
+        const val DEFAULT_IDLE_TIMEOUT_MS: Long = 30_000L
+
+        /**
+         * Legacy behaviour: the library is destroyed as soon as the last document is closed.
+         */
+        val DISABLED: KeepAlivePolicy = KeepAlivePolicy(keepAlive = false)
+
+        /**
+         * Keeps the library for [DEFAULT_IDLE_TIMEOUT_MS] after the last document is closed.
+         */
+        val DEFAULT: KeepAlivePolicy = KeepAlivePolicy(keepAlive = true)
+    }
+}
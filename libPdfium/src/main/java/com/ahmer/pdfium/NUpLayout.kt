@@ -0,0 +1,19 @@
+package com.ahmer.pdfium
+
+/**
+ * Grid of pages placed on one sheet by [PdfDocument.saveNUp] and [PdfiumCore.renderOverviewSheet]
+ *
+ * @property columns Number of pages across the sheet
+ * @property rows Number of pages down the sheet
+ * @property isLandscape Whether the layout fits a landscape sheet, for portrait source pages
+ */
+enum class NUpLayout(val columns: Int, val rows: Int, val isLandscape: Boolean) {
+    TWO_UP(columns = 2, rows = 1, isLandscape = true),
+    FOUR_UP(columns = 2, rows = 2, isLandscape = false),
+    NINE_UP(columns = 3, rows = 3, isLandscape = false);
+
+    /**
+     * Number of pages on one sheet
+     */
+    val pagesPerSheet: Int get() = columns * rows
+}
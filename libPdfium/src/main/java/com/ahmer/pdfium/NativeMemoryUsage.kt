@@ -0,0 +1,50 @@
+package com.ahmer.pdfium
+
+/**
+ * Native memory held for one document, or for all open documents together.
+ *
+ * Buffers allocated by the binding (source copy, render scratch buffers) are exact. Pages, text pages
+ * and search handles live in PDFium and are estimated from their content, so treat those as a trend
+ * rather than an exact figure.
+ *
+ * @property sourceBytes In-memory copy of the document, 0 for documents read from a file descriptor
+ * @property pageBytes Estimated size of the open pages
+ * @property textPageBytes Estimated size of the open text pages
+ * @property searchBytes Estimated size of the open search handles
+ * @property scratchBytes Temporary render buffers currently allocated
+ * @property openPages Number of open pages
+ * @property openTextPages Number of open text pages
+ * @property openSearches Number of open search handles
+ * @property totalBytes Sum of all the above byte counts
+ * @property peakBytes Highest [totalBytes] seen
+ */
+data class NativeMemoryUsage(
+    val sourceBytes: Long = 0L,
+    val pageBytes: Long = 0L,
+    val textPageBytes: Long = 0L,
+    val searchBytes: Long = 0L,
+    val scratchBytes: Long = 0L,
+    val openPages: Int = 0,
+    val openTextPages: Int = 0,
+    val openSearches: Int = 0,
+    val totalBytes: Long = 0L,
+    val peakBytes: Long = 0L,
+) {
+    companion object {
+        /** Usage of a document that holds nothing, e.g. once closed. */
+        val EMPTY: NativeMemoryUsage = NativeMemoryUsage()
+
+        internal fun fromSnapshot(values: LongArray): NativeMemoryUsage = NativeMemoryUsage(
+            sourceBytes = values[0],
+            pageBytes = values[1],
+            textPageBytes = values[2],
+            searchBytes = values[3],
+            scratchBytes = values[4],
+            openPages = values[6].toInt(),
+            openTextPages = values[7].toInt(),
+            openSearches = values[8].toInt(),
+            totalBytes = values[10],
+            peakBytes = values[11]
+        )
+    }
+}
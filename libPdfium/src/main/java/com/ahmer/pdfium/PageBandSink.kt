@@ -0,0 +1,19 @@
+package com.ahmer.pdfium
+
+import android.graphics.Bitmap
+
+/**
+ * Receives the bands of a page rendered by [PdfiumCore.renderPageBanded], from top to bottom
+ */
+fun interface PageBandSink {
+    /**
+     * Called with each rendered band. The strip is reused for the next band, so its pixels must be
+     * consumed (printed, encoded or written) before returning.
+     *
+     * @param strip Strip holding the band in its first [height] rows
+     * @param top First row of the band within the page, in pixels
+     * @param height Number of rows of the band
+     * @return Whether to continue with the next band
+     */
+    fun onBand(strip: Bitmap, top: Int, height: Int): Boolean
+}
@@ -0,0 +1,27 @@
+package com.ahmer.pdfium
+
+/**
+ * Content statistics of a page, used to estimate how expensive it is to render.
+ * Objects inside form XObjects are counted too.
+ *
+ * @property objectCount Number of page objects
+ * @property textCount Number of text objects
+ * @property imageCount Number of image objects
+ * @property imagePixels Total source pixels of the images, before scaling
+ * @property pathSegments Total segments of the path objects
+ * @property transparentCount Number of objects using transparency (alpha, soft masks or blend modes)
+ * @property shadingCount Number of shading objects
+ */
+data class PageComplexity(
+    val objectCount: Int = 0,
+    val textCount: Int = 0,
+    val imageCount: Int = 0,
+    val imagePixels: Long = 0L,
+    val pathSegments: Long = 0L,
+    val transparentCount: Int = 0,
+    val shadingCount: Int = 0,
+) {
+    companion object {
+        val EMPTY: PageComplexity = PageComplexity()
+    }
+}
@@ -4,6 +4,10 @@ import android.graphics.RectF
 import android.os.ParcelFileDescriptor
 import android.util.Log
 import java.io.Closeable
+import java.io.File
+import java.io.IOException
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
 /**
  * Represents a PDF document with thread-safe operations using coroutine mutex.
@@ -26,7 +30,7 @@ class PdfDocument : Closeable {
      * @return Number of pages or 0 if closed
      */
     val totalPages: Int
-        get() = synchronized(lock = PdfiumCore.lock) {
+        get() = PdfiumCore.withLock {
             nativeGetPageCount(docPtr = nativePtr)
         }
 
@@ -36,7 +40,7 @@ class PdfDocument : Closeable {
      * @return IntArray of character counts per page (empty if closed)
      */
     val pageCharCounts: IntArray by lazy {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeGetPageCharCounts(docPtr = nativePtr)
         }
     }
@@ -49,7 +53,7 @@ class PdfDocument : Closeable {
      * @throws IllegalStateException If document closed
      */
     fun openPage(pageIndex: Int): Long {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             if (hasPage(pageIndex = pageIndex)) {
                 pageCache[pageIndex]?.let {
                     it.count++
@@ -70,7 +74,7 @@ class PdfDocument : Closeable {
      * @return LongArray of native page pointers
      */
     fun openPages(start: Int, end: Int): LongArray {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return nativeLoadPages(docPtr = nativePtr, fromIndex = start, toIndex = end)
         }
     }
@@ -81,7 +85,7 @@ class PdfDocument : Closeable {
      * @param pageIndex Page index to delete
      */
     fun deletePage(pageIndex: Int) {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeDeletePage(docPtr = nativePtr, pageIndex = pageIndex)
         }
     }
@@ -91,41 +95,152 @@ class PdfDocument : Closeable {
      *
      * @return Meta object containing document information
      */
-    val metaData: Meta by lazy {
-        synchronized(lock = PdfiumCore.lock) {
-            Meta().apply {
-                title = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "Title")
-                author = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "Author")
-                subject = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "Subject")
-                keywords = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "Keywords")
-                creator = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "Creator")
-                producer = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "Producer")
-                creationDate = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "CreationDate")
-                modDate = nativeGetDocumentMetaText(docPtr = nativePtr, tag = "ModDate")
-            }
+    val metaData: Meta by lazy { summary.meta }
+
+    /**
+     * Metadata, page labels and named destinations of the document, read in a single native call
+     */
+    val summary: Summary by lazy {
+        val bytes: ByteArray = PdfiumCore.withLock { nativeGetSummary(docPtr = nativePtr) }
+            ?: return@lazy Summary(meta = Meta(), pageLabels = emptyList(), namedDestinations = emptyList())
+        val buffer: ByteBuffer = ByteBuffer.wrap(bytes).order(ByteOrder.nativeOrder())
+        val meta = Meta(
+            title = buffer.getWideString(),
+            author = buffer.getWideString(),
+            subject = buffer.getWideString(),
+            keywords = buffer.getWideString(),
+            creator = buffer.getWideString(),
+            producer = buffer.getWideString(),
+            creationDate = buffer.getWideString(),
+            modDate = buffer.getWideString(),
+        )
+        val pageLabels: List<String?> = List(size = buffer.getInt()) { buffer.getWideString().ifEmpty { null } }
+        val namedDestinations: List<NamedDestination> = List(size = buffer.getInt()) {
+            val name: String = buffer.getWideString()
+            val pageIndex: Int = buffer.getInt()
+            val flags: Int = buffer.getInt()
+            val x: Float = buffer.getFloat()
+            val y: Float = buffer.getFloat()
+            val zoom: Float = buffer.getFloat()
+            NamedDestination(
+                name = name,
+                pageIndex = pageIndex,
+                x = x.takeIf { flags and DEST_HAS_X != 0 },
+                y = y.takeIf { flags and DEST_HAS_Y != 0 },
+                zoom = zoom.takeIf { flags and DEST_HAS_ZOOM != 0 }
+            )
         }
+        Summary(meta = meta, pageLabels = pageLabels, namedDestinations = namedDestinations)
     }
 
-    private fun recursiveGetBookmark(
-        tree: MutableList<Bookmark>,
-        bookmarkPtr: Long,
-        level: Long,
-    ) {
-        val maxRecursion = 16
-        var levelMutable: Long = level
-        val bookmark: Bookmark = Bookmark().apply {
-            nativePtr = bookmarkPtr
-            title = nativeGetBookmarkTitle(bookmarkPtr = bookmarkPtr)
-            pageIndex = nativeGetBookmarkDestIndex(docPtr = this@PdfDocument.nativePtr, bookmarkPtr = bookmarkPtr)
-            tree.add(this)
+    /**
+     * Stable identity of the document for persistent caches, from the file identifiers, the size, the
+     * trailer offsets and a hash of samples of the file. Reads a few kilobytes, even for large files.
+     *
+     * @return The fingerprint, or null when the source cannot be read
+     */
+    val fingerprint: PdfFingerprint? by lazy {
+        val bytes: ByteArray = PdfiumCore.withLock { nativeGetFingerprint(docPtr = nativePtr) } ?: return@lazy null
+        val buffer: ByteBuffer = ByteBuffer.wrap(bytes).order(ByteOrder.nativeOrder())
+        PdfFingerprint(
+            permanentId = buffer.getHex(),
+            changingId = buffer.getHex(),
+            fileSize = buffer.getLong(),
+            trailerEnds = List(size = buffer.getInt()) { buffer.getInt() },
+            contentHash = buffer.getLong(),
+            key = "%016x".format(buffer.getLong())
+        )
+    }
+
+    /**
+     * Reads an entry of the document information dictionary, including the non-standard ones that
+     * [metaData] leaves out
+     *
+     * @param tag Key of the entry, e.g. `Title` or `Company`
+     * @return Value of the entry, empty if it is not set
+     */
+    fun getMetaText(tag: String): String {
+        PdfiumCore.withLock {
+            return nativeGetDocumentMetaText(docPtr = nativePtr, tag = tag).orEmpty()
         }
-        val child: Long = nativeGetFirstChildBookmark(docPtr = nativePtr, bookmarkPtr = bookmarkPtr)
-        if (child != 0L && levelMutable < maxRecursion) {
-            recursiveGetBookmark(tree = bookmark.children, bookmarkPtr = child, level = levelMutable++)
+    }
+
+    /**
+     * Label shown for a page instead of its number, e.g. `iv` or `A-3`
+     *
+     * @param pageIndex Zero-based page index
+     * @return The label, or null when the page has none
+     */
+    fun getPageLabel(pageIndex: Int): String? = summary.pageLabels.getOrNull(index = pageIndex)
+
+    private fun ByteBuffer.getHex(): String {
+        return ByteArray(size = getInt()).also { get(it) }.joinToString(separator = "") { "%02x".format(it) }
+    }
+
+    private fun ByteBuffer.getWideString(): String {
+        val length: Int = getInt()
+        return String(CharArray(size = length) { getChar() })
+    }
+
+    /**
+     * Reads the outline in a single native call, flattened depth first in display order, so that large
+     * tables of contents load without a call per node. Pass a small [maxDepth] to read only the upper
+     * levels, then [expandOutline] the entries as the user opens them.
+     *
+     * @param maxDepth Number of levels to read, 1 for the top level only
+     * @return Outline entries, each followed by its expanded subtree
+     */
+    fun getOutline(maxDepth: Int = Int.MAX_VALUE): List<OutlineEntry> {
+        return readOutline(parentPtr = 0L, baseDepth = 0, maxDepth = maxDepth)
+    }
+
+    /**
+     * Reads the subtree of an entry that [getOutline] did not expand. The document must still be open.
+     *
+     * @param entry Entry whose children to read
+     * @param maxDepth Number of levels to read below [entry]
+     * @return Entries below [entry], flattened like [getOutline]. Empty for an entry without a native
+     * bookmark, e.g. one restored from a saved index: a null pointer would read the top level instead
+     */
+    fun expandOutline(entry: OutlineEntry, maxDepth: Int = 1): List<OutlineEntry> {
+        if (!entry.hasChildren || entry.nativePtr == 0L) return emptyList()
+        return readOutline(parentPtr = entry.nativePtr, baseDepth = entry.depth + 1, maxDepth = maxDepth)
+    }
+
+    private fun readOutline(parentPtr: Long, baseDepth: Int, maxDepth: Int): List<OutlineEntry> {
+        val buffer: ByteBuffer = PdfiumCore.withLock {
+            val bytes: ByteArray = nativeGetOutline(docPtr = nativePtr, parentPtr = parentPtr, maxDepth = maxDepth)
+                ?: return emptyList()
+            ByteBuffer.wrap(bytes).order(ByteOrder.nativeOrder())
         }
-        val sibling: Long = nativeGetSiblingBookmark(docPtr = nativePtr, bookmarkPtr = bookmarkPtr)
-        if (sibling != 0L && levelMutable < maxRecursion) {
-            recursiveGetBookmark(tree = tree, bookmarkPtr = sibling, level = levelMutable)
+        val count: Int = buffer.getInt()
+        val entriesStart: Int = buffer.position()
+        // Titles follow the entries as one buffer, each entry has its offset and length
+        buffer.position(entriesStart + count * OUTLINE_ENTRY_BYTES)
+        val titles = CharArray(size = buffer.getInt())
+        buffer.asCharBuffer().get(titles)
+        buffer.position(entriesStart)
+        return List(size = count) {
+            val entryPtr: Long = buffer.getLong()
+            val depth: Int = buffer.getInt()
+            val titleOffset: Int = buffer.getInt()
+            val titleLength: Int = buffer.getInt()
+            val pageIndex: Int = buffer.getInt()
+            val flags: Int = buffer.getInt()
+            val x: Float = buffer.getFloat()
+            val y: Float = buffer.getFloat()
+            val zoom: Float = buffer.getFloat()
+            OutlineEntry(
+                nativePtr = entryPtr,
+                depth = baseDepth + depth,
+                title = String(titles, titleOffset, titleLength),
+                pageIndex = pageIndex,
+                x = x.takeIf { flags and DEST_HAS_X != 0 },
+                y = y.takeIf { flags and DEST_HAS_Y != 0 },
+                zoom = zoom.takeIf { flags and DEST_HAS_ZOOM != 0 },
+                hasChildren = flags and OUTLINE_HAS_CHILDREN != 0,
+                isExpanded = flags and OUTLINE_EXPANDED != 0
+            )
         }
     }
 
@@ -134,16 +249,7 @@ class PdfDocument : Closeable {
      *
      * @return Hierarchical list of bookmarks
      */
-    val bookmarks: List<Bookmark> by lazy {
-        synchronized(lock = PdfiumCore.lock) {
-            val topLevel: MutableList<Bookmark> = mutableListOf()
-            val first: Long = nativeGetFirstChildBookmark(docPtr = nativePtr, bookmarkPtr = 0L)
-            if (first != 0L) {
-                recursiveGetBookmark(tree = topLevel, bookmarkPtr = first, level = 1)
-            }
-            topLevel
-        }
-    }
+    val bookmarks: List<Bookmark> by lazy { bookmarksOf(outline = getOutline()) }
 
     fun hasPage(pageIndex: Int): Boolean {
         return pageCache.containsKey(key = pageIndex)
@@ -161,7 +267,7 @@ class PdfDocument : Closeable {
      * @throws IllegalStateException If document closed
      */
     fun openTextPage(pageIndex: Int): PdfTextPage {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             if (hasTextPage(pageIndex = pageIndex)) {
                 textPageCache[pageIndex]?.let {
                     it.count++
@@ -196,7 +302,7 @@ class PdfDocument : Closeable {
     fun openTextPages(start: Int, end: Int): List<PdfTextPage> {
         require(value = start <= end) { "Invalid page range: $start-$end" }
         var textPagesPtr: LongArray
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             textPagesPtr = nativeLoadPages(docPtr = nativePtr, fromIndex = start, toIndex = end)
             return textPagesPtr.mapIndexed { index: Int, pagePtr: Long ->
                 PdfTextPage(
@@ -224,19 +330,93 @@ class PdfDocument : Closeable {
         return nativeSaveAsCopy(docPtr = nativePtr, callback = callback, flags = flags)
     }
 
+    /**
+     * Splits the document into several new documents in a single pass over this one. Viewer
+     * preferences are copied to every part.
+     *
+     * @param parts Page indexes of each part, in order
+     * @param outputs Destination of each part, written from its current position and left open
+     * @return Number of parts written, the parts following a failed one are not written
+     */
+    fun split(parts: List<IntArray>, outputs: List<ParcelFileDescriptor>): Int {
+        require(value = parts.size == outputs.size) { "Each part needs an output" }
+        require(value = parts.all { it.isNotEmpty() }) { "Parts cannot be empty" }
+        if (parts.isEmpty()) return 0
+        PdfiumCore.withLock {
+            return nativeSplitDocument(
+                docPtr = nativePtr,
+                pageIndices = parts.flatMap { it.asList() }.toIntArray(),
+                partSizes = IntArray(size = parts.size) { parts[it].size },
+                outputFds = IntArray(size = outputs.size) { outputs[it].fd },
+            )
+        }
+    }
+
+    /**
+     * Splits the document into `<baseName>-<part number>.pdf` files in [directory]
+     *
+     * @param parts Page indexes of each part, in order
+     * @return Files of the parts written
+     * @throws IOException If a file cannot be created
+     * @see split
+     */
+    @Throws(IOException::class)
+    fun split(parts: List<IntArray>, directory: File, baseName: String = "part"): List<File> {
+        if (!directory.isDirectory && !directory.mkdirs()) throw IOException("Cannot create $directory")
+        val files: List<File> = List(size = parts.size) { File(directory, "$baseName-${it + 1}.pdf") }
+        val outputs: MutableList<ParcelFileDescriptor> = mutableListOf()
+        try {
+            files.mapTo(destination = outputs) { ParcelFileDescriptor.open(it, WRITE_MODE) }
+            val written: Int = split(parts = parts, outputs = outputs)
+            files.drop(n = written).forEach { it.delete() }
+            return files.take(n = written)
+        } finally {
+            outputs.forEach { it.close() }
+        }
+    }
+
+    /**
+     * Writes a new document imposing [layout] pages of this one on each sheet, for print handouts
+     *
+     * @param output Destination of the imposed document, written from its current position and left open
+     * @param layout Grid of pages on each sheet
+     * @param sheetWidth Width of the sheets in points, A4 by default
+     * @param sheetHeight Height of the sheets in points, A4 by default
+     * @return Whether the imposed document was written
+     */
+    fun saveNUp(
+        output: ParcelFileDescriptor,
+        layout: NUpLayout,
+        sheetWidth: Float = if (layout.isLandscape) A4_HEIGHT else A4_WIDTH,
+        sheetHeight: Float = if (layout.isLandscape) A4_WIDTH else A4_HEIGHT,
+    ): Boolean {
+        require(value = sheetWidth > 0f && sheetHeight > 0f) { "Sheet size must be positive" }
+        PdfiumCore.withLock {
+            return nativeSaveNUp(
+                docPtr = nativePtr,
+                columns = layout.columns,
+                rows = layout.rows,
+                sheetWidth = sheetWidth,
+                sheetHeight = sheetHeight,
+                outputFd = output.fd,
+            )
+        }
+    }
+
     /**
      * Close the document
      * @throws IllegalArgumentException if document is closed
      */
     override fun close() {
         Log.v(TAG, "PdfDocument.close")
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeCloseDocument(docPtr = nativePtr)
             fileDescriptor?.close()
             fileDescriptor = null
             pageCache.clear()
             textPageCache.clear()
         }
+        PdfiumCore.scheduleLibraryRelease()
     }
 
     data class Meta(
@@ -259,6 +439,59 @@ class PdfDocument : Closeable {
         val hasChildren = children.isNotEmpty()
     }
 
+    /**
+     * An entry of the flattened outline of [getOutline]
+     *
+     * @property nativePtr Native bookmark, valid while the document is open, or 0 when there is none
+     * @property depth Level of the entry, 0 for the top level
+     * @property title Title of the entry
+     * @property pageIndex Destination page, or -1 when the entry has no destination in the document
+     * @property x Destination x in page coordinates, null to keep the current position
+     * @property y Destination y in page coordinates, null to keep the current position
+     * @property zoom Destination zoom, null to keep the current zoom
+     * @property hasChildren Whether the entry has children
+     * @property isExpanded Whether the children follow the entry, see [expandOutline] otherwise
+     */
+    data class OutlineEntry(
+        val nativePtr: Long,
+        val depth: Int,
+        val title: String,
+        val pageIndex: Int,
+        val x: Float?,
+        val y: Float?,
+        val zoom: Float?,
+        val hasChildren: Boolean,
+        val isExpanded: Boolean,
+    )
+
+    /**
+     * A destination of the document referenced by name, e.g. from links of other documents
+     *
+     * @property name Name of the destination
+     * @property pageIndex Destination page, or -1 when it cannot be resolved
+     * @property x Destination x in page coordinates, null to keep the current position
+     * @property y Destination y in page coordinates, null to keep the current position
+     * @property zoom Destination zoom, null to keep the current zoom
+     */
+    data class NamedDestination(
+        val name: String,
+        val pageIndex: Int,
+        val x: Float?,
+        val y: Float?,
+        val zoom: Float?,
+    )
+
+    /**
+     * @property meta Standard entries of the information dictionary
+     * @property pageLabels Label of each page, null for pages without a label
+     * @property namedDestinations Named destinations of the document
+     */
+    data class Summary(
+        val meta: Meta,
+        val pageLabels: List<String?>,
+        val namedDestinations: List<NamedDestination>,
+    )
+
     data class Link(
         val bounds: RectF,
         val destPage: Int?,
@@ -272,6 +505,66 @@ class PdfDocument : Closeable {
 
     companion object {
         private val TAG: String? = PdfDocument::class.java.name
+        private const val A4_WIDTH: Float = 595f
+        private const val A4_HEIGHT: Float = 842f
+
+        /** Bytes of an entry of the native outline: pointer, five ints and three floats. */
+        private const val OUTLINE_ENTRY_BYTES: Int = Long.SIZE_BYTES + 5 * Int.SIZE_BYTES + 3 * Float.SIZE_BYTES
+
+        /** Flags of the native destinations and outline entries. */
+        private const val DEST_HAS_X: Int = 1 shl 0
+        private const val DEST_HAS_Y: Int = 1 shl 1
+        private const val DEST_HAS_ZOOM: Int = 1 shl 2
+        private const val OUTLINE_HAS_CHILDREN: Int = 1 shl 3
+        private const val OUTLINE_EXPANDED: Int = 1 shl 4
+        private const val WRITE_MODE: Int = ParcelFileDescriptor.MODE_WRITE_ONLY or
+                ParcelFileDescriptor.MODE_CREATE or ParcelFileDescriptor.MODE_TRUNCATE
+
+        /**
+         * Builds the bookmark tree of a flattened outline, e.g. one read by [getOutline] and stored
+         *
+         * @param outline Entries depth first, as returned by [getOutline]
+         * @return Hierarchical list of bookmarks
+         */
+        fun bookmarksOf(outline: List<OutlineEntry>): List<Bookmark> {
+            val topLevel: MutableList<Bookmark> = mutableListOf()
+            // Children lists by depth, the entries of a level go to the last bookmark of the level above
+            val levels: MutableList<MutableList<Bookmark>> = mutableListOf(topLevel)
+            outline.forEach { entry ->
+                val bookmark = Bookmark(nativePtr = entry.nativePtr, title = entry.title, pageIndex = entry.pageIndex.toLong())
+                val depth: Int = entry.depth.coerceIn(minimumValue = 0, maximumValue = levels.lastIndex)
+                while (levels.size > depth + 1) levels.removeAt(index = levels.lastIndex)
+                levels[depth].add(bookmark)
+                levels.add(bookmark.children)
+            }
+            return topLevel
+        }
+
+        /**
+         * Merges pages of several documents into a new one, in order. Viewer preferences are copied from
+         * the first source.
+         *
+         * @param sources Documents to merge, they stay open
+         * @param output Destination of the merged document, written from its current position and left open
+         * @param pages Page indexes to take from each source, null for every page
+         * @return Whether the merged document was written
+         */
+        fun merge(
+            sources: List<PdfDocument>,
+            output: ParcelFileDescriptor,
+            pages: List<IntArray?> = List(size = sources.size) { null },
+        ): Boolean {
+            require(value = sources.isNotEmpty()) { "Nothing to merge" }
+            require(value = pages.size == sources.size) { "Each source needs a page selection" }
+            PdfiumCore.withLock {
+                return nativeMergeDocuments(
+                    docPtrs = LongArray(size = sources.size) { sources[it].nativePtr },
+                    pageIndices = pages.flatMap { it?.asList().orEmpty() }.toIntArray(),
+                    partSizes = IntArray(size = pages.size) { pages[it]?.size ?: -1 },
+                    outputFd = output.fd,
+                )
+            }
+        }
 
         @JvmStatic
         private external fun nativeCloseDocument(docPtr: Long)
@@ -280,16 +573,13 @@ class PdfDocument : Closeable {
         private external fun nativeDeletePage(docPtr: Long, pageIndex: Int)
 
         @JvmStatic
-        private external fun nativeGetBookmarkDestIndex(docPtr: Long, bookmarkPtr: Long): Long
-
-        @JvmStatic
-        private external fun nativeGetBookmarkTitle(bookmarkPtr: Long): String?
+        private external fun nativeGetDocumentMetaText(docPtr: Long, tag: String): String?
 
         @JvmStatic
-        private external fun nativeGetDocumentMetaText(docPtr: Long, tag: String): String?
+        private external fun nativeGetFingerprint(docPtr: Long): ByteArray?
 
         @JvmStatic
-        private external fun nativeGetFirstChildBookmark(docPtr: Long, bookmarkPtr: Long): Long
+        private external fun nativeGetOutline(docPtr: Long, parentPtr: Long, maxDepth: Int): ByteArray?
 
         @JvmStatic
         private external fun nativeGetPageCharCounts(docPtr: Long): IntArray
@@ -298,7 +588,7 @@ class PdfDocument : Closeable {
         private external fun nativeGetPageCount(docPtr: Long): Int
 
         @JvmStatic
-        private external fun nativeGetSiblingBookmark(docPtr: Long, bookmarkPtr: Long): Long
+        private external fun nativeGetSummary(docPtr: Long): ByteArray?
 
         @JvmStatic
         private external fun nativeLoadPage(docPtr: Long, pageIndex: Int): Long
@@ -309,7 +599,22 @@ class PdfDocument : Closeable {
         @JvmStatic
         private external fun nativeLoadTextPage(docPtr: Long, pagePtr: Long): Long
 
+        @JvmStatic
+        private external fun nativeMergeDocuments(
+            docPtrs: LongArray, pageIndices: IntArray, partSizes: IntArray, outputFd: Int
+        ): Boolean
+
         @JvmStatic
         private external fun nativeSaveAsCopy(docPtr: Long, callback: PdfWriteCallback, flags: Int): Boolean
+
+        @JvmStatic
+        private external fun nativeSaveNUp(
+            docPtr: Long, columns: Int, rows: Int, sheetWidth: Float, sheetHeight: Float, outputFd: Int
+        ): Boolean
+
+        @JvmStatic
+        private external fun nativeSplitDocument(
+            docPtr: Long, pageIndices: IntArray, partSizes: IntArray, outputFds: IntArray
+        ): Int
     }
 }
\ No newline at end of file
@@ -0,0 +1,318 @@
+package com.ahmer.pdfium
+
+import android.graphics.Bitmap
+import android.graphics.Canvas
+import android.graphics.ColorMatrix
+import android.graphics.ColorMatrixColorFilter
+import android.graphics.Paint
+import android.os.Build
+import androidx.core.graphics.createBitmap
+import kotlinx.coroutines.CoroutineDispatcher
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.currentCoroutineContext
+import kotlinx.coroutines.ensureActive
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Semaphore
+import kotlinx.coroutines.withContext
+import java.io.BufferedOutputStream
+import java.io.File
+import java.io.FilterOutputStream
+import java.io.IOException
+import java.io.OutputStream
+import java.util.concurrent.atomic.AtomicInteger
+import java.util.concurrent.atomic.AtomicLong
+import kotlin.math.roundToInt
+
+/**
+ * Exports a range of pages as images, pipelined in stages: pages are rendered one at a time on a single
+ * thread (PDFium is serialized by [PdfiumCore.lock] anyway), while a pool of workers converts, encodes
+ * and streams the previous pages to their outputs.
+ *
+ * At most [Options.maxInFlight] rendered bitmaps exist at any time, the renderer waits for a worker to
+ * finish a page before rendering the next one. Cancelling the calling coroutine stops the export after
+ * the page being rendered, outputs of unfinished pages are aborted through [PageSink.abort].
+ *
+ * @property pdfiumCore Core holding the open document
+ */
+class PdfExporter(private val pdfiumCore: PdfiumCore) {
+
+    /**
+     * Encoding of the exported pages
+     *
+     * @property extension File extension used by [exportToDirectory]
+     */
+    enum class Format(val extension: String) {
+        PNG(extension = "png"),
+        JPEG(extension = "jpg"),
+        WEBP_LOSSY(extension = "webp"),
+        WEBP_LOSSLESS(extension = "webp");
+
+        @Suppress("DEPRECATION")
+        internal val compressFormat: Bitmap.CompressFormat
+            get() = when (this) {
+                PNG -> Bitmap.CompressFormat.PNG
+                JPEG -> Bitmap.CompressFormat.JPEG
+                WEBP_LOSSY -> if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.R) {
+                    Bitmap.CompressFormat.WEBP_LOSSY
+                } else Bitmap.CompressFormat.WEBP
+
+                WEBP_LOSSLESS -> if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.R) {
+                    Bitmap.CompressFormat.WEBP_LOSSLESS
+                } else Bitmap.CompressFormat.WEBP
+            }
+
+        internal fun quality(requested: Int): Int {
+            // Before Android 11, WEBP is lossless only at quality 100
+            return if (this == WEBP_LOSSLESS && Build.VERSION.SDK_INT < Build.VERSION_CODES.R) 100 else requested
+        }
+    }
+
+    /**
+     * @property dpi Resolution of the exported images, a page is `points * dpi / 72` pixels wide
+     * @property format Encoding of the images
+     * @property quality Encoder quality, 0 to 100. PNG ignores it, lossless WEBP uses it as compression effort
+     * @property grayscale Whether to convert the pages to grayscale before encoding
+     * @property annotation Whether to render annotations
+     * @property workers Number of concurrent converting and encoding workers
+     * @property maxInFlight Maximum number of rendered bitmaps alive at once, bounding the memory used
+     * to roughly `maxInFlight * width * height * 4` bytes
+     */
+    data class Options(
+        val dpi: Int = 150,
+        val format: Format = Format.PNG,
+        val quality: Int = 90,
+        val grayscale: Boolean = false,
+        val annotation: Boolean = false,
+        val workers: Int = (Runtime.getRuntime().availableProcessors() - 1).coerceIn(minimumValue = 1, maximumValue = 4),
+        val maxInFlight: Int = workers + 1,
+    ) {
+        init {
+            require(value = dpi in MIN_DPI..MAX_DPI) { "DPI must be between $MIN_DPI and $MAX_DPI" }
+            require(value = quality in 0..100) { "Quality must be between 0 and 100" }
+            require(value = workers > 0) { "Worker count must be positive" }
+            require(value = maxInFlight > 0) { "In-flight page count must be positive" }
+        }
+    }
+
+    /**
+     * Destination of the encoded pages
+     */
+    interface PageSink {
+        /**
+         * Opens the output of a page. Called on a worker thread, the stream is closed by the exporter.
+         */
+        @Throws(exceptionClasses = [IOException::class])
+        fun open(pageIndex: Int): OutputStream
+
+        /**
+         * Called once the page is completely written and its output closed
+         */
+        fun commit(pageIndex: Int) {}
+
+        /**
+         * Called when writing the page failed or the export was cancelled after its output was opened
+         */
+        fun abort(pageIndex: Int) {}
+    }
+
+    /**
+     * @property pageCount Number of pages exported
+     * @property bytesWritten Total size of the encoded pages
+     * @property elapsedNanos Wall time of the export
+     */
+    data class Result(
+        val pageCount: Int,
+        val bytesWritten: Long,
+        val elapsedNanos: Long,
+    ) {
+        val pagesPerSecond: Float
+            get() = if (elapsedNanos > 0L) pageCount * 1_000_000_000f / elapsedNanos else 0f
+    }
+
+    private class RenderedPage(val pageIndex: Int, val bitmap: Bitmap)
+
+    /**
+     * Exports [pages] to [sink]
+     *
+     * @param pages Indexes of the pages to export
+     * @param sink Destination of the encoded pages
+     * @param options Resolution, encoding and parallelism of the export
+     * @param onProgress Called from a worker thread after each page, with the number of exported pages
+     * and the total
+     * @return Statistics of the export
+     * @throws IOException If writing a page fails, the remaining pages are not exported
+     */
+    suspend fun export(
+        pages: IntRange,
+        sink: PageSink,
+        options: Options = Options(),
+        onProgress: (completed: Int, total: Int) -> Unit = { _, _ -> },
+    ): Result {
+        require(value = !pages.isEmpty()) { "Page range is empty" }
+        val total: Int = pages.last - pages.first + 1
+        val start: Long = System.nanoTime()
+        val completed = AtomicInteger(0)
+        val bytesWritten = AtomicLong(0L)
+        val inFlight = Semaphore(permits = options.maxInFlight)
+        val rendered = Channel<RenderedPage>(capacity = options.maxInFlight)
+
+        coroutineScope {
+            launch(context = renderDispatcher) {
+                try {
+                    for (pageIndex in pages) {
+                        inFlight.acquire()
+                        val bitmap: Bitmap = try {
+                            renderPage(pageIndex = pageIndex, options = options)
+                        } catch (e: Throwable) {
+                            inFlight.release()
+                            throw e
+                        }
+                        rendered.send(element = RenderedPage(pageIndex = pageIndex, bitmap = bitmap))
+                    }
+                } finally {
+                    rendered.close()
+                }
+            }
+            repeat(times = options.workers) {
+                launch(context = Dispatchers.Default) {
+                    for (page in rendered) {
+                        try {
+                            bytesWritten.addAndGet(encodePage(page = page, sink = sink, options = options))
+                        } finally {
+                            page.bitmap.recycle()
+                            inFlight.release()
+                        }
+                        onProgress(completed.incrementAndGet(), total)
+                    }
+                }
+            }
+        }
+        return Result(
+            pageCount = completed.get(),
+            bytesWritten = bytesWritten.get(),
+            elapsedNanos = System.nanoTime() - start
+        )
+    }
+
+    /**
+     * Exports [pages] as `<baseName>-<page number>.<extension>` files in [directory]. Pages are written to
+     * temporary files renamed once complete, so no truncated image is left behind by a failure.
+     *
+     * @see export
+     */
+    suspend fun exportToDirectory(
+        pages: IntRange,
+        directory: File,
+        baseName: String = "page",
+        options: Options = Options(),
+        onProgress: (completed: Int, total: Int) -> Unit = { _, _ -> },
+    ): Result {
+        withContext(context = Dispatchers.IO) {
+            if (!directory.isDirectory && !directory.mkdirs()) throw IOException("Cannot create $directory")
+        }
+        val sink = object : PageSink {
+            private fun target(pageIndex: Int) = File(directory, "$baseName-${pageIndex + 1}.${options.format.extension}")
+            private fun partial(pageIndex: Int) = File(directory, "${target(pageIndex = pageIndex).name}.part")
+
+            override fun open(pageIndex: Int): OutputStream = partial(pageIndex = pageIndex).outputStream()
+
+            override fun commit(pageIndex: Int) {
+                val target: File = target(pageIndex = pageIndex)
+                if (!partial(pageIndex = pageIndex).renameTo(target)) throw IOException("Cannot write $target")
+            }
+
+            override fun abort(pageIndex: Int) {
+                partial(pageIndex = pageIndex).delete()
+            }
+        }
+        return export(pages = pages, sink = sink, options = options, onProgress = onProgress)
+    }
+
+    private fun renderPage(pageIndex: Int, options: Options): Bitmap {
+        pdfiumCore.openPage(pageIndex = pageIndex)
+        try {
+            val width: Int = pointsToPixels(points = pdfiumCore.getPageWidthPoint(pageIndex = pageIndex), dpi = options.dpi)
+            val height: Int = pointsToPixels(points = pdfiumCore.getPageHeightPoint(pageIndex = pageIndex), dpi = options.dpi)
+            val bitmap: Bitmap = createBitmap(width = width, height = height, config = Bitmap.Config.ARGB_8888)
+            val status: Int = pdfiumCore.renderPageBitmap(
+                pageIndex = pageIndex,
+                bitmap = bitmap,
+                startX = 0,
+                startY = 0,
+                drawSizeX = width,
+                drawSizeY = height,
+                annotation = options.annotation
+            )
+            if (status == PdfiumCore.RENDER_STATUS_FAILED) {
+                bitmap.recycle()
+                throw IOException("Cannot render page $pageIndex")
+            }
+            return bitmap
+        } finally {
+            pdfiumCore.closePage(pageIndex = pageIndex)
+        }
+    }
+
+    private suspend fun encodePage(page: RenderedPage, sink: PageSink, options: Options): Long {
+        val bitmap: Bitmap = if (options.grayscale) toGrayscale(bitmap = page.bitmap) else page.bitmap
+        try {
+            currentCoroutineContext().ensureActive()
+            val output = CountingOutputStream(out = BufferedOutputStream(sink.open(pageIndex = page.pageIndex), BUFFER_SIZE))
+            try {
+                output.use {
+                    if (!bitmap.compress(options.format.compressFormat, options.format.quality(requested = options.quality), it)) {
+                        throw IOException("Cannot encode page ${page.pageIndex}")
+                    }
+                }
+                sink.commit(pageIndex = page.pageIndex)
+            } catch (e: Throwable) {
+                sink.abort(pageIndex = page.pageIndex)
+                throw e
+            }
+            return output.count
+        } finally {
+            if (bitmap !== page.bitmap) bitmap.recycle()
+        }
+    }
+
+    private fun toGrayscale(bitmap: Bitmap): Bitmap {
+        val gray: Bitmap = createBitmap(width = bitmap.width, height = bitmap.height, config = Bitmap.Config.ARGB_8888)
+        val paint = Paint().apply {
+            colorFilter = ColorMatrixColorFilter(ColorMatrix().apply { setSaturation(0f) })
+        }
+        Canvas(gray).drawBitmap(bitmap, 0f, 0f, paint)
+        return gray
+    }
+
+    private class CountingOutputStream(out: OutputStream) : FilterOutputStream(out) {
+        var count: Long = 0L
+            private set
+
+        override fun write(b: Int) {
+            out.write(b)
+            count++
+        }
+
+        override fun write(b: ByteArray, off: Int, len: Int) {
+            out.write(b, off, len)
+            count += len
+        }
+    }
+
+    companion object {
+        const val MIN_DPI: Int = 18
+        const val MAX_DPI: Int = 1200
+        private const val BUFFER_SIZE: Int = 64 * 1024
+
+        /**
+         * Single thread rendering the pages, PDFium calls are serialized by [PdfiumCore.lock]
+         */
+        private val renderDispatcher: CoroutineDispatcher = Dispatchers.IO.limitedParallelism(parallelism = 1)
+
+        private fun pointsToPixels(points: Int, dpi: Int): Int {
+            return (points * dpi / 72f).roundToInt().coerceAtLeast(minimumValue = 1)
+        }
+    }
+}
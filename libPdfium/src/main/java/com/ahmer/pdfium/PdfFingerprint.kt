@@ -0,0 +1,21 @@
+package com.ahmer.pdfium
+
+/**
+ * Identity of a document for persistent cache keys, computed natively from a few kilobytes of the
+ * file whatever its size. Two files with the same [key] can be treated as the same document.
+ *
+ * @property permanentId Permanent file identifier in hex, empty if the document has none
+ * @property changingId Changing file identifier in hex, updated by editors on each save
+ * @property fileSize Size of the file in bytes
+ * @property trailerEnds Byte offsets of the trailer ends, one per incremental update
+ * @property contentHash Hash of samples spread over the file, the first and last bytes included
+ * @property key Hash of all the above in hex, to use as the cache key
+ */
+data class PdfFingerprint(
+    val permanentId: String,
+    val changingId: String,
+    val fileSize: Long,
+    val trailerEnds: List<Int>,
+    val contentHash: Long,
+    val key: String,
+)
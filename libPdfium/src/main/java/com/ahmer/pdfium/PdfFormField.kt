@@ -0,0 +1,65 @@
+package com.ahmer.pdfium
+
+import android.graphics.RectF
+
+/**
+ * A widget of a form field. Fields shown in several places, like the buttons of a radio group, have
+ * one widget per place, all with the same [name].
+ *
+ * @property pageIndex Index of the page holding the widget
+ * @property annotationIndex Index of the widget among the page annotations
+ * @property type Field type, one of the `TYPE_` constants
+ * @property flags Field flags, see the `FLAG_` constants
+ * @property isChecked Whether the check box or radio button is checked
+ * @property bounds Bounds of the widget, in page coordinates: top is above bottom
+ * @property name Fully qualified name of the field, e.g. `address.city`
+ * @property value Value of the field
+ * @property exportValue Value the field takes when this check box or radio button is checked
+ * @property options Choices of a combo box or list box
+ */
+data class PdfFormField(
+    val pageIndex: Int,
+    val annotationIndex: Int,
+    val type: Int,
+    val flags: Int,
+    val isChecked: Boolean,
+    val bounds: RectF,
+    val name: String,
+    val value: String,
+    val exportValue: String,
+    val options: List<Option>,
+) {
+    /**
+     * @property label Text of the choice, the value the field takes when it is selected
+     * @property isSelected Whether the choice is selected
+     */
+    data class Option(val label: String, val isSelected: Boolean)
+
+    val isReadOnly: Boolean get() = flags and FLAG_READ_ONLY != 0
+    val isRequired: Boolean get() = flags and FLAG_REQUIRED != 0
+
+    companion object {
+        const val TYPE_UNKNOWN: Int = 0
+        const val TYPE_PUSH_BUTTON: Int = 1
+        const val TYPE_CHECK_BOX: Int = 2
+        const val TYPE_RADIO_BUTTON: Int = 3
+        const val TYPE_COMBO_BOX: Int = 4
+        const val TYPE_LIST_BOX: Int = 5
+        const val TYPE_TEXT_FIELD: Int = 6
+        const val TYPE_SIGNATURE: Int = 7
+
+        const val FLAG_READ_ONLY: Int = 1 shl 0
+        const val FLAG_REQUIRED: Int = 1 shl 1
+        const val FLAG_NO_EXPORT: Int = 1 shl 2
+        const val FLAG_TEXT_MULTILINE: Int = 1 shl 12
+        const val FLAG_TEXT_PASSWORD: Int = 1 shl 13
+        const val FLAG_CHOICE_COMBO: Int = 1 shl 17
+        const val FLAG_CHOICE_EDIT: Int = 1 shl 18
+        const val FLAG_CHOICE_MULTI_SELECT: Int = 1 shl 21
+
+        /**
+         * Value unchecking a check box in [PdfiumCore.setFormFieldValues]
+         */
+        const val VALUE_OFF: String = "Off"
+    }
+}
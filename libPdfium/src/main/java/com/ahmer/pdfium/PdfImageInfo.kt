@@ -0,0 +1,48 @@
+package com.ahmer.pdfium
+
+import android.graphics.RectF
+
+/**
+ * An image object placed directly on a page
+ *
+ * @property pageIndex Index of the page holding the image
+ * @property objectIndex Index of the image among the page objects
+ * @property width Width of the image in pixels
+ * @property height Height of the image in pixels
+ * @property bitsPerPixel Bits per pixel of the decoded image
+ * @property colorSpace Color space of the image, one of the `COLOR_SPACE_` constants
+ * @property rawSize Size of the encoded image data, as stored in the document
+ * @property filters Decoders of the encoded data, applied in order, e.g. `DCTDecode` for JPEG data
+ * @property bounds Bounds of the image on the page, in page coordinates
+ */
+data class PdfImageInfo(
+    val pageIndex: Int,
+    val objectIndex: Int,
+    val width: Int,
+    val height: Int,
+    val bitsPerPixel: Int,
+    val colorSpace: Int,
+    val rawSize: Long,
+    val filters: List<String>,
+    val bounds: RectF,
+) {
+    /**
+     * Whether the encoded data is a complete JPEG file
+     */
+    val isJpeg: Boolean get() = filters.singleOrNull() == "DCTDecode"
+
+    companion object {
+        const val COLOR_SPACE_UNKNOWN: Int = 0
+        const val COLOR_SPACE_DEVICE_GRAY: Int = 1
+        const val COLOR_SPACE_DEVICE_RGB: Int = 2
+        const val COLOR_SPACE_DEVICE_CMYK: Int = 3
+        const val COLOR_SPACE_CAL_GRAY: Int = 4
+        const val COLOR_SPACE_CAL_RGB: Int = 5
+        const val COLOR_SPACE_LAB: Int = 6
+        const val COLOR_SPACE_ICC_BASED: Int = 7
+        const val COLOR_SPACE_SEPARATION: Int = 8
+        const val COLOR_SPACE_DEVICE_N: Int = 9
+        const val COLOR_SPACE_INDEXED: Int = 10
+        const val COLOR_SPACE_PATTERN: Int = 11
+    }
+}
@@ -0,0 +1,40 @@
+package com.ahmer.pdfium
+
+import android.graphics.RectF
+
+/**
+ * A block of a tagged page in reading order, read from the structure tree. Text blocks carry their
+ * text so it can be laid out again at any width, figures carry their bounds so only they need to be
+ * rendered, see [PdfiumCore.renderPageRegion].
+ *
+ * @property type Kind of block, one of the `TYPE_` constants
+ * @property level Heading level from 1 to 6, 0 for other blocks
+ * @property bounds Bounds of the block content, in page coordinates: top is above bottom. Empty when
+ * the block only has replacement text
+ * @property fontSize Average font size of the text in points, 0 when the block has no text
+ * @property fontWeight Weight of the first font of the block, 400 is normal and 700 bold, 0 if unknown
+ * @property text Text of the block, empty for figures
+ * @property altText Alternate description of a figure
+ */
+data class PdfReflowBlock(
+    val type: Int,
+    val level: Int,
+    val bounds: RectF,
+    val fontSize: Float,
+    val fontWeight: Int,
+    val text: String,
+    val altText: String,
+) {
+    val isBold: Boolean get() = fontWeight >= BOLD_WEIGHT
+    val isFigure: Boolean get() = type == TYPE_FIGURE
+
+    companion object {
+        const val TYPE_HEADING: Int = 1
+        const val TYPE_PARAGRAPH: Int = 2
+        const val TYPE_LIST_ITEM: Int = 3
+        const val TYPE_TABLE_CELL: Int = 4
+        const val TYPE_FIGURE: Int = 5
+
+        private const val BOLD_WEIGHT: Int = 600
+    }
+}
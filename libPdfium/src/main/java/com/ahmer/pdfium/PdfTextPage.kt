@@ -36,7 +36,7 @@ class PdfTextPage(
      * @throws IllegalStateException if the page or document is closed
      */
     val charCount: Int by lazy {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeTextCountChars(textPagePtr = textPagePtr).also {
                 if (it < 0) throw IllegalStateException("Failed to get character count")
             }
@@ -44,7 +44,7 @@ class PdfTextPage(
     }
 
     private val pageLinkPtr: Long by lazy {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeLoadWebLink(textPagePtr = textPagePtr).also {
                 if (it == 0L) throw IllegalStateException("Failed to load page links")
             }
@@ -57,7 +57,7 @@ class PdfTextPage(
      * @return Total count of web links.
      */
     val webLinksCount: Int by lazy {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             nativeCountWebLinks(pageLinkPtr = pageLinkPtr)
         }
     }
@@ -74,7 +74,7 @@ class PdfTextPage(
         require(value = startIndex >= 0) { "Start index cannot be negative" }
         require(value = length >= 0) { "Length cannot be negative" }
         require(value = startIndex + length <= charCount) { "Requested range exceeds character count" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 val buffer = ShortArray(size = length + 1)
                 val chars: Int = nativeTextGetText(
@@ -112,7 +112,7 @@ class PdfTextPage(
         require(value = length >= 0) { "Length cannot be negative" }
         require(value = startIndex + length <= charCount) { "Requested range exceeds character count" }
 
-        return synchronized(lock = PdfiumCore.lock) {
+        return PdfiumCore.withLock {
             try {
                 ByteArray(size = length * 2).let { buffer ->
                     val chars: Int = nativeTextGetTextByteArray(
@@ -140,7 +140,7 @@ class PdfTextPage(
      */
     fun getUnicodeChar(index: Int): Char {
         require(value = index in 0 until charCount) { "Index $index out of bounds [0, $charCount)" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return nativeTextGetUnicode(textPagePtr = textPagePtr, index = index).toChar()
         }
     }
@@ -154,7 +154,7 @@ class PdfTextPage(
      */
     fun getCharBox(index: Int): RectF? {
         require(value = index in 0 until charCount) { "Index $index out of bounds [0, $charCount)" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeTextGetCharBox(textPagePtr = textPagePtr, index = index).let { data ->
                     RectF().apply {
@@ -180,7 +180,7 @@ class PdfTextPage(
      */
     fun getLooseCharBox(index: Int): RectF? {
         require(value = index in 0 until charCount) { "Index $index out of bounds [0, $charCount)" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeTextGetLooseCharBox(textPagePtr = textPagePtr, index = index)
             } catch (e: Exception) {
@@ -203,7 +203,7 @@ class PdfTextPage(
     fun findCharIndexAtPos(x: Double, y: Double, xTolerance: Double, yTolerance: Double): Int {
         require(value = xTolerance >= 0) { "X tolerance cannot be negative" }
         require(value = yTolerance >= 0) { "Y tolerance cannot be negative" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeTextGetCharIndexAtPos(
                     textPagePtr = textPagePtr,
@@ -230,7 +230,7 @@ class PdfTextPage(
     fun countTextRects(startIndex: Int, count: Int): Int {
         require(value = startIndex >= 0) { "Start index cannot be negative" }
         require(value = count > 0) { "Count must be positive" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeTextCountRects(textPagePtr = textPagePtr, startIndex = startIndex, count = count)
             } catch (e: Exception) {
@@ -249,7 +249,7 @@ class PdfTextPage(
      * @throws IllegalStateException if the page or document is closed
      */
     fun getTextRect(rectIndex: Int): RectF? {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeTextGetRect(textPagePtr = textPagePtr, rectIndex = rectIndex).let { data ->
                     RectF().apply {
@@ -275,7 +275,7 @@ class PdfTextPage(
      * @throws IllegalStateException if the page or document is closed
      */
     fun getTextRangeRects(wordRanges: IntArray): List<WordRangeRect>? {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeTextGetRects(textPagePtr = textPagePtr, wordRanges = wordRanges)?.let { data ->
                     List(size = data.size / 6) { i ->
@@ -308,7 +308,7 @@ class PdfTextPage(
      * @throws IllegalStateException if the page or document is closed
      */
     fun extractTextInArea(rect: RectF, length: Int): String? {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 val buffer = ShortArray(size = length + 1)
                 val textRect: Int = nativeTextGetBoundedText(
@@ -345,7 +345,7 @@ class PdfTextPage(
      */
     fun getFontSize(charIndex: Int): Double {
         require(value = charIndex in 0 until charCount) { "Invalid character index" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeGetFontSize(pagePtr = textPagePtr, charIndex = charIndex)
             } catch (e: Exception) {
@@ -366,7 +366,7 @@ class PdfTextPage(
     fun startTextSearch(query: String, flags: Set<FindFlags> = emptySet(), startIndex: Int = 0): FindResult? {
         require(value = query.isNotEmpty()) { "Search query cannot be empty" }
         require(value = startIndex >= 0) { "Start index cannot be negative" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 val flag: Int = flags.fold(initial = 0) { acc, flag -> acc or flag.value }
                 nativeFindStart(
@@ -391,7 +391,7 @@ class PdfTextPage(
      */
     fun getLinkUrl(linkIndex: Int, charCount: Int): String? {
         require(value = linkIndex in 0 until webLinksCount) { "Invalid web link index" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 val buffer = ByteArray(size = charCount * 2)
                 val bytesWritten: Int = nativeGetURL(
@@ -419,7 +419,7 @@ class PdfTextPage(
      */
     fun countRects(linkIndex: Int): Int {
         require(value = linkIndex in 0 until webLinksCount) { "Invalid web link index" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeCountRects(pageLinkPtr = pageLinkPtr, index = linkIndex)
             } catch (e: Exception) {
@@ -439,7 +439,7 @@ class PdfTextPage(
     fun getLinkRect(linkIndex: Int, rectIndex: Int): RectF? {
         require(value = linkIndex in 0 until webLinksCount) { "Invalid web link index" }
         require(value = rectIndex in 0 until countRects(linkIndex)) { "Rect index cannot be negative" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeGetRect(pageLinkPtr = pageLinkPtr, linkIndex = linkIndex, rectIndex = rectIndex).let { data ->
                     RectF().apply {
@@ -464,7 +464,7 @@ class PdfTextPage(
      */
     fun getWebLinkTextRange(linkIndex: Int): Pair<Int, Int>? {
         require(value = linkIndex in 0 until webLinksCount) { "Invalid web link index" }
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             return try {
                 nativeGetTextRange(pageLinkPtr = pageLinkPtr, index = linkIndex).let {
                     if (it.size >= 2) it[0] to it[1] else null
@@ -480,7 +480,7 @@ class PdfTextPage(
      * Close the page and release all resources
      */
     override fun close() {
-        synchronized(lock = PdfiumCore.lock) {
+        PdfiumCore.withLock {
             pageMap[pageIndex]?.let {
                 if (--it.count > 0) return
                 pageMap.remove(key = pageIndex)
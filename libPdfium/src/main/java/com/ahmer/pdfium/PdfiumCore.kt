@@ -1,19 +1,31 @@
 package com.ahmer.pdfium
 
+import android.content.ComponentCallbacks2
 import android.content.Context
+import android.content.res.Configuration
 import android.graphics.Bitmap
 import android.graphics.Point
 import android.graphics.PointF
 import android.graphics.Rect
 import android.graphics.RectF
+import android.os.Handler
+import android.os.HandlerThread
 import android.os.ParcelFileDescriptor
 import android.util.Log
+import android.view.KeyEvent
 import android.view.Surface
+import androidx.core.graphics.createBitmap
 import com.ahmer.pdfium.util.Size
 import com.ahmer.pdfium.util.SizeF
 import dalvik.annotation.optimization.FastNative
 import java.io.Closeable
+import java.io.File
 import java.io.IOException
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.concurrent.atomic.AtomicBoolean
+import java.util.concurrent.atomic.AtomicLong
+import kotlin.math.roundToInt
 
 /**
  * Core PDF processing class handling document operations, rendering, and coordinate transformations.
@@ -23,11 +35,12 @@ import java.io.IOException
 class PdfiumCore(
     val context: Context
 ) : Closeable {
-    private val doc: PdfDocument = PdfDocument()
+    private var doc: PdfDocument = PdfDocument()
     private var currentDpi: Int = 0
 
     init {
         currentDpi = context.resources?.displayMetrics?.densityDpi ?: -1
+        registerContext(context = context)
         Log.d(TAG, "Starting AhmerPdfium...")
     }
 
@@ -47,12 +60,34 @@ class PdfiumCore(
     @Throws(IOException::class)
     fun newDocument(parcelFileDescriptor: ParcelFileDescriptor, password: String? = null): PdfDocument {
         doc.fileDescriptor = parcelFileDescriptor
-        synchronized(lock = lock) {
+        cancelLibraryRelease()
+        withLock {
             doc.nativePtr = nativeOpenDocument(parcelFileDescriptor = parcelFileDescriptor.fd, password = password)
         }
         return doc
     }
 
+    /**
+     * Opens a new PDF document from a file, adopting the document prepared by [warmUp] when it matches.
+     *
+     * @param file The PDF file
+     * @param password Optional password for protected documents
+     * @return The opened PDF document
+     * @throws IOException If the document cannot be opened
+     */
+    @Throws(IOException::class)
+    fun newDocument(file: File, password: String? = null): PdfDocument {
+        takePreparedDocument(file = file, password = password)?.let { prepared: PdfDocument ->
+            cancelLibraryRelease()
+            doc = prepared
+            return prepared
+        }
+        return newDocument(
+            parcelFileDescriptor = ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY),
+            password = password
+        )
+    }
+
     /**
      * Opens a new PDF document from a byte array
      *
@@ -64,7 +99,8 @@ class PdfiumCore(
      */
     @Throws(IOException::class)
     fun newDocument(data: ByteArray, password: String? = null): PdfDocument {
-        synchronized(lock = lock) {
+        cancelLibraryRelease()
+        withLock {
             doc.nativePtr = nativeOpenMemDocument(data = data, password = password)
         }
         return doc
@@ -79,6 +115,28 @@ class PdfiumCore(
      */
     fun openTextPage(pageIndex: Int): PdfTextPage = doc.openTextPage(pageIndex = pageIndex)
 
+    /**
+     * Opens a page, or takes another reference on it if it is already open
+     *
+     * @param pageIndex Index of the page to open
+     * @return Native page pointer
+     */
+    fun openPage(pageIndex: Int): Long = doc.openPage(pageIndex = pageIndex)
+
+    /**
+     * Releases a reference taken with [openPage]. The page is closed once every reference is released.
+     *
+     * @param pageIndex Index of the page to release
+     */
+    fun closePage(pageIndex: Int) {
+        withLock {
+            val page: PdfDocument.PageCount = doc.pageCache[pageIndex] ?: return
+            if (--page.count > 0) return
+            doc.pageCache.remove(key = pageIndex)
+            nativeClosePage(pagePtr = page.pagePtr)
+        }
+    }
+
     /**
      * Gets page width in pixels at current DPI
      *
@@ -86,7 +144,7 @@ class PdfiumCore(
      * @return Page width in pixels or -1 if closed
      */
     fun getPageWidthPixel(pageIndex: Int): Int {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageWidthPixel(pagePtr = pagePtr(index = pageIndex), dpi = currentDpi)
         }
     }
@@ -98,7 +156,7 @@ class PdfiumCore(
      * @return Page height in pixels or -1 if closed
      */
     fun getPageHeightPixel(pageIndex: Int): Int {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageHeightPixel(pagePtr = pagePtr(index = pageIndex), dpi = currentDpi)
         }
     }
@@ -110,7 +168,7 @@ class PdfiumCore(
      * @return Page width in points or -1 if closed
      */
     fun getPageWidthPoint(pageIndex: Int): Int {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageWidthPoint(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -122,7 +180,7 @@ class PdfiumCore(
      * @return Page height in pixels or -1 if closed
      */
     fun getPageHeightPoint(pageIndex: Int): Int {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageHeightPoint(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -140,7 +198,7 @@ class PdfiumCore(
      * @throws IllegalStateException If document is closed
      */
     fun pageRotation(pageIndex: Int): Int {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageRotation(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -152,7 +210,7 @@ class PdfiumCore(
      * @return RectF containing left, top, right, bottom coordinates, or null if not available
      */
     fun getPageMediaBox(pageIndex: Int): RectF? {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageMediaBox(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -164,7 +222,7 @@ class PdfiumCore(
      * @return RectF containing left, top, right, bottom coordinates, or null if not available
      */
     fun getPageCropBox(pageIndex: Int): RectF? {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageCropBox(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -176,7 +234,7 @@ class PdfiumCore(
      * @return RectF containing left, top, right, bottom coordinates, or null if not available
      */
     fun getPageBleedBox(pageIndex: Int): RectF? {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageBleedBox(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -188,7 +246,7 @@ class PdfiumCore(
      * @return RectF containing left, top, right, bottom coordinates, or null if not available
      */
     fun getPageTrimBox(pageIndex: Int): RectF? {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageTrimBox(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -200,7 +258,7 @@ class PdfiumCore(
      * @return RectF containing left, top, right, bottom coordinates, or null if not available
      */
     fun getPageArtBox(pageIndex: Int): RectF? {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageArtBox(pagePtr = pagePtr(index = pageIndex))
         }
     }
@@ -213,7 +271,7 @@ class PdfiumCore(
      * @throws IllegalStateException If document is closed.
      */
     fun getPageSize(pageIndex: Int): Size {
-        synchronized(lock = lock) {
+        withLock {
             return nativeGetPageSizeByIndex(docPtr = doc.nativePtr, pageIndex = pageIndex, dpi = currentDpi)
         }
     }
@@ -227,7 +285,7 @@ class PdfiumCore(
         drawSizeY: Int,
         annotation: Boolean = false,
     ) {
-        synchronized(lock) {
+        withLock {
             try {
                 nativeRenderPage(
                     pagePtr = pagePtr(index = pageIndex),
@@ -249,16 +307,230 @@ class PdfiumCore(
     }
 
 
+    /**
+     * Native memory held for the current document, see [NativeMemoryUsage]. Use [getNativeMemoryUsage]
+     * for all open documents together.
+     *
+     * @return The usage of the document, [NativeMemoryUsage.EMPTY] once it is closed
+     */
+    fun getDocumentMemoryUsage(): NativeMemoryUsage {
+        withLock {
+            // A null document makes the native snapshot return the totals of all documents
+            val docPtr: Long = doc.nativePtr
+            if (docPtr == 0L) return NativeMemoryUsage.EMPTY
+            return NativeMemoryUsage.fromSnapshot(values = nativeGetMemoryUsage(docPtr = docPtr))
+        }
+    }
+
+    /**
+     * Collects the content statistics of a page without keeping it open.
+     *
+     * @param pageIndex Index of the page
+     * @return [PageComplexity] of the page, [PageComplexity.EMPTY] if it cannot be loaded
+     */
+    fun getPageComplexity(pageIndex: Int): PageComplexity {
+        withLock {
+            val counters: LongArray = nativeGetPageComplexity(docPtr = doc.nativePtr, pageIndex = pageIndex)
+            return PageComplexity(
+                objectCount = counters[0].toInt(),
+                textCount = counters[1].toInt(),
+                imageCount = counters[2].toInt(),
+                imagePixels = counters[3],
+                pathSegments = counters[4],
+                transparentCount = counters[5].toInt(),
+                shadingCount = counters[6].toInt()
+            )
+        }
+    }
+
+    /**
+     * Lists the image objects placed directly on a page, without rendering it. Images nested in form
+     * XObjects are not listed.
+     *
+     * @param pageIndex Index of the page, the page must be open
+     * @param minWidth Minimum width in pixels of the listed images
+     * @param minHeight Minimum height in pixels of the listed images
+     * @return Images of the page, in drawing order
+     */
+    fun getPageImages(pageIndex: Int, minWidth: Int = 0, minHeight: Int = 0): List<PdfImageInfo> {
+        withLock {
+            val pagePtr: Long = pagePtr(index = pageIndex)
+            val values: DoubleArray = nativeGetPageImages(pagePtr = pagePtr, minWidth = minWidth, minHeight = minHeight)
+            return List(size = values.size / IMAGE_INFO_SIZE) { i ->
+                val offset: Int = i * IMAGE_INFO_SIZE
+                val objectIndex: Int = values[offset].toInt()
+                PdfImageInfo(
+                    pageIndex = pageIndex,
+                    objectIndex = objectIndex,
+                    width = values[offset + 1].toInt(),
+                    height = values[offset + 2].toInt(),
+                    bitsPerPixel = values[offset + 3].toInt(),
+                    colorSpace = values[offset + 4].toInt(),
+                    rawSize = values[offset + 5].toLong(),
+                    filters = nativeGetImageFilters(pagePtr = pagePtr, objectIndex = objectIndex)
+                        ?.split(',')?.filter { it.isNotEmpty() }.orEmpty(),
+                    bounds = RectF(
+                        values[offset + 6].toFloat(),
+                        values[offset + 9].toFloat(),
+                        values[offset + 8].toFloat(),
+                        values[offset + 7].toFloat()
+                    ),
+                )
+            }
+        }
+    }
+
+    /**
+     * Detects a scanned page: a single upright image covering the crop box, with no other content
+     * and no annotations.
+     *
+     * @param pageIndex Index of the page, the page must be open
+     * @return The page image and its placement, or null if the page is not a scan
+     */
+    fun getScannedPage(pageIndex: Int): ScannedPage? {
+        withLock {
+            val scan: FloatArray = nativeGetScanImage(pagePtr = pagePtr(index = pageIndex)) ?: return null
+            val image: PdfImageInfo = getPageImages(pageIndex = pageIndex).firstOrNull {
+                it.objectIndex == scan[0].toInt()
+            } ?: return null
+            return ScannedPage(image = image, placement = RectF(scan[1], scan[2], scan[3], scan[4]))
+        }
+    }
+
+    /**
+     * Reads the encoded data of an image as stored in the document, e.g. a JPEG file for
+     * [PdfImageInfo.isJpeg] images.
+     *
+     * @param image Image listed by [getPageImages], its page must be open
+     * @return Encoded data, or null if the image has none
+     */
+    fun getImageData(image: PdfImageInfo): ByteArray? {
+        withLock {
+            return nativeGetImageRaw(pagePtr = pagePtr(index = image.pageIndex), objectIndex = image.objectIndex)
+        }
+    }
+
+    /**
+     * Streams the encoded data of an image to a file descriptor
+     *
+     * @param image Image listed by [getPageImages], its page must be open
+     * @param output Destination, written from its current position and left open
+     * @return Number of bytes written, or -1 on failure
+     */
+    fun writeImageData(image: PdfImageInfo, output: ParcelFileDescriptor): Long {
+        withLock {
+            return nativeWriteImageRaw(
+                docPtr = doc.nativePtr,
+                pagePtr = pagePtr(index = image.pageIndex),
+                objectIndex = image.objectIndex,
+                outputFd = output.fd,
+            )
+        }
+    }
+
+    /**
+     * Decodes the pixels of an image, ignoring its mask and its placement on the page
+     *
+     * @param image Image listed by [getPageImages], its page must be open
+     * @param sampleSize Averages blocks of sampleSize by sampleSize pixels, so that only the reduced image
+     * is allocated on the Java heap
+     * @return ARGB_8888 bitmap of [PdfImageInfo.width] by [PdfImageInfo.height] pixels divided by
+     * [sampleSize], or null if the image cannot be decoded
+     */
+    fun getImageBitmap(image: PdfImageInfo, sampleSize: Int = 1): Bitmap? {
+        require(value = sampleSize >= 1) { "sampleSize must be at least 1" }
+        val bitmap: Bitmap = createBitmap(
+            width = (image.width / sampleSize).coerceAtLeast(minimumValue = 1),
+            height = (image.height / sampleSize).coerceAtLeast(minimumValue = 1),
+            config = Bitmap.Config.ARGB_8888,
+        )
+        val decoded: Boolean = withLock {
+            nativeGetImageBitmap(
+                pagePtr = pagePtr(index = image.pageIndex),
+                objectIndex = image.objectIndex,
+                bitmap = bitmap,
+                sampleSize = sampleSize,
+            )
+        }
+        if (decoded) return bitmap
+        bitmap.recycle()
+        return null
+    }
+
+    /**
+     * Visits the images of a page range, opening each page only while its images are visited. [block]
+     * can read the image with [getImageData], [writeImageData] or [getImageBitmap].
+     *
+     * @param pages Indexes of the pages to scan
+     * @param minWidth Minimum width in pixels of the visited images
+     * @param minHeight Minimum height in pixels of the visited images
+     * @param block Called for each image, return false to stop
+     */
+    fun forEachImage(
+        pages: IntRange,
+        minWidth: Int = 0,
+        minHeight: Int = 0,
+        block: (image: PdfImageInfo) -> Boolean,
+    ) {
+        for (pageIndex in pages) {
+            openPage(pageIndex = pageIndex)
+            try {
+                val images: List<PdfImageInfo> = getPageImages(
+                    pageIndex = pageIndex,
+                    minWidth = minWidth,
+                    minHeight = minHeight
+                )
+                for (image in images) if (!block(image)) return
+            } finally {
+                closePage(pageIndex = pageIndex)
+            }
+        }
+    }
+
+    /**
+     * Classifies the colors used by a page, so callers can pick the smallest bitmap format able to hold it.
+     *
+     * @param pageIndex Index of the page
+     * @param annotation Whether annotations will be rendered too
+     * @return [PAGE_COLOR_GRAY], [PAGE_COLOR_OPAQUE] or [PAGE_COLOR_TRANSPARENT]
+     */
+    fun getPageColorClass(pageIndex: Int, annotation: Boolean = false): Int {
+        withLock {
+            return nativeGetPageColorClass(pagePtr = pagePtr(index = pageIndex), annotation = annotation)
+        }
+    }
+
+    /**
+     * Finds the area of a page that holds content, ignoring blank margins. Object bounds are used for
+     * regular pages; pages dominated by a single image (scans) are measured from a low resolution render.
+     *
+     * @param pageIndex Index of the page
+     * @return Content bounds relative to the displayed page size (0..1, rotation applied). The whole page
+     * when it is blank or cropping would gain little
+     */
+    fun getPageContentBounds(pageIndex: Int): RectF {
+        withLock {
+            val bounds: FloatArray = nativeGetPageContentBounds(docPtr = doc.nativePtr, pageIndex = pageIndex)
+            return RectF(bounds[0], bounds[1], bounds[2], bounds[3])
+        }
+    }
+
     /**
      * Renders PDF page to a Bitmap
      *
      * @param pageIndex Page index to render
-     * @param bitmap Target bitmap for rendering
+     * @param bitmap Target bitmap for rendering: ARGB_8888, RGB_565 or ALPHA_8. An ALPHA_8 bitmap receives
+     * the ink coverage (255 - gray level) of the page
      * @param startX X starting position in pixels
      * @param startY Y starting position in pixels
      * @param drawSizeX Horizontal draw size in pixels
      * @param drawSizeY Vertical draw size in pixels
      * @param annotation Whether to render annotations
+     * @param forms Whether to render form fields with the annotations. To draw the annotations on a
+     * separate layer with [renderAnnotationLayer], pass false for both
+     * @param budgetMs Time budget for the render, or 0 for no limit. When it is exceeded the page is
+     * drawn as a low resolution draft instead
+     * @return [RENDER_STATUS_COMPLETE], [RENDER_STATUS_DRAFT] or [RENDER_STATUS_FAILED]
      */
     fun renderPageBitmap(
         pageIndex: Int,
@@ -268,8 +540,10 @@ class PdfiumCore(
         drawSizeX: Int,
         drawSizeY: Int,
         annotation: Boolean = false,
-    ) {
-        synchronized(lock = lock) {
+        forms: Boolean = true,
+        budgetMs: Long = 0L,
+    ): Int {
+        withLock {
             return nativeRenderPageBitmap(
                 docPtr = doc.nativePtr,
                 pagePtr = pagePtr(index = pageIndex),
@@ -279,6 +553,395 @@ class PdfiumCore(
                 drawSizeHor = drawSizeX,
                 drawSizeVer = drawSizeY,
                 annotation = annotation,
+                forms = forms,
+                budgetMs = budgetMs,
+            )
+        }
+    }
+
+    /**
+     * Renders the annotations and form fields of a page over a transparent background, as a layer to
+     * composite over the page rendered with `annotation = false`. Filling a field, editing an annotation or
+     * hiding the annotations then leaves the page content untouched.
+     *
+     * @param pageIndex Page index to render
+     * @param bitmap Target bitmap, ARGB_8888
+     * @param startX X starting position in pixels
+     * @param startY Y starting position in pixels
+     * @param drawSizeX Horizontal draw size in pixels
+     * @param drawSizeY Vertical draw size in pixels
+     * @return [RENDER_STATUS_COMPLETE] or [RENDER_STATUS_FAILED]
+     */
+    fun renderAnnotationLayer(
+        pageIndex: Int,
+        bitmap: Bitmap,
+        startX: Int,
+        startY: Int,
+        drawSizeX: Int,
+        drawSizeY: Int,
+    ): Int {
+        withLock {
+            return nativeRenderAnnotationLayer(
+                docPtr = doc.nativePtr,
+                pagePtr = pagePtr(index = pageIndex),
+                pageIndex = pageIndex,
+                bitmap = bitmap,
+                startX = startX,
+                startY = startY,
+                drawSizeHor = drawSizeX,
+                drawSizeVer = drawSizeY,
+            )
+        }
+    }
+
+    /**
+     * Areas of a page drawn by [renderAnnotationLayer], the rects of its visible annotations. Parts of the
+     * page outside of them have an empty layer.
+     *
+     * @param pageIndex Page index, the page must be open
+     * @return Rects in page coordinates: top is above bottom
+     */
+    fun getAnnotationLayerRects(pageIndex: Int): List<RectF> {
+        withLock {
+            val values: FloatArray = nativeGetAnnotationLayerRects(pagePtr = pagePtr(index = pageIndex))
+            return List(size = values.size / 4) { i ->
+                RectF(values[i * 4], values[i * 4 + 1], values[i * 4 + 2], values[i * 4 + 3])
+            }
+        }
+    }
+
+    /**
+     * Forwards a touch to the form fields of a page. The first call starts interactive form filling: the
+     * document keeps a form environment holding the focused field, its caret and the typed text, and
+     * renders draw the fields from it. Repainted areas are collected for [takeFormDirtyRects].
+     *
+     * @param pageIndex Page index, the page must be open
+     * @param action [FORM_TOUCH_DOWN], [FORM_TOUCH_UP] or [FORM_TOUCH_MOVE]
+     * @param pageX X position in page coordinates, see [mapDeviceCoordsToPage]
+     * @param pageY Y position in page coordinates
+     * @return Whether a form field handled the touch
+     */
+    fun onFormTouch(pageIndex: Int, action: Int, pageX: Double, pageY: Double): Boolean {
+        withLock {
+            return nativeFormTouch(
+                docPtr = doc.nativePtr,
+                pagePtr = pagePtr(index = pageIndex),
+                action = action,
+                pageX = pageX,
+                pageY = pageY
+            )
+        }
+    }
+
+    /**
+     * Forwards an editing key (delete, arrows, home, end, enter, tab) to the focused form field.
+     * Printable characters go through [onFormChar].
+     *
+     * @param pageIndex Page index of the focused field
+     * @param keyCode Android key code, see [android.view.KeyEvent]
+     * @param metaState Android meta state of the key event
+     * @param isDown Whether the key is pressed or released
+     * @return Whether the focused field handled the key
+     */
+    fun onFormKey(pageIndex: Int, keyCode: Int, metaState: Int, isDown: Boolean): Boolean {
+        val formKeyCode: Int = toFormKeyCode(keyCode = keyCode) ?: return false
+        val modifiers: Int = toFormModifiers(metaState = metaState)
+        withLock {
+            val pagePtr: Long = pagePtr(index = pageIndex)
+            var isHandled: Boolean = nativeFormKey(
+                docPtr = doc.nativePtr,
+                pagePtr = pagePtr,
+                keyCode = formKeyCode,
+                modifiers = modifiers,
+                isDown = isDown
+            )
+            // PDFium edits on characters: backspace and enter are also sent as such
+            if (isDown && (formKeyCode == FORM_KEY_BACK || formKeyCode == FORM_KEY_RETURN)) {
+                isHandled = nativeFormChar(
+                    docPtr = doc.nativePtr,
+                    pagePtr = pagePtr,
+                    charCode = formKeyCode,
+                    modifiers = modifiers
+                ) || isHandled
+            }
+            return isHandled
+        }
+    }
+
+    /**
+     * Types a character into the focused form field
+     *
+     * @param pageIndex Page index of the focused field
+     * @param charCode UTF-16 code unit to type
+     * @param metaState Android meta state of the key event, if any
+     * @return Whether the focused field handled the character
+     */
+    fun onFormChar(pageIndex: Int, charCode: Int, metaState: Int = 0): Boolean {
+        withLock {
+            return nativeFormChar(
+                docPtr = doc.nativePtr,
+                pagePtr = pagePtr(index = pageIndex),
+                charCode = charCode,
+                modifiers = toFormModifiers(metaState = metaState)
+            )
+        }
+    }
+
+    /**
+     * Removes the focus from the focused form field, committing its value to the document
+     *
+     * @return Whether a field had the focus
+     */
+    fun killFormFocus(): Boolean {
+        withLock {
+            return nativeFormKillFocus(docPtr = doc.nativePtr)
+        }
+    }
+
+    /**
+     * Type of the focused form field, e.g. [FORM_FIELD_TEXT] or [FORM_FIELD_COMBOBOX], or -1 if no
+     * field has the focus
+     */
+    fun getFocusedFormFieldType(): Int {
+        withLock {
+            return nativeGetFocusedFormFieldType(docPtr = doc.nativePtr)
+        }
+    }
+
+    /**
+     * Reads every form field widget of a page, or of the whole document, in a single native call. Pages
+     * do not need to be open.
+     *
+     * @param pageIndex Index of the page, or [ALL_PAGES]
+     * @return Widgets in page then annotation order
+     */
+    fun getFormFields(pageIndex: Int = ALL_PAGES): List<PdfFormField> {
+        val buffer: ByteBuffer = withLock {
+            val (openIndices: IntArray, openPtrs: LongArray) = openPages()
+            val bytes: ByteArray = nativeGetFormFields(
+                docPtr = doc.nativePtr,
+                pageIndex = pageIndex,
+                openIndices = openIndices,
+                openPtrs = openPtrs
+            ) ?: return emptyList()
+            ByteBuffer.wrap(bytes).order(ByteOrder.nativeOrder())
+        }
+        return List(size = buffer.getInt()) {
+            PdfFormField(
+                pageIndex = buffer.getInt(),
+                annotationIndex = buffer.getInt(),
+                type = buffer.getInt(),
+                flags = buffer.getInt(),
+                isChecked = buffer.getInt() != 0,
+                bounds = RectF(buffer.getFloat(), buffer.getFloat(), buffer.getFloat(), buffer.getFloat()),
+                name = buffer.getWideString(),
+                value = buffer.getWideString(),
+                exportValue = buffer.getWideString(),
+                options = List(size = buffer.getInt()) {
+                    PdfFormField.Option(label = buffer.getWideString(), isSelected = buffer.getInt() != 0)
+                }
+            )
+        }
+    }
+
+    /**
+     * Fills many form fields in a single walk of the document. Values are applied like typed input, so
+     * the appearance of each field is regenerated once, when it is committed. Check boxes and radio
+     * buttons are checked by their export value, a lone check box by any value but
+     * [PdfFormField.VALUE_OFF]; combo and list boxes select the option with the value as label.
+     * Read-only fields are skipped. Shown pages must be rendered again afterwards.
+     *
+     * @param values Values by fully qualified field name
+     * @return Number of fields that were set
+     */
+    fun setFormFieldValues(values: Map<String, String>): Int {
+        if (values.isEmpty()) return 0
+        withLock {
+            val (openIndices: IntArray, openPtrs: LongArray) = openPages()
+            return nativeSetFormFieldValues(
+                docPtr = doc.nativePtr,
+                openIndices = openIndices,
+                openPtrs = openPtrs,
+                names = values.keys.toTypedArray(),
+                values = values.values.toTypedArray()
+            )
+        }
+    }
+
+    /**
+     * Whether the document is tagged, i.e. has a structure tree giving its reading order
+     */
+    fun isTagged(): Boolean {
+        withLock {
+            return nativeIsTagged(docPtr = doc.nativePtr)
+        }
+    }
+
+    /**
+     * Reads the structure tree of a tagged page into blocks in reading order: headings, paragraphs,
+     * list items, table cells and figures. Text comes from the marked content of each block, so running
+     * headers and other artifacts are left out. Render the figures with [renderPageRegion].
+     *
+     * @param pageIndex Page index, the page must be open
+     * @return The blocks, or null when the page has no structure tree
+     */
+    fun getReflowBlocks(pageIndex: Int): List<PdfReflowBlock>? {
+        val buffer: ByteBuffer = withLock {
+            val bytes: ByteArray = nativeGetReflowBlocks(pagePtr = pagePtr(index = pageIndex)) ?: return null
+            ByteBuffer.wrap(bytes).order(ByteOrder.nativeOrder())
+        }
+        return List(size = buffer.getInt()) {
+            PdfReflowBlock(
+                type = buffer.getInt(),
+                level = buffer.getInt(),
+                bounds = RectF(buffer.getFloat(), buffer.getFloat(), buffer.getFloat(), buffer.getFloat()),
+                fontSize = buffer.getFloat(),
+                fontWeight = buffer.getInt(),
+                text = buffer.getWideString(),
+                altText = buffer.getWideString()
+            )
+        }
+    }
+
+    /**
+     * Renders a region of a page so that it fills the width of [bitmap], e.g. a figure of
+     * [getReflowBlocks]. Only the region is rasterized, the rest of the page is clipped away.
+     *
+     * @param pageIndex Page index to render, the page must be open
+     * @param region Region in page coordinates: top is above bottom
+     * @param bitmap Target bitmap, its height should follow the aspect ratio of the region
+     * @param annotation Whether to render annotations
+     * @return [RENDER_STATUS_COMPLETE], [RENDER_STATUS_DRAFT] or [RENDER_STATUS_FAILED]
+     */
+    fun renderPageRegion(pageIndex: Int, region: RectF, bitmap: Bitmap, annotation: Boolean = false): Int {
+        val pageWidth: Int = getPageWidthPoint(pageIndex = pageIndex)
+        val pageHeight: Int = getPageHeightPoint(pageIndex = pageIndex)
+        if (pageWidth <= 0 || pageHeight <= 0) return RENDER_STATUS_FAILED
+        // Mapped at a finer scale than points, device coordinates are whole numbers
+        val device: RectF = mapRectToDevice(
+            pageIndex = pageIndex,
+            startX = 0,
+            startY = 0,
+            sizeX = pageWidth * REGION_MAP_SCALE,
+            sizeY = pageHeight * REGION_MAP_SCALE,
+            rotate = 0,
+            coords = region
+        ).apply { sort() }
+        if (device.isEmpty) return RENDER_STATUS_FAILED
+        val scale: Float = bitmap.width / device.width()
+        return renderPageBitmap(
+            pageIndex = pageIndex,
+            bitmap = bitmap,
+            startX = -(device.left * scale).roundToInt(),
+            startY = -(device.top * scale).roundToInt(),
+            drawSizeX = (pageWidth * REGION_MAP_SCALE * scale).roundToInt(),
+            drawSizeY = (pageHeight * REGION_MAP_SCALE * scale).roundToInt(),
+            annotation = annotation
+        )
+    }
+
+    private fun openPages(): Pair<IntArray, LongArray> {
+        val pages: List<Map.Entry<Int, PdfDocument.PageCount>> = doc.pageCache.entries.toList()
+        return IntArray(size = pages.size) { pages[it].key } to LongArray(size = pages.size) { pages[it].value.pagePtr }
+    }
+
+    private fun ByteBuffer.getWideString(): String {
+        val length: Int = getInt()
+        return String(CharArray(size = length) { getChar() })
+    }
+
+    /**
+     * Returns and clears the areas repainted by the form fields since the last call, after touches, keys
+     * or characters were forwarded to them. Only the layer of those areas needs to be rendered again.
+     *
+     * @return Repainted areas by page index, in page coordinates: top is above bottom
+     */
+    fun takeFormDirtyRects(): Map<Int, List<RectF>> {
+        withLock {
+            val pages: List<Map.Entry<Int, PdfDocument.PageCount>> = doc.pageCache.entries.toList()
+            val values: FloatArray = nativeTakeFormDirtyRects(
+                docPtr = doc.nativePtr,
+                pagePtrs = LongArray(size = pages.size) { pages[it].value.pagePtr }
+            )
+            val dirtyRects: MutableMap<Int, MutableList<RectF>> = mutableMapOf()
+            for (i in values.indices step FORM_DIRTY_RECT_SIZE) {
+                dirtyRects.getOrPut(key = pages[values[i].toInt()].key) { mutableListOf() }
+                    .add(RectF(values[i + 1], values[i + 2], values[i + 3], values[i + 4]))
+            }
+            return dirtyRects
+        }
+    }
+
+    /**
+     * Renders a page in horizontal bands through a single reusable strip, for sizes whose full bitmap
+     * cannot be allocated (large formats at print resolution). Memory stays bounded by [maxBandBytes]
+     * whatever the page size or resolution. The lock is released between bands, while [sink] consumes them.
+     *
+     * @param pageIndex Page index to render, the page must be open
+     * @param width Width of the rendered page in pixels
+     * @param height Height of the rendered page in pixels
+     * @param maxBandBytes Size budget of the strip, at least one row is always rendered
+     * @param annotation Whether to render annotations and form fields, with the values being filled in
+     * @param sink Receives the bands from top to bottom
+     * @return Whether every band was rendered and accepted by [sink]
+     */
+    fun renderPageBanded(
+        pageIndex: Int,
+        width: Int,
+        height: Int,
+        maxBandBytes: Int = DEFAULT_BAND_BYTES,
+        annotation: Boolean = false,
+        sink: PageBandSink,
+    ): Boolean {
+        require(value = width > 0 && height > 0) { "Page size must be positive" }
+        val bandHeight: Int = (maxBandBytes / (width * 4L)).toInt().coerceIn(minimumValue = 1, maximumValue = height)
+        val strip: Bitmap = createBitmap(width = width, height = bandHeight, config = Bitmap.Config.ARGB_8888)
+        // One form environment draws the form fields of every band
+        val formPtr: Long = if (!annotation) 0L else withLock {
+            nativeOpenBandForm(docPtr = doc.nativePtr, pagePtr = pagePtr(index = pageIndex))
+        }
+        try {
+            var top = 0
+            while (top < height) {
+                val rows: Int = minOf(a = bandHeight, b = height - top)
+                val status: Int = withLock {
+                    nativeRenderPageBand(
+                        pagePtr = pagePtr(index = pageIndex),
+                        formPtr = formPtr,
+                        bitmap = strip,
+                        pageHeight = height,
+                        bandTop = top,
+                        bandHeight = rows,
+                        annotation = annotation,
+                    )
+                }
+                if (status == RENDER_STATUS_FAILED || !sink.onBand(strip = strip, top = top, height = rows)) return false
+                top += rows
+            }
+            return true
+        } finally {
+            strip.recycle()
+            if (formPtr != 0L) withLock { nativeCloseBandForm(formPtr = formPtr) }
+        }
+    }
+
+    /**
+     * Renders an overview sheet: [layout] pages starting at [firstPage], scaled into a grid and drawn
+     * in a single render instead of one render per page. Pages do not need to be open.
+     *
+     * @param firstPage Index of the first page on the sheet
+     * @param layout Grid of pages on the sheet
+     * @param bitmap ARGB_8888 target, its size is the size of the sheet
+     * @return [RENDER_STATUS_COMPLETE] or [RENDER_STATUS_FAILED]
+     */
+    fun renderOverviewSheet(firstPage: Int, layout: NUpLayout, bitmap: Bitmap): Int {
+        withLock {
+            return nativeRenderOverviewSheet(
+                docPtr = doc.nativePtr,
+                firstPage = firstPage,
+                columns = layout.columns,
+                rows = layout.rows,
+                bitmap = bitmap,
             )
         }
     }
@@ -293,7 +956,7 @@ class PdfiumCore(
      * @return List of detected [PdfDocument.Link] objects
      */
     fun getPageLinks(pageIndex: Int, size: SizeF, posX: Float, posY: Float): List<PdfDocument.Link> {
-        synchronized(lock = lock) {
+        withLock {
             val pagePtr: Long = pagePtr(index = pageIndex)
             return nativeGetPageLinks(pagePtr = pagePtr)
                 .toList()
@@ -514,6 +1177,375 @@ class PdfiumCore(
         val lock: Any = Any()
         val TAG: String = PdfiumCore::class.java.name
 
+        /** The page was fully rendered. */
+        const val RENDER_STATUS_COMPLETE: Int = 0
+
+        /** The render budget was exceeded and a low resolution draft was drawn instead. */
+        const val RENDER_STATUS_DRAFT: Int = 1
+
+        /** Nothing was rendered. */
+        const val RENDER_STATUS_FAILED: Int = -1
+
+        /** Default strip budget of [renderPageBanded], 8 MB. */
+        const val DEFAULT_BAND_BYTES: Int = 8 * 1024 * 1024
+
+        /** Only gray levels, fits an ALPHA_8 bitmap. */
+        const val PAGE_COLOR_GRAY: Int = 0
+
+        /** Opaque color content, fits an RGB_565 bitmap. */
+        const val PAGE_COLOR_OPAQUE: Int = 1
+
+        /** Transparency groups or blending that need an ARGB_8888 bitmap. */
+        const val PAGE_COLOR_TRANSPARENT: Int = 2
+
+        /** Values per image of the native image list. */
+        private const val IMAGE_INFO_SIZE: Int = 10
+
+        /** Device size of a point when [renderPageRegion] locates its region. */
+        private const val REGION_MAP_SCALE: Int = 100
+
+        /** Page index of [getFormFields] reading the whole document. */
+        const val ALL_PAGES: Int = -1
+
+        /** Touch actions of [onFormTouch]. */
+        const val FORM_TOUCH_DOWN: Int = 0
+        const val FORM_TOUCH_UP: Int = 1
+        const val FORM_TOUCH_MOVE: Int = 2
+
+        /** Form field types returned by [getFocusedFormFieldType]. */
+        const val FORM_FIELD_COMBOBOX: Int = 4
+        const val FORM_FIELD_TEXT: Int = 6
+
+        /** Values per area of the native dirty area list. */
+        private const val FORM_DIRTY_RECT_SIZE: Int = 5
+
+        /** PDFium virtual key codes and modifier flags, see fpdf_fwlevent.h. */
+        private const val FORM_KEY_BACK: Int = 0x08
+        private const val FORM_KEY_TAB: Int = 0x09
+        private const val FORM_KEY_RETURN: Int = 0x0D
+        private const val FORM_KEY_END: Int = 0x23
+        private const val FORM_KEY_HOME: Int = 0x24
+        private const val FORM_KEY_LEFT: Int = 0x25
+        private const val FORM_KEY_UP: Int = 0x26
+        private const val FORM_KEY_RIGHT: Int = 0x27
+        private const val FORM_KEY_DOWN: Int = 0x28
+        private const val FORM_KEY_DELETE: Int = 0x2E
+        private const val FORM_FLAG_SHIFT: Int = 1 shl 0
+        private const val FORM_FLAG_CONTROL: Int = 1 shl 1
+        private const val FORM_FLAG_ALT: Int = 1 shl 2
+
+        private fun toFormKeyCode(keyCode: Int): Int? = when (keyCode) {
+            KeyEvent.KEYCODE_DEL -> FORM_KEY_BACK
+            KeyEvent.KEYCODE_TAB -> FORM_KEY_TAB
+            KeyEvent.KEYCODE_ENTER, KeyEvent.KEYCODE_NUMPAD_ENTER -> FORM_KEY_RETURN
+            KeyEvent.KEYCODE_MOVE_END -> FORM_KEY_END
+            KeyEvent.KEYCODE_MOVE_HOME -> FORM_KEY_HOME
+            KeyEvent.KEYCODE_DPAD_LEFT -> FORM_KEY_LEFT
+            KeyEvent.KEYCODE_DPAD_UP -> FORM_KEY_UP
+            KeyEvent.KEYCODE_DPAD_RIGHT -> FORM_KEY_RIGHT
+            KeyEvent.KEYCODE_DPAD_DOWN -> FORM_KEY_DOWN
+            KeyEvent.KEYCODE_FORWARD_DEL -> FORM_KEY_DELETE
+            else -> null
+        }
+
+        private fun toFormModifiers(metaState: Int): Int {
+            var modifiers = 0
+            if (metaState and KeyEvent.META_SHIFT_ON != 0) modifiers = modifiers or FORM_FLAG_SHIFT
+            if (metaState and KeyEvent.META_CTRL_ON != 0) modifiers = modifiers or FORM_FLAG_CONTROL
+            if (metaState and KeyEvent.META_ALT_ON != 0) modifiers = modifiers or FORM_FLAG_ALT
+            return modifiers
+        }
+
+        /** Names of the native counter groups, in the order of the native snapshot. */
+        private val STATS_GROUPS: Array<String> =
+            arrayOf("open", "loadPage", "render", "loadText", "textExtract", "search", "save")
+        private val STATS_VALUES: Array<String> = arrayOf("calls", "totalNanos", "maxNanos", "bytes")
+
+        private val isTrimCallbackRegistered: AtomicBoolean = AtomicBoolean(false)
+        private val lockMaxWaitNanos: AtomicLong = AtomicLong(0L)
+        private val lockWaitNanos: AtomicLong = AtomicLong(0L)
+        private val lockWaits: AtomicLong = AtomicLong(0L)
+        private val keepAliveHandler: Handler by lazy {
+            Handler(HandlerThread("AhmerPdfium-KeepAlive").apply { start() }.looper)
+        }
+        private val releaseLibraryTask: Runnable = Runnable { releaseLibrary() }
+        private var preparedDocument: PreparedDocument? = null
+        private val trimMemoryCallbacks: ComponentCallbacks2 = object : ComponentCallbacks2 {
+            override fun onTrimMemory(level: Int) = PdfiumCore.onTrimMemory(level = level)
+
+            override fun onConfigurationChanged(newConfig: Configuration) {}
+
+            @Deprecated("Deprecated in Java")
+            override fun onLowMemory() = PdfiumCore.onTrimMemory(level = ComponentCallbacks2.TRIM_MEMORY_COMPLETE)
+        }
+
+        /**
+         * Whether the native performance counters were compiled in (CMake option PDFIUM_JNI_STATS,
+         * on for debug builds). When false, [getStats] is empty and [lock] waits are not timed.
+         */
+        val isStatsEnabled: Boolean by lazy { nativeGetStats() != null }
+
+        /**
+         * Runs [block] holding [lock]. The wait for the lock is timed once: counted when [isStatsEnabled]
+         * and passed to [onAcquired], e.g. to trace it. Nested calls from the thread holding the lock
+         * do not wait and are not counted.
+         */
+        inline fun <T> withLock(noinline onAcquired: ((waitNanos: Long) -> Unit)? = null, block: () -> T): T {
+            if (Thread.holdsLock(lock)) {
+                onAcquired?.invoke(0L)
+                return block()
+            }
+            if (!isStatsEnabled && onAcquired == null) return synchronized(lock = lock, block = block)
+            val waitStart: Long = System.nanoTime()
+            return synchronized(lock = lock) {
+                val waitNanos: Long = System.nanoTime() - waitStart
+                if (isStatsEnabled) recordLockWait(nanos = waitNanos)
+                onAcquired?.invoke(waitNanos)
+                block()
+            }
+        }
+
+        @PublishedApi
+        internal fun recordLockWait(nanos: Long) {
+            lockWaits.incrementAndGet()
+            lockWaitNanos.addAndGet(nanos)
+            lockMaxWaitNanos.accumulateAndGet(nanos) { current, new -> maxOf(a = current, b = new) }
+        }
+
+        /**
+         * Snapshot of the performance counters. For each of open, loadPage, render, loadText, textExtract,
+         * search and save, the keys `<group>.calls`, `<group>.totalNanos`, `<group>.maxNanos` and
+         * `<group>.bytes` hold the JNI call count, total and max latency and bytes moved. The keys
+         * `lock.waits`, `lock.waitNanos` and `lock.maxWaitNanos` describe the waits for [lock].
+         *
+         * @return The counters, empty unless [isStatsEnabled]
+         */
+        fun getStats(): Map<String, Long> {
+            val values: LongArray = nativeGetStats() ?: return emptyMap()
+            return buildMap {
+                STATS_GROUPS.forEachIndexed { group, groupName ->
+                    STATS_VALUES.forEachIndexed { value, valueName ->
+                        put(key = "$groupName.$valueName", value = values[group * STATS_VALUES.size + value])
+                    }
+                }
+                put(key = "lock.waits", value = lockWaits.get())
+                put(key = "lock.waitNanos", value = lockWaitNanos.get())
+                put(key = "lock.maxWaitNanos", value = lockMaxWaitNanos.get())
+            }
+        }
+
+        /**
+         * Native memory held for all open documents together, see [NativeMemoryUsage].
+         * Cheap enough to be queried before every cache decision.
+         */
+        fun getNativeMemoryUsage(): NativeMemoryUsage {
+            return NativeMemoryUsage.fromSnapshot(values = nativeGetMemoryUsage(docPtr = 0L))
+        }
+
+        /**
+         * Resets the performance counters to zero.
+         */
+        fun resetStats() {
+            nativeResetStats()
+            lockWaits.set(0L)
+            lockWaitNanos.set(0L)
+            lockMaxWaitNanos.set(0L)
+        }
+
+        /**
+         * Logs the performance counters, one line per group. Does nothing unless [isStatsEnabled].
+         */
+        fun dumpStats() {
+            if (!isStatsEnabled) return
+            getStats().entries.groupBy { it.key.substringBefore(delimiter = '.') }.forEach { (group, entries) ->
+                val values: String = entries.joinToString { "${it.key.substringAfter(delimiter = '.')}=${it.value}" }
+                Log.d(TAG, "Stats $group: $values")
+            }
+        }
+
+        /**
+         * Current library keep-alive policy, see [setKeepAlivePolicy].
+         */
+        @Volatile
+        var keepAlivePolicy: KeepAlivePolicy = KeepAlivePolicy.DISABLED
+            private set
+
+        /**
+         * Sets how long the native library stays initialized after the last document is closed.
+         *
+         * @param policy The keep-alive policy to apply
+         */
+        fun setKeepAlivePolicy(policy: KeepAlivePolicy) {
+            withLock {
+                keepAlivePolicy = policy
+                nativeSetLibraryKeepAlive(keepAlive = policy.keepAlive)
+            }
+            scheduleLibraryRelease()
+        }
+
+        /**
+         * Initializes the native library ahead of the first document open.
+         * With an idle timeout configured, the library is released again if no document is opened in time.
+         *
+         * @return true if this call initialized the library, false if it was already initialized
+         */
+        fun warmUp(): Boolean {
+            cancelLibraryRelease()
+            val initialized: Boolean = withLock { nativeWarmUpLibrary() }
+            scheduleLibraryRelease()
+            return initialized
+        }
+
+        /**
+         * Releases the native library if no document is currently open.
+         *
+         * @return true if the library was destroyed
+         */
+        fun releaseLibrary(): Boolean {
+            cancelLibraryRelease()
+            return withLock {
+                preparedDocument?.document?.close()
+                preparedDocument = null
+                nativeReleaseLibrary()
+            }
+        }
+
+        /**
+         * Moves cold-start work off the first document open. Meant to be called early from a background
+         * thread, e.g. from [android.app.Application.onCreate].
+         *
+         * Initializes the library, loads the system font index, renders a synthetic page to prime glyph
+         * caches and code pages and, when [lastDocument] is given, opens it and parses its first page.
+         * The prepared document is adopted by the next [newDocument] call for the same file and password,
+         * and is dropped together with the library by [releaseLibrary].
+         *
+         * @param context Context used to locate the cache directory of the font index
+         * @param lastDocument Optional document the user is likely to open next
+         * @param password Optional password of [lastDocument]
+         * @return Time spent in each stage
+         */
+        fun warmUp(context: Context, lastDocument: File? = null, password: String? = null): WarmUpReport {
+            registerContext(context = context)
+            cancelLibraryRelease()
+
+            var start: Long = System.nanoTime()
+            withLock { nativeWarmUpLibrary() }
+            val libraryInitNanos: Long = System.nanoTime() - start
+
+            start = System.nanoTime()
+            val fontFaces: Int = nativeWarmUpFonts()
+            val fontIndexNanos: Long = System.nanoTime() - start
+
+            start = System.nanoTime()
+            withLock { nativePrimeRenderer() }
+            val primingNanos: Long = System.nanoTime() - start
+
+            var report = WarmUpReport(
+                libraryInitNanos = libraryInitNanos,
+                fontIndexNanos = fontIndexNanos,
+                fontFaces = fontFaces,
+                primingNanos = primingNanos
+            )
+            if (lastDocument != null) {
+                report = prepareDocument(file = lastDocument, password = password, report = report)
+            }
+            scheduleLibraryRelease()
+            Log.d(TAG, "Warm-up: $report")
+            return report
+        }
+
+        private fun prepareDocument(file: File, password: String?, report: WarmUpReport): WarmUpReport {
+            val document = PdfDocument()
+            var start: Long = System.nanoTime()
+            try {
+                val parcelFileDescriptor: ParcelFileDescriptor =
+                    ParcelFileDescriptor.open(file, ParcelFileDescriptor.MODE_READ_ONLY)
+                document.fileDescriptor = parcelFileDescriptor
+                withLock {
+                    document.nativePtr = nativeOpenDocument(
+                        parcelFileDescriptor = parcelFileDescriptor.fd, password = password
+                    )
+                }
+            } catch (e: IOException) {
+                Log.w(TAG, "Cannot prepare ${file.path}", e)
+                document.fileDescriptor?.close()
+                return report
+            }
+            val documentOpenNanos: Long = System.nanoTime() - start
+
+            start = System.nanoTime()
+            if (document.totalPages > 0) document.openPage(pageIndex = 0)
+            val firstPageNanos: Long = System.nanoTime() - start
+
+            withLock {
+                preparedDocument?.document?.close()
+                preparedDocument = PreparedDocument(
+                    path = file.absolutePath,
+                    lastModified = file.lastModified(),
+                    length = file.length(),
+                    password = password,
+                    document = document
+                )
+            }
+            return report.copy(
+                documentOpenNanos = documentOpenNanos,
+                firstPageNanos = firstPageNanos,
+                isDocumentPrepared = true
+            )
+        }
+
+        private fun takePreparedDocument(file: File, password: String?): PdfDocument? {
+            withLock {
+                val prepared: PreparedDocument = preparedDocument ?: return null
+                preparedDocument = null
+                if (prepared.path == file.absolutePath && prepared.lastModified == file.lastModified() &&
+                    prepared.length == file.length() && prepared.password == password
+                ) {
+                    return prepared.document
+                }
+                prepared.document.close()
+                return null
+            }
+        }
+
+        private fun registerContext(context: Context) {
+            if (isTrimCallbackRegistered.compareAndSet(false, true)) {
+                context.applicationContext.registerComponentCallbacks(trimMemoryCallbacks)
+                nativeSetFontCacheDir(cacheDir = context.cacheDir.absolutePath)
+            }
+        }
+
+        /**
+         * Releases an idle library when the app moves to the background or the system runs low on memory.
+         * Called automatically once a [PdfiumCore] has been created.
+         *
+         * @param level The trim level from [ComponentCallbacks2.onTrimMemory]
+         */
+        fun onTrimMemory(level: Int) {
+            if (!keepAlivePolicy.releaseOnTrimMemory || level < ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN) return
+            keepAliveHandler.post(releaseLibraryTask)
+        }
+
+        private class PreparedDocument(
+            val path: String,
+            val lastModified: Long,
+            val length: Long,
+            val password: String?,
+            val document: PdfDocument,
+        )
+
+        internal fun scheduleLibraryRelease() {
+            cancelLibraryRelease()
+            val policy: KeepAlivePolicy = keepAlivePolicy
+            if (policy.keepAlive && policy.idleTimeoutMs > 0) {
+                keepAliveHandler.postDelayed(releaseLibraryTask, policy.idleTimeoutMs)
+            }
+        }
+
+        private fun cancelLibraryRelease() {
+            keepAliveHandler.removeCallbacks(releaseLibraryTask)
+        }
+
         @JvmStatic
         private external fun nativeClosePage(pagePtr: Long)
 
@@ -591,11 +1623,125 @@ class PdfiumCore(
             pagePtr: Long, startX: Int, startY: Int, sizeX: Int, sizeY: Int, rotate: Int, pageX: Double, pageY: Double,
         ): Point
 
+        @JvmStatic
+        private external fun nativeGetStats(): LongArray?
+
+        @JvmStatic
+        private external fun nativeResetStats()
+
+        @JvmStatic
+        private external fun nativeGetMemoryUsage(docPtr: Long): LongArray
+
+        @JvmStatic
+        private external fun nativeGetPageContentBounds(docPtr: Long, pageIndex: Int): FloatArray
+
+        @JvmStatic
+        private external fun nativeGetPageComplexity(docPtr: Long, pageIndex: Int): LongArray
+
+        @JvmStatic
+        private external fun nativeGetPageColorClass(pagePtr: Long, annotation: Boolean): Int
+
         @JvmStatic
         private external fun nativeRenderPageBitmap(
             docPtr: Long, pagePtr: Long, bitmap: Bitmap?, startX: Int, startY: Int,
-            drawSizeHor: Int, drawSizeVer: Int, annotation: Boolean
-        )
+            drawSizeHor: Int, drawSizeVer: Int, annotation: Boolean, forms: Boolean, budgetMs: Long
+        ): Int
+
+        @JvmStatic
+        private external fun nativeRenderAnnotationLayer(
+            docPtr: Long, pagePtr: Long, pageIndex: Int, bitmap: Bitmap, startX: Int, startY: Int,
+            drawSizeHor: Int, drawSizeVer: Int
+        ): Int
+
+        @JvmStatic
+        private external fun nativeGetAnnotationLayerRects(pagePtr: Long): FloatArray
+
+        @JvmStatic
+        private external fun nativeFormTouch(docPtr: Long, pagePtr: Long, action: Int, pageX: Double, pageY: Double): Boolean
+
+        @JvmStatic
+        private external fun nativeFormKey(docPtr: Long, pagePtr: Long, keyCode: Int, modifiers: Int, isDown: Boolean): Boolean
+
+        @JvmStatic
+        private external fun nativeFormChar(docPtr: Long, pagePtr: Long, charCode: Int, modifiers: Int): Boolean
+
+        @JvmStatic
+        private external fun nativeFormKillFocus(docPtr: Long): Boolean
+
+        @JvmStatic
+        private external fun nativeGetFocusedFormFieldType(docPtr: Long): Int
+
+        @JvmStatic
+        private external fun nativeTakeFormDirtyRects(docPtr: Long, pagePtrs: LongArray): FloatArray
+
+        @JvmStatic
+        private external fun nativeGetFormFields(
+            docPtr: Long, pageIndex: Int, openIndices: IntArray, openPtrs: LongArray
+        ): ByteArray?
+
+        @JvmStatic
+        private external fun nativeSetFormFieldValues(
+            docPtr: Long, openIndices: IntArray, openPtrs: LongArray, names: Array<String>, values: Array<String>
+        ): Int
+
+        @JvmStatic
+        private external fun nativeIsTagged(docPtr: Long): Boolean
+
+        @JvmStatic
+        private external fun nativeGetReflowBlocks(pagePtr: Long): ByteArray?
+
+        @JvmStatic
+        private external fun nativeGetPageImages(pagePtr: Long, minWidth: Int, minHeight: Int): DoubleArray
+
+        @JvmStatic
+        private external fun nativeGetImageFilters(pagePtr: Long, objectIndex: Int): String?
+
+        @JvmStatic
+        private external fun nativeGetScanImage(pagePtr: Long): FloatArray?
+
+        @JvmStatic
+        private external fun nativeGetImageRaw(pagePtr: Long, objectIndex: Int): ByteArray?
+
+        @JvmStatic
+        private external fun nativeWriteImageRaw(docPtr: Long, pagePtr: Long, objectIndex: Int, outputFd: Int): Long
+
+        @JvmStatic
+        private external fun nativeGetImageBitmap(pagePtr: Long, objectIndex: Int, bitmap: Bitmap, sampleSize: Int): Boolean
+
+        @JvmStatic
+        private external fun nativeRenderOverviewSheet(
+            docPtr: Long, firstPage: Int, columns: Int, rows: Int, bitmap: Bitmap
+        ): Int
+
+        @JvmStatic
+        private external fun nativeOpenBandForm(docPtr: Long, pagePtr: Long): Long
+
+        @JvmStatic
+        private external fun nativeCloseBandForm(formPtr: Long)
+
+        @JvmStatic
+        private external fun nativeRenderPageBand(
+            pagePtr: Long, formPtr: Long, bitmap: Bitmap, pageHeight: Int, bandTop: Int, bandHeight: Int,
+            annotation: Boolean
+        ): Int
+
+        @JvmStatic
+        private external fun nativeSetFontCacheDir(cacheDir: String)
+
+        @JvmStatic
+        private external fun nativeWarmUpLibrary(): Boolean
+
+        @JvmStatic
+        private external fun nativeWarmUpFonts(): Int
+
+        @JvmStatic
+        private external fun nativePrimeRenderer(): Boolean
+
+        @JvmStatic
+        private external fun nativeSetLibraryKeepAlive(keepAlive: Boolean)
+
+        @JvmStatic
+        private external fun nativeReleaseLibrary(): Boolean
 
         @JvmStatic
         private external fun nativeRenderPage(
@@ -0,0 +1,16 @@
+package com.ahmer.pdfium
+
+import android.graphics.RectF
+
+/**
+ * A page made of a single image covering it, such as a scanned document page. Such pages can be
+ * drawn by scaling the decoded image instead of rasterizing the page at every zoom level.
+ *
+ * @property image The page image
+ * @property placement Bounds of the image relative to the page crop box, between 0 and 1 when inside it,
+ * with the top of the page at 0
+ */
+data class ScannedPage(
+    val image: PdfImageInfo,
+    val placement: RectF,
+)
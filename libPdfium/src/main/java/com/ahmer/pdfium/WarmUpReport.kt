@@ -0,0 +1,28 @@
+package com.ahmer.pdfium
+
+/**
+ * Time spent in each stage of [PdfiumCore.warmUp].
+ *
+ * Every stage is work the first document open no longer has to do on the caller's thread, so the
+ * values approximate the cold-start time saved. A stage that was already warm reports close to 0.
+ *
+ * @property libraryInitNanos Time spent initializing the native library
+ * @property fontIndexNanos Time spent loading or building the system font index
+ * @property fontFaces Number of faces in the system font index
+ * @property primingNanos Time spent rendering a synthetic page to prime glyph caches and code pages
+ * @property documentOpenNanos Time spent opening the last document, 0 if none was given
+ * @property firstPageNanos Time spent loading the first page of the last document, 0 if none was given
+ * @property isDocumentPrepared Whether the last document is waiting to be adopted by [PdfiumCore.newDocument]
+ */
+data class WarmUpReport(
+    val libraryInitNanos: Long = 0L,
+    val fontIndexNanos: Long = 0L,
+    val fontFaces: Int = 0,
+    val primingNanos: Long = 0L,
+    val documentOpenNanos: Long = 0L,
+    val firstPageNanos: Long = 0L,
+    val isDocumentPrepared: Boolean = false,
+) {
+    val totalNanos: Long
+        get() = libraryInitNanos + fontIndexNanos + primingNanos + documentOpenNanos + firstPageNanos
+}